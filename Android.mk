@@ -121,6 +121,8 @@ enc_srcs := \
     src/enc/analysis_enc.c \
     src/enc/backward_references_cost_enc.c \
     src/enc/backward_references_enc.c \
+    src/enc/cache_enc.c \
+    src/enc/cancel_enc.c \
     src/enc/config_enc.c \
     src/enc/cost_enc.c \
     src/enc/filter_enc.c \
@@ -135,6 +137,7 @@ enc_srcs := \
     src/enc/picture_tools_enc.c \
     src/enc/predictor_enc.c \
     src/enc/quant_enc.c \
+    src/enc/renditions_enc.c \
     src/enc/syntax_enc.c \
     src/enc/token_enc.c \
     src/enc/tree_enc.c \
@@ -156,6 +159,7 @@ utils_dec_srcs := \
     src/utils/random_utils.c \
     src/utils/rescaler_utils.c \
     src/utils/thread_utils.c \
+    src/utils/trace_utils.c \
     src/utils/utils.c \
 
 utils_enc_srcs := \
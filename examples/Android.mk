@@ -7,6 +7,7 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := \
     example_util.c \
+    perf_counters.c \
 
 LOCAL_CFLAGS := $(WEBP_CFLAGS)
 LOCAL_C_INCLUDES := $(LOCAL_PATH)/../src
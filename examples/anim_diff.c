@@ -19,6 +19,15 @@
 #include <stdlib.h>  // for 'strtod'.
 #include <string.h>  // for 'strcmp'.
 
+#ifdef HAVE_CONFIG_H
+#include "webp/config.h"
+#endif
+
+#if defined(WEBP_USE_THREAD) && !defined(_WIN32)
+#include <pthread.h>
+#define ANIM_DIFF_USE_THREAD
+#endif
+
 #include "./anim_util.h"
 #include "./example_util.h"
 #include "./unicode.h"
@@ -126,14 +135,118 @@ static int CompareBackgroundColor(uint32_t bg1, uint32_t bg2, int premultiply) {
   return 1;
 }
 
+//------------------------------------------------------------------------------
+// Per-frame comparison, possibly spread over several threads.
+
+#define NUM_COMPARE_THREADS 4
+
+typedef struct {
+  int duration_mismatch;
+  int max_diff;
+  double psnr;
+} FrameDiff;
+
+typedef struct {
+  const AnimatedImage* img1;
+  const AnimatedImage* img2;
+  int premultiply;
+  double min_psnr;
+  int fail_fast;            // if true, skip frames past the first difference
+  FrameDiff* diffs;         // one entry per frame
+  uint32_t next_frame;      // next frame to be compared
+  uint32_t first_failure;   // index of the first differing frame found so far
+#ifdef ANIM_DIFF_USE_THREAD
+  pthread_mutex_t mutex;
+#endif
+} CompareJob;
+
+static int FrameDiffers(const FrameDiff* const diff, double min_psnr) {
+  return (min_psnr > 0.) ? (diff->psnr < min_psnr) : (diff->max_diff != 0);
+}
+
+static void* CompareFramesLoop(void* ptr) {
+  CompareJob* const job = (CompareJob*)ptr;
+  while (1) {
+    uint32_t i;
+    FrameDiff* diff;
+#ifdef ANIM_DIFF_USE_THREAD
+    pthread_mutex_lock(&job->mutex);
+#endif
+    i = job->next_frame++;
+    // Frames after a known difference won't be reported in fail-fast mode.
+    if (job->fail_fast && i > job->first_failure) i = job->img1->num_frames;
+#ifdef ANIM_DIFF_USE_THREAD
+    pthread_mutex_unlock(&job->mutex);
+#endif
+    if (i >= job->img1->num_frames) break;
+
+    diff = &job->diffs[i];
+    diff->duration_mismatch =
+        (job->img1->num_frames > 1) &&   // only relevant for animations
+        (job->img1->frames[i].duration != job->img2->frames[i].duration);
+    GetDiffAndPSNR(job->img1->frames[i].rgba, job->img2->frames[i].rgba,
+                   job->img1->canvas_width, job->img1->canvas_height,
+                   job->premultiply, &diff->max_diff, &diff->psnr);
+    if (diff->duration_mismatch || FrameDiffers(diff, job->min_psnr)) {
+#ifdef ANIM_DIFF_USE_THREAD
+      pthread_mutex_lock(&job->mutex);
+#endif
+      if (i < job->first_failure) job->first_failure = i;
+#ifdef ANIM_DIFF_USE_THREAD
+      pthread_mutex_unlock(&job->mutex);
+#endif
+    }
+  }
+  return NULL;
+}
+
+// Fills 'diffs' for all frames (or, in fail-fast mode, at least up to the
+// first differing one). Returns false in case of error.
+static int CompareFrames(const AnimatedImage* const img1,
+                         const AnimatedImage* const img2, int premultiply,
+                         double min_psnr, int fail_fast, int use_threads,
+                         FrameDiff* const diffs) {
+  CompareJob job;
+  job.img1 = img1;
+  job.img2 = img2;
+  job.premultiply = premultiply;
+  job.min_psnr = min_psnr;
+  job.fail_fast = fail_fast;
+  job.diffs = diffs;
+  job.next_frame = 0;
+  job.first_failure = img1->num_frames;
+#ifdef ANIM_DIFF_USE_THREAD
+  if (pthread_mutex_init(&job.mutex, NULL)) return 0;
+  {
+    pthread_t threads[NUM_COMPARE_THREADS - 1];
+    int num_threads = 0;
+    while (use_threads && num_threads < NUM_COMPARE_THREADS - 1 &&
+           (uint32_t)num_threads + 1 < img1->num_frames &&
+           !pthread_create(&threads[num_threads], NULL, CompareFramesLoop,
+                           &job)) {
+      ++num_threads;
+    }
+    CompareFramesLoop(&job);   // the main thread takes its share too
+    while (num_threads > 0) pthread_join(threads[--num_threads], NULL);
+  }
+  pthread_mutex_destroy(&job.mutex);
+#else
+  (void)use_threads;
+  CompareFramesLoop(&job);
+#endif
+  return 1;
+}
+
 // Note: As long as frame durations and reconstructed frames are identical, it
 // is OK for other aspects like offsets, dispose/blend method to vary.
 static int CompareAnimatedImagePair(const AnimatedImage* const img1,
                                     const AnimatedImage* const img2,
                                     int premultiply,
-                                    double min_psnr) {
+                                    double min_psnr, int fail_fast,
+                                    int use_threads) {
   int ok = 1;
   const int is_multi_frame_image = (img1->num_frames > 1);
+  FrameDiff* diffs;
   uint32_t i;
 
   ok = CompareValues(img1->canvas_width, img2->canvas_width,
@@ -159,23 +272,30 @@ static int CompareAnimatedImagePair(const AnimatedImage* const img1,
                         "Loop count mismatch")) && ok;
     ok = CompareBackgroundColor(img1->bgcolor, img2->bgcolor,
                                 premultiply) && ok;
+    if (!ok && fail_fast) return 0;
   }
 
-  for (i = 0; i < img1->num_frames; ++i) {
-    // Pixel-by-pixel comparison.
-    const uint8_t* const rgba1 = img1->frames[i].rgba;
-    const uint8_t* const rgba2 = img2->frames[i].rgba;
-    int max_diff;
-    double psnr;
+  diffs = (FrameDiff*)calloc(img1->num_frames, sizeof(*diffs));
+  if (diffs == NULL ||
+      !CompareFrames(img1, img2, premultiply, min_psnr, fail_fast,
+                     use_threads, diffs)) {
+    fprintf(stderr, "Error! Could not compare frames.\n");
+    free(diffs);
+    return 0;
+  }
+
+  // Report the differences in frame order.
+  for (i = 0; i < img1->num_frames && (ok || !fail_fast); ++i) {
+    const int max_diff = diffs[i].max_diff;
+    const double psnr = diffs[i].psnr;
     if (is_multi_frame_image) {  // Check relevant for multi-frame images only.
       const char format[] = "Frame #%d, duration mismatch";
       char tmp[sizeof(format) + 8];
       ok = ok && (snprintf(tmp, sizeof(tmp), format, i) >= 0);
       ok = ok && CompareValues(img1->frames[i].duration,
                                img2->frames[i].duration, tmp);
+      if (!ok && fail_fast) break;
     }
-    GetDiffAndPSNR(rgba1, rgba2, img1->canvas_width, img1->canvas_height,
-                   premultiply, &max_diff, &psnr);
     if (min_psnr > 0.) {
       if (psnr < min_psnr) {
         fprintf(stderr, "Frame #%d, psnr = %.2lf (min_psnr = %f)\n", i,
@@ -189,9 +309,31 @@ static int CompareAnimatedImagePair(const AnimatedImage* const img1,
       }
     }
   }
+  free(diffs);
   return ok;
 }
 
+//------------------------------------------------------------------------------
+
+typedef struct {
+  const char* file;
+  AnimatedImage* image;
+  int dump_frames;
+  const char* dump_folder;
+  int max_diff;
+  int ok;
+} DecodeJob;
+
+static void* DecodeImage(void* ptr) {
+  DecodeJob* const job = (DecodeJob*)ptr;
+  job->ok = ReadAnimatedImage(job->file, job->image, job->dump_frames,
+                              job->dump_folder);
+  if (job->ok) MinimizeAnimationFrames(job->image, job->max_diff);
+  return NULL;
+}
+
+//------------------------------------------------------------------------------
+
 static void Help(void) {
   printf("Usage: anim_diff <image1> <image2> [options]\n");
   printf("\nOptions:\n");
@@ -202,6 +344,10 @@ static void Help(void) {
   printf("  -max_diff <int> ..... maximum allowed difference per channel\n"
          "                        between corresponding pixels in subsequent\n"
          "                        frames\n");
+  printf("  -fail_fast .......... stop at the first differing frame\n");
+  printf("  -mt ................. use multi-threading if available: the two\n"
+         "                        files are decoded and the frames compared\n"
+         "                        concurrently\n");
   printf("  -h .................. this help\n");
   printf("  -version ............ print version number and exit\n");
 }
@@ -215,9 +361,12 @@ int main(int argc, const char* argv[]) {
   int got_input2 = 0;
   int premultiply = 1;
   int max_diff = 0;
+  int fail_fast = 0;
+  int use_threads = 0;
   int i, c;
   const char* files[2] = { NULL, NULL };
   AnimatedImage images[2];
+  DecodeJob jobs[2];
 
   INIT_WARGV(argc, argv);
 
@@ -244,6 +393,10 @@ int main(int argc, const char* argv[]) {
       } else {
         parse_error = 1;
       }
+    } else if (!strcmp(argv[c], "-fail_fast")) {
+      fail_fast = 1;
+    } else if (!strcmp(argv[c], "-mt")) {
+      use_threads = 1;
     } else if (!strcmp(argv[c], "-h") || !strcmp(argv[c], "-help")) {
       Help();
       FREE_WARGV_AND_RETURN(0);
@@ -290,18 +443,42 @@ int main(int argc, const char* argv[]) {
   memset(images, 0, sizeof(images));
   for (i = 0; i < 2; ++i) {
     WPRINTF("Decoding file: %s\n", (const W_CHAR*)files[i]);
-    if (!ReadAnimatedImage(files[i], &images[i], dump_frames, dump_folder)) {
+    jobs[i].file = files[i];
+    jobs[i].image = &images[i];
+    jobs[i].dump_frames = dump_frames;
+    jobs[i].dump_folder = dump_folder;
+    jobs[i].max_diff = max_diff;
+    jobs[i].ok = 0;
+  }
+  {
+#ifdef ANIM_DIFF_USE_THREAD
+    // Decode the second file in the background while decoding the first one.
+    pthread_t thread;
+    const int threaded =
+        use_threads && !pthread_create(&thread, NULL, DecodeImage, &jobs[1]);
+    DecodeImage(&jobs[0]);
+    if (threaded) {
+      pthread_join(thread, NULL);
+    } else if (jobs[0].ok) {
+      DecodeImage(&jobs[1]);
+    }
+#else
+    DecodeImage(&jobs[0]);
+    if (jobs[0].ok) DecodeImage(&jobs[1]);
+#endif
+  }
+  for (i = 0; i < 2; ++i) {
+    if (!jobs[i].ok) {
       WFPRINTF(stderr, "Error decoding file: %s\n Aborting.\n",
                (const W_CHAR*)files[i]);
       return_code = -2;
       goto End;
-    } else {
-      MinimizeAnimationFrames(&images[i], max_diff);
     }
   }
 
   if (!CompareAnimatedImagePair(&images[0], &images[1],
-                                premultiply, min_psnr)) {
+                                premultiply, min_psnr, fail_fast,
+                                use_threads)) {
     WFPRINTF(stderr, "\nFiles %s and %s differ.\n", (const W_CHAR*)files[0],
              (const W_CHAR*)files[1]);
     return_code = -3;
@@ -14,6 +14,7 @@
 #include <assert.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #if defined(WEBP_HAVE_GIF)
@@ -727,48 +728,79 @@ int ReadAnimatedImage(const char filename[], AnimatedImage* const image,
   return ok;
 }
 
-static void Accumulate(double v1, double v2, double* const max_diff,
-                       double* const sse) {
-  const double diff = fabs(v1 - v2);
-  if (diff > *max_diff) *max_diff = diff;
-  *sse += diff * diff;
+// The row kernels below only use integer arithmetic, with independent
+// iterations, so that the compiler can vectorize them.
+
+// Raw per-channel differences.
+static void DiffRow(const uint8_t* const row1, const uint8_t* const row2,
+                    uint32_t len, int* const max_diff, uint64_t* const sse) {
+  uint32_t i;
+  int max = *max_diff;
+  uint64_t sum = 0;
+  for (i = 0; i < len; ++i) {
+    const int diff = abs(row1[i] - row2[i]);
+    max = (diff > max) ? diff : max;
+    sum += (uint32_t)(diff * diff);
+  }
+  *max_diff = max;
+  *sse += sum;
+}
+
+// Differences with R/G/B premultiplied by alpha, all scaled by 255.
+static void DiffRowPremultiplied(const uint8_t* const row1,
+                                 const uint8_t* const row2, uint32_t width,
+                                 int* const max_diff, uint64_t* const sse) {
+  uint32_t x;
+  int max = *max_diff;
+  uint64_t sum = 0;
+  for (x = 0; x < width; ++x) {
+    const uint8_t* const p1 = row1 + x * kNumChannels;
+    const uint8_t* const p2 = row2 + x * kNumChannels;
+    const int alpha1 = p1[3], alpha2 = p2[3];
+    const int diff_r = abs(p1[0] * alpha1 - p2[0] * alpha2);
+    const int diff_g = abs(p1[1] * alpha1 - p2[1] * alpha2);
+    const int diff_b = abs(p1[2] * alpha1 - p2[2] * alpha2);
+    const int diff_a = abs(alpha1 - alpha2) * 255;
+    const int max_rg = (diff_r > diff_g) ? diff_r : diff_g;
+    const int max_ba = (diff_b > diff_a) ? diff_b : diff_a;
+    const int max_px = (max_rg > max_ba) ? max_rg : max_ba;
+    max = (max_px > max) ? max_px : max;
+    sum += (uint64_t)((uint32_t)diff_r * (uint32_t)diff_r) +
+           (uint32_t)diff_g * (uint32_t)diff_g +
+           (uint32_t)diff_b * (uint32_t)diff_b +
+           (uint32_t)diff_a * (uint32_t)diff_a;
+  }
+  *max_diff = max;
+  *sse += sum;
 }
 
 void GetDiffAndPSNR(const uint8_t rgba1[], const uint8_t rgba2[],
                     uint32_t width, uint32_t height, int premultiply,
                     int* const max_diff, double* const psnr) {
   const uint32_t stride = width * kNumChannels;
-  const int kAlphaChannel = kNumChannels - 1;
-  double f_max_diff = 0.;
-  double sse = 0.;
-  uint32_t x, y;
+  int max = 0;
+  uint64_t sse = 0;
+  double norm_sse;
+  uint32_t y;
   for (y = 0; y < height; ++y) {
-    for (x = 0; x < stride; x += kNumChannels) {
-      int k;
-      const size_t offset = (size_t)y * stride + x;
-      const int alpha1 = rgba1[offset + kAlphaChannel];
-      const int alpha2 = rgba2[offset + kAlphaChannel];
-      Accumulate(alpha1, alpha2, &f_max_diff, &sse);
-      if (!premultiply) {
-        for (k = 0; k < kAlphaChannel; ++k) {
-          Accumulate(rgba1[offset + k], rgba2[offset + k], &f_max_diff, &sse);
-        }
-      } else {
-        // premultiply R/G/B channels with alpha value
-        for (k = 0; k < kAlphaChannel; ++k) {
-          Accumulate(rgba1[offset + k] * alpha1 / 255.,
-                     rgba2[offset + k] * alpha2 / 255.,
-                     &f_max_diff, &sse);
-        }
-      }
+    const size_t offset = (size_t)y * stride;
+    if (!premultiply) {
+      DiffRow(rgba1 + offset, rgba2 + offset, stride, &max, &sse);
+    } else {
+      DiffRowPremultiplied(rgba1 + offset, rgba2 + offset, width, &max, &sse);
     }
   }
-  *max_diff = (int)f_max_diff;
+  norm_sse = (double)sse;
+  if (premultiply) {  // undo the scaling by 255
+    max /= 255;
+    norm_sse /= 255. * 255.;
+  }
+  *max_diff = max;
   if (*max_diff == 0) {
     *psnr = 99.;  // PSNR when images are identical.
   } else {
-    sse /= stride * height;
-    *psnr = 4.3429448 * log(255. * 255. / sse);
+    norm_sse /= stride * height;
+    *psnr = 4.3429448 * log(255. * 255. / norm_sse);
   }
 }
 
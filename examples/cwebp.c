@@ -23,6 +23,7 @@
 #include "../examples/example_util.h"
 #include "../imageio/image_dec.h"
 #include "../imageio/imageio_util.h"
+#include "./perf_counters.h"
 #include "./stopwatch.h"
 #include "./unicode.h"
 #include "webp/encode.h"
@@ -300,6 +301,20 @@ static int MyWriter(const uint8_t* data, size_t data_size,
   return data_size ? (fwrite(data, data_size, 1, out) == 1) : 1;
 }
 
+// Stops the trace recording and saves it to 'trace_file'.
+static int SaveTrace(const char* const trace_file) {
+  size_t size;
+  char* const trace = WebPTraceStop(&size);
+  const int ok = (trace != NULL) &&
+                 ImgIoUtilWriteFile(trace_file, (const uint8_t*)trace, size);
+  WebPFree(trace);
+  if (!ok) {
+    WFPRINTF(stderr, "Warning, couldn't save trace %s\n",
+             (const W_CHAR*)trace_file);
+  }
+  return ok;
+}
+
 // Dumps a picture as a PGM file using the IMC4 layout.
 static int DumpPicture(const WebPPicture* const picture, const char* PGM_name) {
   int y;
@@ -568,12 +583,18 @@ static void HelpLong(void) {
   printf("  -crop <x> <y> <w> <h> .. crop picture with the given rectangle\n");
   printf("  -resize <w> <h> ........ resize picture (after any cropping)\n");
   printf("  -mt .................... use multi-threading if available\n");
+  printf("                           (repeat it to also split lossless\n");
+  printf("                           encoding into bands, one per CPU at\n");
+  printf("                           most: faster on several CPUs, but\n");
+  printf("                           slightly bigger output)\n");
   printf("  -low_memory ............ reduce memory usage (slower encoding)\n");
   printf("  -map <int> ............. print map of extra info\n");
   printf("  -print_psnr ............ prints averaged PSNR distortion\n");
   printf("  -print_ssim ............ prints averaged SSIM distortion\n");
   printf("  -print_lsim ............ prints local-similarity distortion\n");
   printf("  -d <file.pgm> .......... dump the compressed output (PGM file)\n");
+  printf("  -cache_dir <dir> ....... reuse the output of previous identical\n"
+         "                           encodings stored in directory <dir>\n");
   printf("  -alpha_method <int> .... transparency-compression method (0..1), "
          "default=1\n");
   printf("  -alpha_filter <string> . predictive filtering for alpha plane,\n");
@@ -589,6 +610,8 @@ static void HelpLong(void) {
   printf("  -near_lossless <int> ... use near-lossless image\n"
          "                           preprocessing (0..100=off), "
          "default=100\n");
+  printf("  -keep_smaller .......... encode both lossy and losslessly and\n"
+         "                           keep the smaller output\n");
   printf("  -hint <string> ......... specify image characteristics hint,\n");
   printf("                           one of: photo, picture or graph\n");
 
@@ -608,7 +631,10 @@ static void HelpLong(void) {
 #endif
   printf("  -v ..................... verbose, e.g. print encoding/decoding "
          "times\n");
+  printf("                           and hardware counters\n");
   printf("  -progress .............. report encoding progress\n");
+  printf("  -trace <file> .......... save a trace of the encoding stages, in\n"
+         "                           Chrome trace-event JSON format\n");
   printf("\n");
   printf("Experimental Options:\n");
   printf("  -jpeg_like ............. roughly match expected JPEG size\n");
@@ -644,8 +670,12 @@ static const char* const kErrorMessages[VP8_ENC_ERROR_LAST] = {
 int main(int argc, const char* argv[]) {
   int return_value = -1;
   const char* in_file = NULL, *out_file = NULL, *dump_file = NULL;
+  const char* trace_file = NULL;
+  const char* cache_dir = NULL;
+  WebPEncodeCache* encode_cache = NULL;
+  int from_cache = 0;   // true if the output was taken from 'encode_cache'
   FILE* out = NULL;
-  int c;
+  int c, ok;
   int short_output = 0;
   int quiet = 0;
   int keep_alpha = 1;
@@ -666,6 +696,7 @@ int main(int argc, const char* argv[]) {
   WebPMemoryWriter memory_writer;
   Metadata metadata;
   Stopwatch stop_watch;
+  double encode_time = 0.;
 
   INIT_WARGV(argc, argv);
 
@@ -696,6 +727,8 @@ int main(int argc, const char* argv[]) {
     } else if (!strcmp(argv[c], "-d") && c < argc - 1) {
       dump_file = (const char*)GET_WARGV(argv, ++c);
       config.show_compressed = 1;
+    } else if (!strcmp(argv[c], "-cache_dir") && c < argc - 1) {
+      cache_dir = (const char*)GET_WARGV(argv, ++c);
     } else if (!strcmp(argv[c], "-print_psnr")) {
       config.show_compressed = 1;
       print_distortion = 0;
@@ -759,6 +792,8 @@ int main(int argc, const char* argv[]) {
     } else if (!strcmp(argv[c], "-near_lossless") && c < argc - 1) {
       config.near_lossless = ExUtilGetInt(argv[++c], 0, &parse_error);
       config.lossless = 1;  // use near-lossless only with lossless
+    } else if (!strcmp(argv[c], "-keep_smaller")) {
+      config.keep_smaller = 2;
     } else if (!strcmp(argv[c], "-hint") && c < argc - 1) {
       ++c;
       if (!strcmp(argv[c], "photo")) {
@@ -825,6 +860,8 @@ int main(int argc, const char* argv[]) {
       FREE_WARGV_AND_RETURN(0);
     } else if (!strcmp(argv[c], "-progress")) {
       show_progress = 1;
+    } else if (!strcmp(argv[c], "-trace") && c < argc - 1) {
+      trace_file = (const char*)GET_WARGV(argv, ++c);
     } else if (!strcmp(argv[c], "-quiet")) {
       quiet = 1;
     } else if (!strcmp(argv[c], "-preset") && c < argc - 1) {
@@ -949,10 +986,25 @@ int main(int argc, const char* argv[]) {
     goto Error;
   }
 
+  if (cache_dir != NULL) {
+    WebPEncodeCacheStorage storage;
+    if (!ImgIoUtilInitCacheDirStorage(cache_dir, &storage)) {
+      fprintf(stderr, "Error! Cannot initialize the encoding cache.\n");
+      goto Error;
+    }
+    encode_cache = WebPEncodeCacheNewWithStorage(&storage);
+    if (encode_cache == NULL) {
+      storage.release(storage.opaque);
+      fprintf(stderr, "Error! Cannot allocate the encoding cache.\n");
+      goto Error;
+    }
+  }
+
   // Read the input. We need to decide if we prefer ARGB or YUVA
   // samples, depending on the expected compression mode (this saves
   // some conversion steps).
-  picture.use_argb = (config.lossless || config.use_sharp_yuv ||
+  picture.use_argb = (config.lossless || config.keep_smaller ||
+                      config.use_sharp_yuv ||
                       config.preprocessing > 0 ||
                       crop || (resize_w | resize_h) > 0);
   if (verbose) {
@@ -1080,18 +1132,41 @@ int main(int argc, const char* argv[]) {
   }
 
   // Compress.
+  if (trace_file != NULL && !WebPTraceStart()) {
+    fprintf(stderr, "Warning, couldn't start the trace recording\n");
+    trace_file = NULL;
+  }
   if (verbose) {
+    PerfCountersStart();
     StopwatchReset(&stop_watch);
   }
-  if (!WebPEncode(&config, &picture)) {
+  // The cache can't be used when the reconstructed samples are needed.
+  ok = WebPEncodeCached(&config, &picture,
+                        (print_distortion < 0 && dump_file == NULL) ?
+                            encode_cache : NULL);
+  if (verbose) {
+    encode_time = StopwatchReadAndReset(&stop_watch);
+    PerfCountersStop();
+  }
+  if (trace_file != NULL) SaveTrace(trace_file);
+  if (!ok) {
     fprintf(stderr, "Error! Cannot encode picture as WebP\n");
     fprintf(stderr, "Error code: %d (%s)\n",
             picture.error_code, kErrorMessages[picture.error_code]);
     goto Error;
   }
+  if (encode_cache != NULL) {
+    WebPEncodeCacheStats cache_stats;
+    WebPEncodeCacheGetStats(encode_cache, &cache_stats);
+    from_cache = (cache_stats.hits > 0);
+    if (verbose) {
+      fprintf(stderr, "Encoding cache: %s\n",
+              from_cache ? "hit" : cache_stats.misses ? "miss" : "not used");
+    }
+  }
   if (verbose) {
-    const double encode_time = StopwatchReadAndReset(&stop_watch);
     fprintf(stderr, "Time to encode picture: %.3fs\n", encode_time);
+    PerfCountersPrint(stderr);
   }
 
   // Write info
@@ -1135,14 +1210,30 @@ int main(int argc, const char* argv[]) {
   }
 
   if (!quiet) {
-    if (!short_output || print_distortion < 0) {
-      if (config.lossless) {
+    if (from_cache) {
+      // Only the coded size is known for a cached output, whose format and
+      // encoding statistics are not recorded.
+      if (!short_output) {
+        WFPRINTF(stderr, "File:      %s\n", (const W_CHAR*)in_file);
+        fprintf(stderr, "Output:    %d bytes (from the encoding cache)\n",
+                stats.coded_size);
+      } else {
+        fprintf(stderr, "%7d\n", stats.coded_size);
+      }
+    } else if (!short_output || print_distortion < 0) {
+      if (config.keep_smaller && !short_output) {
+        fprintf(stderr, "Kept the %s output (the %s one was %s)\n",
+                stats.lossless_kept ? "lossless" : "lossy",
+                stats.lossless_kept ? "lossy" : "lossless",
+                stats.discarded_size ? "bigger" : "stopped early");
+      }
+      if (config.keep_smaller ? stats.lossless_kept : config.lossless) {
         PrintExtraInfoLossless(&picture, short_output, in_file);
       } else {
         PrintExtraInfoLossy(&picture, short_output, config.low_memory, in_file);
       }
     }
-    if (!short_output && picture.extra_info_type > 0) {
+    if (!short_output && !from_cache && picture.extra_info_type > 0) {
       PrintMapInfo(&picture);
     }
     if (print_distortion >= 0) {    // print distortion
@@ -1169,6 +1260,7 @@ int main(int argc, const char* argv[]) {
 
  Error:
   WebPMemoryWriterClear(&memory_writer);
+  WebPEncodeCacheDelete(encode_cache);
   WebPFree(picture.extra_info);
   MetadataFree(&metadata);
   WebPPictureFree(&picture);
@@ -22,7 +22,9 @@
 
 #include "../examples/example_util.h"
 #include "../imageio/image_enc.h"
+#include "../imageio/imageio_util.h"
 #include "../imageio/webpdec.h"
+#include "./perf_counters.h"
 #include "./stopwatch.h"
 #include "./unicode.h"
 
@@ -74,6 +76,20 @@ static int SaveOutput(const WebPDecBuffer* const buffer,
   return ok;
 }
 
+// Stops the trace recording and saves it to 'trace_file'.
+static int SaveTrace(const char* const trace_file) {
+  size_t size;
+  char* const trace = WebPTraceStop(&size);
+  const int ok = (trace != NULL) &&
+                 ImgIoUtilWriteFile(trace_file, (const uint8_t*)trace, size);
+  WebPFree(trace);
+  if (!ok) {
+    WFPRINTF(stderr, "Warning, couldn't save trace %s\n",
+             (const W_CHAR*)trace_file);
+  }
+  return ok;
+}
+
 static void Help(void) {
   printf("Usage: dwebp in_file [options] [-o out_file]\n\n"
          "Decodes the WebP image file to PNG format [Default]\n"
@@ -100,7 +116,10 @@ static void Help(void) {
          "  -alpha ....... only save the alpha plane\n"
          "  -incremental . use incremental decoding (useful for tests)\n"
          "  -h ........... this help message\n"
-         "  -v ........... verbose (e.g. print encoding/decoding times)\n"
+         "  -v ........... verbose (e.g. print encoding/decoding times\n"
+         "                 and hardware counters)\n"
+         "  -trace <file>  save a trace of the decoding stages, in Chrome\n"
+         "                 trace-event JSON format\n"
          "  -quiet ....... quiet mode, don't print anything\n"
 #ifndef WEBP_DLL
          "  -noasm ....... disable all assembly optimizations\n"
@@ -180,6 +199,7 @@ int main(int argc, const char* argv[]) {
   int ok = 0;
   const char* in_file = NULL;
   const char* out_file = NULL;
+  const char* trace_file = NULL;
 
   WebPDecoderConfig config;
   WebPDecBuffer* const output_buffer = &config.output;
@@ -280,6 +300,8 @@ int main(int argc, const char* argv[]) {
       config.options.flip = 1;
     } else if (!strcmp(argv[c], "-v")) {
       verbose = 1;
+    } else if (!strcmp(argv[c], "-trace") && c < argc - 1) {
+      trace_file = (const char*)GET_WARGV(argv, ++c);
 #ifndef WEBP_DLL
     } else if (!strcmp(argv[c], "-noasm")) {
       VP8GetCPUInfo = NULL;
@@ -370,7 +392,14 @@ int main(int argc, const char* argv[]) {
 
     {
       Stopwatch stop_watch;
-      if (verbose) StopwatchReset(&stop_watch);
+      if (trace_file != NULL && !WebPTraceStart()) {
+        fprintf(stderr, "Warning, couldn't start the trace recording\n");
+        trace_file = NULL;
+      }
+      if (verbose) {
+        PerfCountersStart();
+        StopwatchReset(&stop_watch);
+      }
 
       if (incremental) {
         status = DecodeWebPIncremental(data, data_size, &config);
@@ -379,8 +408,11 @@ int main(int argc, const char* argv[]) {
       }
       if (verbose) {
         const double decode_time = StopwatchReadAndReset(&stop_watch);
+        PerfCountersStop();
         fprintf(stderr, "Time to decode picture: %.3fs\n", decode_time);
+        PerfCountersPrint(stderr);
       }
+      if (trace_file != NULL) SaveTrace(trace_file);
     }
 
     ok = (status == VP8_STATUS_OK);
@@ -27,6 +27,11 @@
 #include <unistd.h>
 #endif
 
+#if defined(WEBP_USE_THREAD) && !defined(_WIN32)
+#include <pthread.h>
+#define GIF2WEBP_USE_THREAD
+#endif
+
 #include <gif_lib.h>
 #include "webp/encode.h"
 #include "webp/mux.h"
@@ -42,8 +47,6 @@
 
 //------------------------------------------------------------------------------
 
-static int transparent_index = GIF_INDEX_INVALID;  // Opaque by default.
-
 static const char* const kErrorMessages[-WEBP_MUX_NOT_ENOUGH_DATA + 1] = {
   "WEBP_MUX_NOT_FOUND", "WEBP_MUX_INVALID_ARGUMENT", "WEBP_MUX_BAD_DATA",
   "WEBP_MUX_MEMORY_ERROR", "WEBP_MUX_NOT_ENOUGH_DATA"
@@ -60,11 +63,23 @@ enum {
   METADATA_ALL  = METADATA_ICC | METADATA_XMP
 };
 
+// Settings shared by all the files being converted.
+typedef struct {
+  WebPConfig config;
+  WebPAnimEncoderOptions enc_options;
+  int keep_metadata;
+  int loop_compatibility;
+  int use_pipeline;   // decode and encode frames on separate threads
+  int verbose;
+  int quiet;
+} ConversionParams;
+
 //------------------------------------------------------------------------------
 
 static void Help(void) {
   printf("Usage:\n");
   printf(" gif2webp [options] gif_file -o webp_file\n");
+  printf(" gif2webp [options] -outdir dir gif_file [gif_file...]\n");
   printf("Options:\n");
   printf("  -h / -help ............. this help\n");
   printf("  -lossy ................. encode image using lossy compression\n");
@@ -87,6 +102,10 @@ static void Help(void) {
   printf("  -loop_compatibility .... use compatibility mode for Chrome\n");
   printf("                           version prior to M62 (inclusive)\n");
   printf("  -mt .................... use multi-threading if available\n");
+  printf("  -outdir <string> ....... convert all the input files, saving\n"
+         "                           each of them as <dir>/<name>.webp\n");
+  printf("  -jobs <int> ............ number of files converted in parallel\n"
+         "                           with -outdir (default: 1)\n");
   printf("\n");
   printf("  -version ............... print version number and exit\n");
   printf("  -v ..................... verbose\n");
@@ -95,183 +114,213 @@ static void Help(void) {
 }
 
 //------------------------------------------------------------------------------
+// Frame pipeline
+//
+// Composited canvases are handed over to the animation encoder through a
+// small ring of pictures. When threads are available (and -mt is used), the
+// encoder consumes them on its own thread while the GIF is being decoded.
+
+#define FRAME_QUEUE_SIZE 4
+
+typedef struct {
+  WebPAnimEncoder* enc;
+  const WebPConfig* config;
+  int num_added;      // number of frames successfully added to 'enc'
+  int use_thread;
+#ifdef GIF2WEBP_USE_THREAD
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;   // signaled whenever one of the fields below changes
+  WebPPicture canvases[FRAME_QUEUE_SIZE];
+  int timestamps[FRAME_QUEUE_SIZE];
+  int first;          // index of the oldest queued canvas
+  int count;          // number of queued canvases
+  int done;           // true once no more canvases will be queued
+  int error;          // true if the encoder failed
+#endif
+} FramePipeline;
+
+static int AddFrameToEncoder(FramePipeline* const pipe,
+                             WebPPicture* const canvas, int timestamp) {
+  if (!WebPAnimEncoderAdd(pipe->enc, canvas, timestamp, pipe->config)) {
+    fprintf(stderr, "Error while adding frame #%d: %s\n", pipe->num_added,
+            WebPAnimEncoderGetError(pipe->enc));
+    return 0;
+  }
+  ++pipe->num_added;
+  return 1;
+}
 
-int main(int argc, const char* argv[]) {
-  int verbose = 0;
+#ifdef GIF2WEBP_USE_THREAD
+static void* PipelineThreadLoop(void* ptr) {
+  FramePipeline* const pipe = (FramePipeline*)ptr;
+  while (1) {
+    int slot, ok;
+    pthread_mutex_lock(&pipe->mutex);
+    while (pipe->count == 0 && !pipe->done) {
+      pthread_cond_wait(&pipe->cond, &pipe->mutex);
+    }
+    if (pipe->count == 0) {   // done and drained
+      pthread_mutex_unlock(&pipe->mutex);
+      break;
+    }
+    slot = pipe->first;
+    pthread_mutex_unlock(&pipe->mutex);
+
+    // The producer never touches a queued slot, so no locking is needed here.
+    ok = AddFrameToEncoder(pipe, &pipe->canvases[slot], pipe->timestamps[slot]);
+
+    pthread_mutex_lock(&pipe->mutex);
+    if (ok) {
+      pipe->first = (pipe->first + 1) % FRAME_QUEUE_SIZE;
+      --pipe->count;
+    } else {
+      pipe->error = 1;
+    }
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->mutex);
+    if (!ok) break;
+  }
+  return NULL;
+}
+#endif  // GIF2WEBP_USE_THREAD
+
+// 'canvas' is only used as a model for the queued pictures' dimensions.
+// Falls back to adding frames synchronously if the thread can't be started.
+static void PipelineInit(FramePipeline* const pipe, WebPAnimEncoder* const enc,
+                         const WebPConfig* const config,
+                         const WebPPicture* const canvas, int use_thread) {
+  memset(pipe, 0, sizeof(*pipe));
+  pipe->enc = enc;
+  pipe->config = config;
+#ifdef GIF2WEBP_USE_THREAD
+  if (use_thread) {
+    int i, ok = 1;
+    for (i = 0; i < FRAME_QUEUE_SIZE; ++i) WebPPictureInit(&pipe->canvases[i]);
+    for (i = 0; ok && i < FRAME_QUEUE_SIZE; ++i) {
+      ok = WebPPictureCopy(canvas, &pipe->canvases[i]);
+    }
+    if (ok && pthread_mutex_init(&pipe->mutex, NULL) == 0) {
+      if (pthread_cond_init(&pipe->cond, NULL) == 0) {
+        if (!pthread_create(&pipe->thread, NULL, PipelineThreadLoop, pipe)) {
+          pipe->use_thread = 1;
+          return;
+        }
+        pthread_cond_destroy(&pipe->cond);
+      }
+      pthread_mutex_destroy(&pipe->mutex);
+    }
+    for (i = 0; i < FRAME_QUEUE_SIZE; ++i) WebPPictureFree(&pipe->canvases[i]);
+  }
+#else
+  (void)canvas;
+  (void)use_thread;
+#endif
+}
+
+// Queues a copy of 'canvas'. Blocks while the queue is full.
+static int PipelineAddFrame(FramePipeline* const pipe,
+                            WebPPicture* const canvas, int timestamp) {
+#ifdef GIF2WEBP_USE_THREAD
+  if (pipe->use_thread) {
+    int slot;
+    pthread_mutex_lock(&pipe->mutex);
+    while (pipe->count == FRAME_QUEUE_SIZE && !pipe->error) {
+      pthread_cond_wait(&pipe->cond, &pipe->mutex);
+    }
+    if (pipe->error) {
+      pthread_mutex_unlock(&pipe->mutex);
+      return 0;
+    }
+    slot = (pipe->first + pipe->count) % FRAME_QUEUE_SIZE;
+    pthread_mutex_unlock(&pipe->mutex);
+
+    GIFCopyPixels(canvas, &pipe->canvases[slot]);
+    pipe->timestamps[slot] = timestamp;
+
+    pthread_mutex_lock(&pipe->mutex);
+    ++pipe->count;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->mutex);
+    return 1;
+  }
+#endif
+  return AddFrameToEncoder(pipe, canvas, timestamp);
+}
+
+// Waits for all queued frames to be encoded and releases the thread.
+// Returns false if any of them failed. Can be called several times.
+static int PipelineEnd(FramePipeline* const pipe) {
+#ifdef GIF2WEBP_USE_THREAD
+  if (pipe->use_thread) {
+    int i;
+    pthread_mutex_lock(&pipe->mutex);
+    pipe->done = 1;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->mutex);
+    pthread_join(pipe->thread, NULL);
+    pthread_cond_destroy(&pipe->cond);
+    pthread_mutex_destroy(&pipe->mutex);
+    for (i = 0; i < FRAME_QUEUE_SIZE; ++i) WebPPictureFree(&pipe->canvases[i]);
+    pipe->use_thread = 0;
+    return !pipe->error;
+  }
+  return !pipe->error;
+#else
+  (void)pipe;
+  return 1;
+#endif
+}
+
+//------------------------------------------------------------------------------
+
+// Converts 'in_file' and saves the result to 'out_file' (if not NULL).
+// Returns true on success.
+static int ConvertGIF(const W_CHAR* const in_file, const W_CHAR* const out_file,
+                      const ConversionParams* const params) {
+  const int verbose = params->verbose;
+  const int quiet = params->quiet;
+  const int keep_metadata = params->keep_metadata;
+  const int loop_compatibility = params->loop_compatibility;
+  const WebPConfig* const config = &params->config;
   int gif_error = GIF_ERROR;
   WebPMuxError err = WEBP_MUX_OK;
   int ok = 0;
-  const W_CHAR* in_file = NULL, *out_file = NULL;
   GifFileType* gif = NULL;
   int frame_duration = 0;
   int frame_timestamp = 0;
   GIFDisposeMethod orig_dispose = GIF_DISPOSE_NONE;
+  int transparent_index = GIF_INDEX_INVALID;  // Opaque by default.
 
   WebPPicture frame;                // Frame rectangle only (not disposed).
   WebPPicture curr_canvas;          // Not disposed.
   WebPPicture prev_canvas;          // Disposed.
 
   WebPAnimEncoder* enc = NULL;
-  WebPAnimEncoderOptions enc_options;
-  WebPConfig config;
+  WebPAnimEncoderOptions enc_options = params->enc_options;
+  FramePipeline pipe;
+  int pipe_started = 0;
 
   int frame_number = 0;     // Whether we are processing the first frame.
   int done;
-  int c;
-  int quiet = 0;
   WebPData webp_data;
 
-  int keep_metadata = METADATA_XMP;  // ICC not output by default.
   WebPData icc_data;
   int stored_icc = 0;         // Whether we have already stored an ICC profile.
   WebPData xmp_data;
   int stored_xmp = 0;         // Whether we have already stored an XMP profile.
   int loop_count = 0;         // default: infinite
   int stored_loop_count = 0;  // Whether we have found an explicit loop count.
-  int loop_compatibility = 0;
   WebPMux* mux = NULL;
 
-  int default_kmin = 1;  // Whether to use default kmin value.
-  int default_kmax = 1;
-
-  INIT_WARGV(argc, argv);
-
-  if (!WebPConfigInit(&config) || !WebPAnimEncoderOptionsInit(&enc_options) ||
-      !WebPPictureInit(&frame) || !WebPPictureInit(&curr_canvas) ||
+  if (!WebPPictureInit(&frame) || !WebPPictureInit(&curr_canvas) ||
       !WebPPictureInit(&prev_canvas)) {
-    fprintf(stderr, "Error! Version mismatch!\n");
-    FREE_WARGV_AND_RETURN(-1);
+    return 0;
   }
-  config.lossless = 1;  // Use lossless compression by default.
-
   WebPDataInit(&webp_data);
   WebPDataInit(&icc_data);
   WebPDataInit(&xmp_data);
 
-  if (argc == 1) {
-    Help();
-    FREE_WARGV_AND_RETURN(0);
-  }
-
-  for (c = 1; c < argc; ++c) {
-    int parse_error = 0;
-    if (!strcmp(argv[c], "-h") || !strcmp(argv[c], "-help")) {
-      Help();
-      FREE_WARGV_AND_RETURN(0);
-    } else if (!strcmp(argv[c], "-o") && c < argc - 1) {
-      out_file = GET_WARGV(argv, ++c);
-    } else if (!strcmp(argv[c], "-lossy")) {
-      config.lossless = 0;
-    } else if (!strcmp(argv[c], "-mixed")) {
-      enc_options.allow_mixed = 1;
-      config.lossless = 0;
-    } else if (!strcmp(argv[c], "-loop_compatibility")) {
-      loop_compatibility = 1;
-    } else if (!strcmp(argv[c], "-q") && c < argc - 1) {
-      config.quality = ExUtilGetFloat(argv[++c], &parse_error);
-    } else if (!strcmp(argv[c], "-m") && c < argc - 1) {
-      config.method = ExUtilGetInt(argv[++c], 0, &parse_error);
-    } else if (!strcmp(argv[c], "-min_size")) {
-      enc_options.minimize_size = 1;
-    } else if (!strcmp(argv[c], "-kmax") && c < argc - 1) {
-      enc_options.kmax = ExUtilGetInt(argv[++c], 0, &parse_error);
-      default_kmax = 0;
-    } else if (!strcmp(argv[c], "-kmin") && c < argc - 1) {
-      enc_options.kmin = ExUtilGetInt(argv[++c], 0, &parse_error);
-      default_kmin = 0;
-    } else if (!strcmp(argv[c], "-f") && c < argc - 1) {
-      config.filter_strength = ExUtilGetInt(argv[++c], 0, &parse_error);
-    } else if (!strcmp(argv[c], "-metadata") && c < argc - 1) {
-      static const struct {
-        const char* option;
-        int flag;
-      } kTokens[] = {
-        { "all",  METADATA_ALL },
-        { "none", 0 },
-        { "icc",  METADATA_ICC },
-        { "xmp",  METADATA_XMP },
-      };
-      const size_t kNumTokens = sizeof(kTokens) / sizeof(*kTokens);
-      const char* start = argv[++c];
-      const char* const end = start + strlen(start);
-
-      keep_metadata = 0;
-      while (start < end) {
-        size_t i;
-        const char* token = strchr(start, ',');
-        if (token == NULL) token = end;
-
-        for (i = 0; i < kNumTokens; ++i) {
-          if ((size_t)(token - start) == strlen(kTokens[i].option) &&
-              !strncmp(start, kTokens[i].option, strlen(kTokens[i].option))) {
-            if (kTokens[i].flag != 0) {
-              keep_metadata |= kTokens[i].flag;
-            } else {
-              keep_metadata = 0;
-            }
-            break;
-          }
-        }
-        if (i == kNumTokens) {
-          fprintf(stderr, "Error! Unknown metadata type '%.*s'\n",
-                  (int)(token - start), start);
-          Help();
-          FREE_WARGV_AND_RETURN(-1);
-        }
-        start = token + 1;
-      }
-    } else if (!strcmp(argv[c], "-mt")) {
-      ++config.thread_level;
-    } else if (!strcmp(argv[c], "-version")) {
-      const int enc_version = WebPGetEncoderVersion();
-      const int mux_version = WebPGetMuxVersion();
-      printf("WebP Encoder version: %d.%d.%d\nWebP Mux version: %d.%d.%d\n",
-             (enc_version >> 16) & 0xff, (enc_version >> 8) & 0xff,
-             enc_version & 0xff, (mux_version >> 16) & 0xff,
-             (mux_version >> 8) & 0xff, mux_version & 0xff);
-      FREE_WARGV_AND_RETURN(0);
-    } else if (!strcmp(argv[c], "-quiet")) {
-      quiet = 1;
-      enc_options.verbose = 0;
-    } else if (!strcmp(argv[c], "-v")) {
-      verbose = 1;
-      enc_options.verbose = 1;
-    } else if (!strcmp(argv[c], "--")) {
-      if (c < argc - 1) in_file = GET_WARGV(argv, ++c);
-      break;
-    } else if (argv[c][0] == '-') {
-      fprintf(stderr, "Error! Unknown option '%s'\n", argv[c]);
-      Help();
-      FREE_WARGV_AND_RETURN(-1);
-    } else {
-      in_file = GET_WARGV(argv, c);
-    }
-
-    if (parse_error) {
-      Help();
-      FREE_WARGV_AND_RETURN(-1);
-    }
-  }
-
-  // Appropriate default kmin, kmax values for lossy and lossless.
-  if (default_kmin) {
-    enc_options.kmin = config.lossless ? 9 : 3;
-  }
-  if (default_kmax) {
-    enc_options.kmax = config.lossless ? 17 : 5;
-  }
-
-  if (!WebPValidateConfig(&config)) {
-    fprintf(stderr, "Error! Invalid configuration.\n");
-    goto End;
-  }
-
-  if (in_file == NULL) {
-    fprintf(stderr, "No input file specified!\n");
-    Help();
-    goto End;
-  }
-
   // Start the decoder object
   gif = DGifOpenFileUnicode(in_file, &gif_error);
   if (gif == NULL) goto End;
@@ -331,6 +380,8 @@ int main(int argc, const char* argv[]) {
                     "a memory error.\n");
             goto End;
           }
+          PipelineInit(&pipe, enc, config, &curr_canvas, params->use_pipeline);
+          pipe_started = 1;
         }
 
         // Some even more broken GIF can have sub-rect with zero width/height.
@@ -346,9 +397,7 @@ int main(int argc, const char* argv[]) {
         // Note that 'curr_canvas' is same as 'prev_canvas' at this point.
         GIFBlendFrames(&frame, &gif_rect, &curr_canvas);
 
-        if (!WebPAnimEncoderAdd(enc, &curr_canvas, frame_timestamp, &config)) {
-          fprintf(stderr, "Error while adding frame #%d: %s\n", frame_number,
-                  WebPAnimEncoderGetError(enc));
+        if (!PipelineAddFrame(&pipe, &curr_canvas, frame_timestamp)) {
           goto End;
         } else {
           ++frame_number;
@@ -455,6 +504,9 @@ int main(int argc, const char* argv[]) {
     }
   } while (!done);
 
+  // Wait for the frames still in flight.
+  if (pipe_started && !PipelineEnd(&pipe)) goto End;
+
   // Last NULL frame.
   if (!WebPAnimEncoderAdd(enc, NULL, frame_timestamp, NULL)) {
     fprintf(stderr, "Error flushing WebP muxer.\n");
@@ -568,6 +620,7 @@ int main(int argc, const char* argv[]) {
   gif_error = GIF_OK;
 
  End:
+  if (pipe_started) PipelineEnd(&pipe);
   WebPDataClear(&icc_data);
   WebPDataClear(&xmp_data);
   WebPMuxDelete(mux);
@@ -587,7 +640,304 @@ int main(int argc, const char* argv[]) {
     DGifCloseFile(gif);
 #endif
   }
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Batch conversion
+
+typedef struct {
+  const W_CHAR** in_files;
+  int num_files;
+  const W_CHAR* out_dir;
+  const ConversionParams* params;
+  int next_file;      // index of the next file to convert
+  int num_errors;
+#ifdef GIF2WEBP_USE_THREAD
+  pthread_mutex_t mutex;
+#endif
+} BatchJob;
+
+// Builds '<out_dir>/<in_file base name without extension>.webp'.
+static int GetBatchOutputName(const W_CHAR* const in_file,
+                              const W_CHAR* const out_dir,
+                              W_CHAR* const out_file, size_t size) {
+  const W_CHAR* base = WSTRRCHR(in_file, '/');
+  const W_CHAR* ext;
+  int len;
+#if defined(_WIN32)
+  const W_CHAR* const base2 = WSTRRCHR(in_file, '\\');
+  if (base2 != NULL && (base == NULL || base2 > base)) base = base2;
+#endif
+  base = (base != NULL) ? base + 1 : in_file;
+  ext = WSTRRCHR(base, '.');
+  len = (ext != NULL && ext != base) ? (int)(ext - base) : (int)WSTRLEN(base);
+  len = WSNPRINTF(out_file, size, "%s/%.*s.webp", out_dir, len, base);
+  return (len > 0 && (size_t)len < size);
+}
+
+static void* BatchThreadLoop(void* ptr) {
+  BatchJob* const job = (BatchJob*)ptr;
+  while (1) {
+    W_CHAR out_file[4096];
+    int index, ok;
+#ifdef GIF2WEBP_USE_THREAD
+    pthread_mutex_lock(&job->mutex);
+#endif
+    index = job->next_file++;
+#ifdef GIF2WEBP_USE_THREAD
+    pthread_mutex_unlock(&job->mutex);
+#endif
+    if (index >= job->num_files) break;
 
+    ok = GetBatchOutputName(job->in_files[index], job->out_dir, out_file,
+                            sizeof(out_file) / sizeof(out_file[0]));
+    if (!ok) {
+      WFPRINTF(stderr, "Error! Output path too long for: %s\n",
+               job->in_files[index]);
+    } else {
+      ok = ConvertGIF(job->in_files[index], out_file, job->params);
+      if (!ok) {
+        WFPRINTF(stderr, "Error converting %s\n", job->in_files[index]);
+      }
+    }
+    if (!ok) {
+#ifdef GIF2WEBP_USE_THREAD
+      pthread_mutex_lock(&job->mutex);
+#endif
+      ++job->num_errors;
+#ifdef GIF2WEBP_USE_THREAD
+      pthread_mutex_unlock(&job->mutex);
+#endif
+    }
+  }
+  return NULL;
+}
+
+// Converts all of 'in_files' into 'out_dir', using up to 'num_jobs' threads.
+// Returns the number of files that failed.
+static int ConvertBatch(const W_CHAR** const in_files, int num_files,
+                        const W_CHAR* const out_dir, int num_jobs,
+                        const ConversionParams* const params) {
+  BatchJob job;
+  job.in_files = in_files;
+  job.num_files = num_files;
+  job.out_dir = out_dir;
+  job.params = params;
+  job.next_file = 0;
+  job.num_errors = 0;
+#ifdef GIF2WEBP_USE_THREAD
+  if (pthread_mutex_init(&job.mutex, NULL) != 0) return num_files;
+  if (num_jobs > num_files) num_jobs = num_files;
+  {
+    pthread_t* const threads = (num_jobs > 1) ?
+        (pthread_t*)malloc((num_jobs - 1) * sizeof(*threads)) : NULL;
+    int num_threads = 0;
+    if (threads != NULL) {
+      while (num_threads < num_jobs - 1 &&
+             pthread_create(&threads[num_threads], NULL, BatchThreadLoop,
+                            &job) == 0) {
+        ++num_threads;
+      }
+    }
+    BatchThreadLoop(&job);   // the main thread takes its share too
+    while (num_threads > 0) pthread_join(threads[--num_threads], NULL);
+    free(threads);
+  }
+  pthread_mutex_destroy(&job.mutex);
+#else
+  (void)num_jobs;
+  BatchThreadLoop(&job);
+#endif
+  return job.num_errors;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, const char* argv[]) {
+  int ok = 0;
+  const W_CHAR* in_file = NULL, *out_file = NULL;
+  const W_CHAR* out_dir = NULL;
+  const W_CHAR** in_files = NULL;
+  int num_in_files = 0;
+  int num_jobs = 1;
+  int c;
+  ConversionParams params;
+
+  int default_kmin = 1;  // Whether to use default kmin value.
+  int default_kmax = 1;
+
+  INIT_WARGV(argc, argv);
+
+  if (!WebPConfigInit(&params.config) ||
+      !WebPAnimEncoderOptionsInit(&params.enc_options)) {
+    fprintf(stderr, "Error! Version mismatch!\n");
+    FREE_WARGV_AND_RETURN(-1);
+  }
+  params.config.lossless = 1;  // Use lossless compression by default.
+  params.keep_metadata = METADATA_XMP;  // ICC not output by default.
+  params.loop_compatibility = 0;
+  params.use_pipeline = 0;
+  params.verbose = 0;
+  params.quiet = 0;
+
+  if (argc == 1) {
+    Help();
+    FREE_WARGV_AND_RETURN(0);
+  }
+
+  // Input files are collected in argv order (at most argc - 1 of them).
+  in_files = (const W_CHAR**)malloc(argc * sizeof(*in_files));
+  if (in_files == NULL) {
+    fprintf(stderr, "Error! Memory allocation failed.\n");
+    FREE_WARGV_AND_RETURN(-1);
+  }
+
+  for (c = 1; c < argc; ++c) {
+    int parse_error = 0;
+    if (!strcmp(argv[c], "-h") || !strcmp(argv[c], "-help")) {
+      Help();
+      free(in_files);
+      FREE_WARGV_AND_RETURN(0);
+    } else if (!strcmp(argv[c], "-o") && c < argc - 1) {
+      out_file = GET_WARGV(argv, ++c);
+    } else if (!strcmp(argv[c], "-outdir") && c < argc - 1) {
+      out_dir = GET_WARGV(argv, ++c);
+    } else if (!strcmp(argv[c], "-jobs") && c < argc - 1) {
+      num_jobs = ExUtilGetInt(argv[++c], 0, &parse_error);
+      if (num_jobs < 1) num_jobs = 1;
+    } else if (!strcmp(argv[c], "-lossy")) {
+      params.config.lossless = 0;
+    } else if (!strcmp(argv[c], "-mixed")) {
+      params.enc_options.allow_mixed = 1;
+      params.config.lossless = 0;
+    } else if (!strcmp(argv[c], "-loop_compatibility")) {
+      params.loop_compatibility = 1;
+    } else if (!strcmp(argv[c], "-q") && c < argc - 1) {
+      params.config.quality = ExUtilGetFloat(argv[++c], &parse_error);
+    } else if (!strcmp(argv[c], "-m") && c < argc - 1) {
+      params.config.method = ExUtilGetInt(argv[++c], 0, &parse_error);
+    } else if (!strcmp(argv[c], "-min_size")) {
+      params.enc_options.minimize_size = 1;
+    } else if (!strcmp(argv[c], "-kmax") && c < argc - 1) {
+      params.enc_options.kmax = ExUtilGetInt(argv[++c], 0, &parse_error);
+      default_kmax = 0;
+    } else if (!strcmp(argv[c], "-kmin") && c < argc - 1) {
+      params.enc_options.kmin = ExUtilGetInt(argv[++c], 0, &parse_error);
+      default_kmin = 0;
+    } else if (!strcmp(argv[c], "-f") && c < argc - 1) {
+      params.config.filter_strength = ExUtilGetInt(argv[++c], 0, &parse_error);
+    } else if (!strcmp(argv[c], "-metadata") && c < argc - 1) {
+      static const struct {
+        const char* option;
+        int flag;
+      } kTokens[] = {
+        { "all",  METADATA_ALL },
+        { "none", 0 },
+        { "icc",  METADATA_ICC },
+        { "xmp",  METADATA_XMP },
+      };
+      const size_t kNumTokens = sizeof(kTokens) / sizeof(*kTokens);
+      const char* start = argv[++c];
+      const char* const end = start + strlen(start);
+
+      params.keep_metadata = 0;
+      while (start < end) {
+        size_t i;
+        const char* token = strchr(start, ',');
+        if (token == NULL) token = end;
+
+        for (i = 0; i < kNumTokens; ++i) {
+          if ((size_t)(token - start) == strlen(kTokens[i].option) &&
+              !strncmp(start, kTokens[i].option, strlen(kTokens[i].option))) {
+            if (kTokens[i].flag != 0) {
+              params.keep_metadata |= kTokens[i].flag;
+            } else {
+              params.keep_metadata = 0;
+            }
+            break;
+          }
+        }
+        if (i == kNumTokens) {
+          fprintf(stderr, "Error! Unknown metadata type '%.*s'\n",
+                  (int)(token - start), start);
+          Help();
+          free(in_files);
+          FREE_WARGV_AND_RETURN(-1);
+        }
+        start = token + 1;
+      }
+    } else if (!strcmp(argv[c], "-mt")) {
+      ++params.config.thread_level;
+      params.use_pipeline = 1;
+    } else if (!strcmp(argv[c], "-version")) {
+      const int enc_version = WebPGetEncoderVersion();
+      const int mux_version = WebPGetMuxVersion();
+      printf("WebP Encoder version: %d.%d.%d\nWebP Mux version: %d.%d.%d\n",
+             (enc_version >> 16) & 0xff, (enc_version >> 8) & 0xff,
+             enc_version & 0xff, (mux_version >> 16) & 0xff,
+             (mux_version >> 8) & 0xff, mux_version & 0xff);
+      free(in_files);
+      FREE_WARGV_AND_RETURN(0);
+    } else if (!strcmp(argv[c], "-quiet")) {
+      params.quiet = 1;
+      params.enc_options.verbose = 0;
+    } else if (!strcmp(argv[c], "-v")) {
+      params.verbose = 1;
+      params.enc_options.verbose = 1;
+    } else if (!strcmp(argv[c], "--")) {
+      while (c < argc - 1) in_files[num_in_files++] = GET_WARGV(argv, ++c);
+      break;
+    } else if (argv[c][0] == '-') {
+      fprintf(stderr, "Error! Unknown option '%s'\n", argv[c]);
+      Help();
+      free(in_files);
+      FREE_WARGV_AND_RETURN(-1);
+    } else {
+      in_files[num_in_files++] = GET_WARGV(argv, c);
+    }
+
+    if (parse_error) {
+      Help();
+      free(in_files);
+      FREE_WARGV_AND_RETURN(-1);
+    }
+  }
+
+  // Appropriate default kmin, kmax values for lossy and lossless.
+  if (default_kmin) {
+    params.enc_options.kmin = params.config.lossless ? 9 : 3;
+  }
+  if (default_kmax) {
+    params.enc_options.kmax = params.config.lossless ? 17 : 5;
+  }
+
+  if (!WebPValidateConfig(&params.config)) {
+    fprintf(stderr, "Error! Invalid configuration.\n");
+    goto End;
+  }
+
+  if (num_in_files == 0) {
+    fprintf(stderr, "No input file specified!\n");
+    Help();
+    goto End;
+  }
+
+  if (out_dir != NULL) {
+    if (out_file != NULL) {
+      fprintf(stderr, "Error! -o and -outdir can't be used together.\n");
+      goto End;
+    }
+    ok = (ConvertBatch(in_files, num_in_files, out_dir, num_jobs,
+                       &params) == 0);
+  } else {
+    // Without -outdir, only the last input file is considered.
+    in_file = in_files[num_in_files - 1];
+    ok = ConvertGIF(in_file, out_file, &params);
+  }
+
+ End:
+  free(in_files);
   FREE_WARGV_AND_RETURN(!ok);
 }
 
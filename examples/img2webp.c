@@ -23,6 +23,11 @@
 #include "webp/config.h"
 #endif
 
+#if defined(WEBP_USE_THREAD) && !defined(_WIN32)
+#include <pthread.h>
+#define IMG2WEBP_USE_THREAD
+#endif
+
 #include "../examples/example_util.h"
 #include "../imageio/image_dec.h"
 #include "../imageio/imageio_util.h"
@@ -47,6 +52,8 @@ static void Help(void) {
   printf(" -kmin <int> .......... minimum number of frame between key-frames\n"
          "                        (0=disable key-frames altogether)\n");
   printf(" -mixed ............... use mixed lossy/lossless automatic mode\n");
+  printf(" -mt .................. use multi-threading if available: upcoming\n"
+         "                        frames are decoded while encoding\n");
   printf(" -v ................... verbose mode\n");
   printf(" -h ................... this help\n");
   printf(" -version ............. print version number and exit\n");
@@ -121,6 +128,146 @@ static int SetLoopCount(int loop_count, WebPData* const webp_data) {
   return ok;
 }
 
+//------------------------------------------------------------------------------
+// Frame prefetching
+//
+// Input images are decoded ahead of time by worker threads into a ring of
+// pictures, while the animation encoder consumes them in order.
+
+// Per-frame settings, as parsed from the command line.
+typedef struct {
+  WebPConfig config;
+  int duration;
+} FrameParams;
+
+#define PREFETCH_RING_SIZE 4
+#define PREFETCH_NUM_THREADS 3
+
+typedef enum {
+  SLOT_EMPTY = 0,   // not decoded yet (or already handed to the encoder)
+  SLOT_READY,       // decoded picture available
+  SLOT_FAILED       // decoding failed
+} SlotStatus;
+
+typedef struct {
+  const char** files;   // input file names, in frame order
+  int num_files;
+  int num_threads;      // 0 if frames are decoded synchronously
+#ifdef IMG2WEBP_USE_THREAD
+  pthread_t threads[PREFETCH_NUM_THREADS];
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;  // signaled whenever one of the fields below changes
+  WebPPicture pics[PREFETCH_RING_SIZE];
+  SlotStatus status[PREFETCH_RING_SIZE];
+  int next_to_decode;   // index of the next file to be claimed by a thread
+  int next_to_get;      // index of the next frame expected by the encoder
+  int stop;             // true if the threads must exit
+#endif
+} FramePrefetcher;
+
+#ifdef IMG2WEBP_USE_THREAD
+static void* PrefetchThreadLoop(void* ptr) {
+  FramePrefetcher* const pf = (FramePrefetcher*)ptr;
+  pthread_mutex_lock(&pf->mutex);
+  while (1) {
+    int index, slot, ok;
+    // Never run more than PREFETCH_RING_SIZE frames ahead of the encoder.
+    while (!pf->stop && pf->next_to_decode < pf->num_files &&
+           pf->next_to_decode >= pf->next_to_get + PREFETCH_RING_SIZE) {
+      pthread_cond_wait(&pf->cond, &pf->mutex);
+    }
+    if (pf->stop || pf->next_to_decode >= pf->num_files) break;
+    index = pf->next_to_decode++;
+    slot = index % PREFETCH_RING_SIZE;
+    pthread_mutex_unlock(&pf->mutex);
+
+    // The slot was released by the encoder and is owned by this thread now.
+    WebPPictureInit(&pf->pics[slot]);
+    pf->pics[slot].use_argb = 1;
+    ok = ReadImage(pf->files[index], &pf->pics[slot]);
+
+    pthread_mutex_lock(&pf->mutex);
+    pf->status[slot] = ok ? SLOT_READY : SLOT_FAILED;
+    pthread_cond_broadcast(&pf->cond);
+  }
+  pthread_mutex_unlock(&pf->mutex);
+  return NULL;
+}
+#endif  // IMG2WEBP_USE_THREAD
+
+// Starts decoding 'files' ahead if 'use_threads' is true and threads are
+// available. Otherwise, frames are decoded upon request.
+static void PrefetcherInit(FramePrefetcher* const pf, const char** files,
+                           int num_files, int use_threads) {
+  memset(pf, 0, sizeof(*pf));
+  pf->files = files;
+  pf->num_files = num_files;
+#ifdef IMG2WEBP_USE_THREAD
+  if (use_threads && num_files > 1 &&
+      !pthread_mutex_init(&pf->mutex, NULL)) {
+    if (!pthread_cond_init(&pf->cond, NULL)) {
+      while (pf->num_threads < PREFETCH_NUM_THREADS &&
+             pf->num_threads < num_files &&
+             !pthread_create(&pf->threads[pf->num_threads], NULL,
+                             PrefetchThreadLoop, pf)) {
+        ++pf->num_threads;
+      }
+      if (pf->num_threads > 0) return;
+      pthread_cond_destroy(&pf->cond);
+    }
+    pthread_mutex_destroy(&pf->mutex);
+  }
+#else
+  (void)use_threads;
+#endif
+}
+
+// Retrieves the decoded frame #'index' into 'pic', which is then owned by the
+// caller. Frames must be requested in order. Returns false on decoding error.
+static int PrefetcherGetFrame(FramePrefetcher* const pf, int index,
+                              WebPPicture* const pic) {
+#ifdef IMG2WEBP_USE_THREAD
+  if (pf->num_threads > 0) {
+    const int slot = index % PREFETCH_RING_SIZE;
+    int ok;
+    pthread_mutex_lock(&pf->mutex);
+    while (pf->status[slot] == SLOT_EMPTY) {
+      pthread_cond_wait(&pf->cond, &pf->mutex);
+    }
+    ok = (pf->status[slot] == SLOT_READY);
+    *pic = pf->pics[slot];   // ownership transfer
+    WebPPictureInit(&pf->pics[slot]);
+    pf->status[slot] = SLOT_EMPTY;
+    pf->next_to_get = index + 1;
+    pthread_cond_broadcast(&pf->cond);
+    pthread_mutex_unlock(&pf->mutex);
+    return ok;
+  }
+#endif
+  pic->use_argb = 1;
+  return ReadImage(pf->files[index], pic);
+}
+
+// Stops the threads and releases the frames not yet retrieved.
+static void PrefetcherDelete(FramePrefetcher* const pf) {
+#ifdef IMG2WEBP_USE_THREAD
+  if (pf->num_threads > 0) {
+    int i;
+    pthread_mutex_lock(&pf->mutex);
+    pf->stop = 1;
+    pthread_cond_broadcast(&pf->cond);
+    pthread_mutex_unlock(&pf->mutex);
+    for (i = 0; i < pf->num_threads; ++i) pthread_join(pf->threads[i], NULL);
+    for (i = 0; i < PREFETCH_RING_SIZE; ++i) WebPPictureFree(&pf->pics[i]);
+    pthread_cond_destroy(&pf->cond);
+    pthread_mutex_destroy(&pf->mutex);
+    pf->num_threads = 0;
+  }
+#else
+  (void)pf;
+#endif
+}
+
 //------------------------------------------------------------------------------
 
 int main(int argc, const char* argv[]) {
@@ -138,6 +285,11 @@ int main(int argc, const char* argv[]) {
   WebPData webp_data;
   int c;
   int have_input = 0;
+  int use_threads = 0;
+  const char** files = NULL;    // input files, in frame order
+  FrameParams* frame_params = NULL;
+  int num_frames = 0;
+  FramePrefetcher prefetcher;
   CommandLineArguments cmd_args;
   int ok;
 
@@ -149,6 +301,7 @@ int main(int argc, const char* argv[]) {
   argc = cmd_args.argc_;
   argv = cmd_args.argv_;
 
+  memset(&prefetcher, 0, sizeof(prefetcher));
   WebPDataInit(&webp_data);
   if (!WebPAnimEncoderOptionsInit(&anim_config) ||
       !WebPConfigInit(&config) ||
@@ -183,6 +336,9 @@ int main(int argc, const char* argv[]) {
       } else if (!strcmp(argv[c], "-mixed")) {
         anim_config.allow_mixed = 1;
         config.lossless = 0;
+      } else if (!strcmp(argv[c], "-mt")) {
+        use_threads = 1;
+        config.thread_level = 1;
       } else if (!strcmp(argv[c], "-v")) {
         verbose = 1;
       } else if (!strcmp(argv[c], "-h") || !strcmp(argv[c], "-help")) {
@@ -211,8 +367,15 @@ int main(int argc, const char* argv[]) {
     goto End;
   }
 
-  // image-reading pass
-  pic_num = 0;
+  files = (const char**)malloc(argc * sizeof(*files));
+  frame_params = (FrameParams*)malloc(argc * sizeof(*frame_params));
+  if (files == NULL || frame_params == NULL) {
+    fprintf(stderr, "Memory allocation error.\n");
+    ok = 0;
+    goto End;
+  }
+
+  // per-frame options pass
   config.lossless = 1;
   for (c = 0; ok && c < argc; ++c) {
     if (argv[c] == NULL) continue;
@@ -249,10 +412,23 @@ int main(int argc, const char* argv[]) {
       }
     }
 
+    files[num_frames] = (const char*)GET_WARGV_SHIFTED(argv, c);
+    frame_params[num_frames].config = config;
+    frame_params[num_frames].duration = duration;
+    ++num_frames;
+  }
+
+  // image-reading pass
+  PrefetcherInit(&prefetcher, files, num_frames, use_threads);
+  for (pic_num = 0; ok && pic_num < num_frames; ++pic_num) {
+    const FrameParams* const params = &frame_params[pic_num];
+
     // read next input image
-    pic.use_argb = 1;
-    ok = ReadImage((const char*)GET_WARGV_SHIFTED(argv, c), &pic);
-    if (!ok) goto End;
+    ok = PrefetcherGetFrame(&prefetcher, pic_num, &pic);
+    if (!ok) {
+      WebPPictureFree(&pic);
+      goto End;
+    }
 
     if (enc == NULL) {
       width  = pic.width;
@@ -274,7 +450,7 @@ int main(int argc, const char* argv[]) {
     }
 
     if (ok) {
-      ok = WebPAnimEncoderAdd(enc, &pic, timestamp_ms, &config);
+      ok = WebPAnimEncoderAdd(enc, &pic, timestamp_ms, &params->config);
       if (!ok) {
         fprintf(stderr, "Error while adding frame #%d\n", pic_num);
       }
@@ -284,10 +460,9 @@ int main(int argc, const char* argv[]) {
 
     if (verbose) {
       WFPRINTF(stderr, "Added frame #%3d at time %4d (file: %s)\n",
-               pic_num, timestamp_ms, GET_WARGV_SHIFTED(argv, c));
+               pic_num, timestamp_ms, (const W_CHAR*)files[pic_num]);
     }
-    timestamp_ms += duration;
-    ++pic_num;
+    timestamp_ms += params->duration;
   }
 
   // add a last fake frame to signal the last duration
@@ -299,6 +474,9 @@ int main(int argc, const char* argv[]) {
 
  End:
   // free resources
+  PrefetcherDelete(&prefetcher);
+  free(files);
+  free(frame_params);
   WebPAnimEncoderDelete(enc);
 
   if (ok && loop_count > 0) {  // Re-mux to add loop count.
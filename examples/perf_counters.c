@@ -0,0 +1,200 @@
+// Copyright 2019 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  Hardware performance counters, through perf_event_open().
+//
+
+#include "./perf_counters.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__NR_perf_event_open)
+
+#define NUM_COUNTERS 4
+#define MAX_STAGES 32
+#define MAX_STAGE_DEPTH 16
+
+static const struct {
+  uint32_t config_;
+  const char* name_;
+} kCounters[NUM_COUNTERS] = {
+  { PERF_COUNT_HW_CPU_CYCLES,    "cycles" },
+  { PERF_COUNT_HW_INSTRUCTIONS,  "instructions" },
+  { PERF_COUNT_HW_CACHE_MISSES,  "cache-misses" },
+  { PERF_COUNT_HW_BRANCH_MISSES, "branch-misses" }
+};
+
+typedef struct {
+  const char* name_;
+  int count_;                       // number of times the stage was run
+  double values_[NUM_COUNTERS];
+} Stage;
+
+typedef struct {
+  const char* name_;
+  double start_[NUM_COUNTERS];
+} OpenStage;
+
+static int fds[NUM_COUNTERS] = { -1, -1, -1, -1 };
+static int num_opened = 0;
+static int running = 0;
+static long thread_id = 0;     // the thread the stages are attributed for
+static double totals[NUM_COUNTERS];
+static Stage stages[MAX_STAGES];
+static int num_stages = 0;
+static OpenStage open_stages[MAX_STAGE_DEPTH];
+static int depth = 0;          // may exceed MAX_STAGE_DEPTH
+
+// Reads the current counts, scaled up if the counters were multiplexed.
+// Unavailable counters are set to -1.
+static void ReadCounters(double values[NUM_COUNTERS]) {
+  int i;
+  for (i = 0; i < NUM_COUNTERS; ++i) {
+    uint64_t data[3];   // value, time enabled, time running
+    values[i] = -1.;
+    if (fds[i] < 0 || read(fds[i], data, sizeof(data)) != sizeof(data)) {
+      continue;
+    }
+    values[i] = (data[2] == 0) ? 0. :
+                (data[2] < data[1]) ? (double)data[0] * data[1] / data[2] :
+                                      (double)data[0];
+  }
+}
+
+static void StageHook(const char* name, int is_begin, void* user_data) {
+  double now[NUM_COUNTERS];
+  (void)user_data;
+  if (syscall(SYS_gettid) != thread_id) return;
+  if (is_begin) {
+    if (depth < MAX_STAGE_DEPTH) {
+      open_stages[depth].name_ = name;
+      ReadCounters(open_stages[depth].start_);
+    }
+    ++depth;
+  } else if (depth > 0) {
+    --depth;
+    ReadCounters(now);
+    if (depth < MAX_STAGE_DEPTH && open_stages[depth].name_ == name) {
+      const OpenStage* const open_stage = &open_stages[depth];
+      Stage* stage = NULL;
+      int i;
+      for (i = 0; i < num_stages; ++i) {
+        if (stages[i].name_ == name) stage = &stages[i];
+      }
+      if (stage == NULL && num_stages < MAX_STAGES) {
+        stage = &stages[num_stages++];
+        memset(stage, 0, sizeof(*stage));
+        stage->name_ = name;
+      }
+      if (stage == NULL) return;
+      ++stage->count_;
+      for (i = 0; i < NUM_COUNTERS; ++i) {
+        stage->values_[i] = (now[i] < 0.) ? -1. :
+            stage->values_[i] + now[i] - open_stage->start_[i];
+      }
+    }
+  }
+}
+
+int PerfCountersStart(void) {
+  int i;
+  PerfCountersStop();
+  num_opened = 0;
+  num_stages = 0;
+  depth = 0;
+  for (i = 0; i < NUM_COUNTERS; ++i) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = kCounters[i].config_;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = 1;
+    attr.inherit = 1;   // also count the worker threads
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fds[i] >= 0) ++num_opened;
+  }
+  if (num_opened == 0) return 0;
+  thread_id = syscall(SYS_gettid);
+  for (i = 0; i < NUM_COUNTERS; ++i) {
+    if (fds[i] >= 0) ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+  }
+  WebPTraceSetHook(StageHook, NULL);
+  running = 1;
+  return num_opened;
+}
+
+void PerfCountersStop(void) {
+  int i;
+  if (!running) return;
+  running = 0;
+  WebPTraceSetHook(NULL, NULL);
+  ReadCounters(totals);
+  for (i = 0; i < NUM_COUNTERS; ++i) {
+    if (fds[i] >= 0) close(fds[i]);
+    fds[i] = -1;
+  }
+}
+
+static void PrintLine(FILE* const out, const char* const name, int count,
+                      const double values[NUM_COUNTERS]) {
+  int i;
+  fprintf(out, "  %-26s", name);
+  if (count > 1) {
+    fprintf(out, " x%-4d", count);
+  } else {
+    fprintf(out, "      ");
+  }
+  for (i = 0; i < NUM_COUNTERS; ++i) {
+    if (values[i] < 0.) {
+      fprintf(out, " %14s", "n/a");
+    } else {
+      fprintf(out, " %14.0f", values[i]);
+    }
+  }
+  if (values[0] > 0. && values[1] >= 0.) {
+    fprintf(out, " %6.2f", values[1] / values[0]);
+  }
+  fprintf(out, "\n");
+}
+
+void PerfCountersPrint(FILE* const out) {
+  int i;
+  if (num_opened == 0) {
+    fprintf(out, "Hardware counters: unavailable\n");
+    return;
+  }
+  fprintf(out, "Hardware counters (stages of the main thread, inclusive):\n");
+  fprintf(out, "  %-32s", "stage");
+  for (i = 0; i < NUM_COUNTERS; ++i) fprintf(out, " %14s", kCounters[i].name_);
+  fprintf(out, " %6s\n", "IPC");
+  PrintLine(out, "total", 1, totals);
+  for (i = 0; i < num_stages; ++i) {
+    PrintLine(out, stages[i].name_, stages[i].count_, stages[i].values_);
+  }
+}
+
+#else  // !__linux__
+
+int PerfCountersStart(void) { return 0; }
+void PerfCountersStop(void) {}
+void PerfCountersPrint(FILE* const out) {
+  fprintf(out, "Hardware counters: unavailable\n");
+}
+
+#endif  // __linux__
@@ -0,0 +1,46 @@
+// Copyright 2019 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  Hardware performance counters (cycles, instructions, cache and branch
+//  misses), attributed to the encoding/decoding stages. Only available on
+//  Linux, through perf_event_open().
+//
+
+#ifndef WEBP_EXAMPLES_PERF_COUNTERS_H_
+#define WEBP_EXAMPLES_PERF_COUNTERS_H_
+
+#include <stdio.h>
+
+#include "webp/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Starts counting for the calling thread and the threads it creates from now
+// on. The counts are also attributed to each of the library stages run by the
+// calling thread (see WebPTraceSetHook()). Returns the number of counters
+// that could be opened: 0 if none is supported by the system (or permitted,
+// see /proc/sys/kernel/perf_event_paranoid), in which case all the other
+// functions are no-ops.
+int PerfCountersStart(void);
+
+// Stops counting. The counts of the threads created since
+// PerfCountersStart() are only included once these threads are joined.
+void PerfCountersStop(void);
+
+// Prints the counts gathered between PerfCountersStart() and
+// PerfCountersStop(), in total and per stage.
+void PerfCountersPrint(FILE* const out);
+
+#ifdef __cplusplus
+}    // extern "C"
+#endif
+
+#endif  // WEBP_EXAMPLES_PERF_COUNTERS_H_
@@ -54,6 +54,8 @@
 #define TO_W_CHAR(STR) (L##STR)
 
 #define WFOPEN(ARG, OPT) _wfopen((const W_CHAR*)ARG, TO_W_CHAR(OPT))
+#define WRENAME(OLD, NEW) _wrename((const W_CHAR*)OLD, (const W_CHAR*)NEW)
+#define WREMOVE(ARG) _wremove((const W_CHAR*)ARG)
 
 #define WPRINTF(STR, ...) wprintf(TO_W_CHAR(STR), __VA_ARGS__)
 #define WFPRINTF(STDERR, STR, ...) fwprintf(STDERR, TO_W_CHAR(STR), __VA_ARGS__)
@@ -81,6 +83,8 @@
 #define TO_W_CHAR(STR) (STR)
 
 #define WFOPEN(ARG, OPT) fopen(ARG, OPT)
+#define WRENAME(OLD, NEW) rename(OLD, NEW)
+#define WREMOVE(ARG) remove(ARG)
 
 #define WPRINTF(STR, ...) printf(STR, __VA_ARGS__)
 #define WFPRINTF(STDERR, STR, ...) fprintf(STDERR, STR, __VA_ARGS__)
@@ -14,11 +14,17 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #ifdef HAVE_CONFIG_H
 #include "webp/config.h"
 #endif
 
+#if defined(WEBP_USE_THREAD) && !defined(_WIN32)
+#include <pthread.h>
+#define WEBPINFO_USE_THREAD
+#endif
+
 #include "../imageio/imageio_util.h"
 #include "./unicode.h"
 #include "webp/decode.h"
@@ -100,6 +106,14 @@ typedef struct {
   ChunkID id_;
 } ChunkData;
 
+// Bitstream header of an image chunk, read ahead of the chunk processing.
+typedef struct {
+  const uint8_t* data_;   // start of the chunk
+  size_t size_;
+  VP8StatusCode status_;
+  WebPBitstreamFeatures features_;
+} ImageCheck;
+
 typedef struct WebPInfo {
   int canvas_width_;
   int canvas_height_;
@@ -117,6 +131,9 @@ typedef struct WebPInfo {
   // Print output control.
   int quiet_, show_diagnosis_, show_summary_;
   int parse_bitstream_;
+  // Image chunks checked ahead, in file order.
+  ImageCheck* image_checks_;
+  int num_image_checks_, next_image_check_;
 } WebPInfo;
 
 static void WebPInfoInit(WebPInfo* const webp_info) {
@@ -791,8 +808,16 @@ static WebPInfoStatus ProcessImageChunk(const ChunkData* const chunk_data,
                                         WebPInfo* const webp_info) {
   const uint8_t* data = chunk_data->payload_ - CHUNK_HEADER_SIZE;
   WebPBitstreamFeatures features;
-  const VP8StatusCode vp8_status =
-      WebPGetFeatures(data, chunk_data->size_, &features);
+  VP8StatusCode vp8_status;
+  if (webp_info->next_image_check_ < webp_info->num_image_checks_ &&
+      webp_info->image_checks_[webp_info->next_image_check_].data_ == data) {
+    const ImageCheck* const check =
+        &webp_info->image_checks_[webp_info->next_image_check_++];
+    vp8_status = check->status_;
+    features = check->features_;
+  } else {
+    vp8_status = WebPGetFeatures(data, chunk_data->size_, &features);
+  }
   if (vp8_status != VP8_STATUS_OK) {
     LOG_ERROR("VP8/VP8L bitstream error.");
     return WEBP_INFO_BITSTREAM_ERROR;
@@ -1064,12 +1089,108 @@ static void ShowSummary(const WebPInfo* const webp_info) {
   printf("\n");
 }
 
+// -----------------------------------------------------------------------------
+// Image chunks checked ahead.
+
+// Animations with many frames have their image chunks checked concurrently,
+// by ranges of at least MIN_CHECKS_PER_THREAD chunks.
+#define MIN_CHECKS_PER_THREAD 2048
+#define MAX_CHECK_THREADS 4
+
+static void CheckImages(ImageCheck* const checks, int num_checks) {
+  int i;
+  for (i = 0; i < num_checks; ++i) {
+    checks[i].status_ = WebPGetFeatures(checks[i].data_, checks[i].size_,
+                                        &checks[i].features_);
+  }
+}
+
+#ifdef WEBPINFO_USE_THREAD
+typedef struct {
+  pthread_t thread;
+  ImageCheck* checks;
+  int num_checks;
+} CheckThread;
+
+static void* CheckThreadLoop(void* ptr) {
+  CheckThread* const t = (CheckThread*)ptr;
+  CheckImages(t->checks, t->num_checks);
+  return NULL;
+}
+#endif  // WEBPINFO_USE_THREAD
+
+// Lists the image chunks and reads their bitstream headers, which are then
+// used by ProcessImageChunk(). Nothing is reported here: errors are detected
+// again, in order, when processing the chunks.
+static void CheckImageChunks(WebPInfo* const webp_info,
+                             const WebPData* webp_data) {
+  WebPInfo silent_info = *webp_info;
+  MemBuffer mem_buffer;
+  ChunkData chunk_data;
+  int num_checks = 0, max_checks = 0;
+  int first = 0;
+
+  silent_info.quiet_ = 1;
+  silent_info.show_diagnosis_ = 0;
+  InitMemBuffer(&mem_buffer, webp_data);
+  if (ParseRIFFHeader(&silent_info, &mem_buffer) != WEBP_INFO_OK) return;
+  while (MemDataSize(&mem_buffer) > 0 &&
+         ParseChunk(&silent_info, &mem_buffer, &chunk_data) == WEBP_INFO_OK) {
+    if (chunk_data.id_ == CHUNK_VP8 || chunk_data.id_ == CHUNK_VP8L) {
+      ImageCheck* check;
+      if (num_checks == max_checks) {
+        const int new_max = (max_checks == 0) ? 16 : 2 * max_checks;
+        ImageCheck* const new_checks = (ImageCheck*)realloc(
+            webp_info->image_checks_, new_max * sizeof(*new_checks));
+        if (new_checks == NULL) break;  // the others are checked in place
+        webp_info->image_checks_ = new_checks;
+        max_checks = new_max;
+      }
+      check = &webp_info->image_checks_[num_checks++];
+      check->data_ = chunk_data.payload_ - CHUNK_HEADER_SIZE;
+      check->size_ = chunk_data.size_;
+    }
+  }
+
+#ifdef WEBPINFO_USE_THREAD
+  {
+    CheckThread threads[MAX_CHECK_THREADS];
+    int num_jobs = num_checks / MIN_CHECKS_PER_THREAD;
+    int num_threads = 0;
+    int i;
+    if (num_jobs > MAX_CHECK_THREADS) num_jobs = MAX_CHECK_THREADS;
+    // The last range is checked by the calling thread.
+    while (num_threads + 1 < num_jobs) {
+      CheckThread* const t = &threads[num_threads];
+      const int last = num_checks * (num_threads + 1) / num_jobs;
+      t->checks = webp_info->image_checks_ + first;
+      t->num_checks = last - first;
+      if (pthread_create(&t->thread, NULL, CheckThreadLoop, t)) break;
+      ++num_threads;
+      first = last;
+    }
+    CheckImages(webp_info->image_checks_ + first, num_checks - first);
+    for (i = 0; i < num_threads; ++i) pthread_join(threads[i].thread, NULL);
+  }
+#else
+  CheckImages(webp_info->image_checks_ + first, num_checks - first);
+#endif
+  webp_info->num_image_checks_ = num_checks;
+  webp_info->next_image_check_ = 0;
+}
+
+#undef MIN_CHECKS_PER_THREAD
+#undef MAX_CHECK_THREADS
+
+// -----------------------------------------------------------------------------
+
 static WebPInfoStatus AnalyzeWebP(WebPInfo* const webp_info,
                                   const WebPData* webp_data) {
   ChunkData chunk_data;
   MemBuffer mem_buffer;
   WebPInfoStatus webp_info_status = WEBP_INFO_OK;
 
+  CheckImageChunks(webp_info, webp_data);
   InitMemBuffer(&mem_buffer, webp_data);
   webp_info_status = ParseRIFFHeader(webp_info, &mem_buffer);
   if (webp_info_status != WEBP_INFO_OK) goto Error;
@@ -1094,6 +1215,9 @@ static WebPInfoStatus AnalyzeWebP(WebPInfo* const webp_info,
       printf("Errors detected.\n");
     }
   }
+  free(webp_info->image_checks_);
+  webp_info->image_checks_ = NULL;
+  webp_info->num_image_checks_ = 0;
   return webp_info_status;
 }
 
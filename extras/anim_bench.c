@@ -0,0 +1,141 @@
+// Copyright 2019 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  Times the frame storage of the mux and demux libraries on a synthetic
+//  animation with many (tiny) frames: appending the frames, assembling,
+//  parsing and accessing each frame by its number.
+//
+//  Usage: anim_bench [num_frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef HAVE_CONFIG_H
+#include "webp/config.h"
+#endif
+
+#include "../examples/stopwatch.h"
+#include "webp/demux.h"
+#include "webp/mux.h"
+
+// 1x1 transparent lossless image.
+static const uint8_t kFrameBytes[] = {
+  0x52, 0x49, 0x46, 0x46, 0x14, 0x00, 0x00, 0x00, 0x57, 0x45, 0x42, 0x50,
+  0x56, 0x50, 0x38, 0x4c, 0x08, 0x00, 0x00, 0x00, 0x2f, 0x00, 0x00, 0x00,
+  0x10, 0x88, 0x88, 0x08
+};
+
+#define CANVAS_SIZE 256
+
+static void Report(const char* const what, int num_frames, double time) {
+  printf("%-28s %8.3fs  (%.3f us/frame)\n", what, time,
+         1e6 * time / num_frames);
+}
+
+int main(int argc, const char* argv[]) {
+  int ok = 0;
+  const int num_frames = (argc > 1) ? atoi(argv[1]) : 5000;
+  WebPMux* mux = WebPMuxNew();
+  WebPMux* mux_read = NULL;
+  WebPDemuxer* demux = NULL;
+  WebPData assembled = { NULL, 0 };
+  WebPMuxAnimParams params;
+  WebPIterator iter;
+  Stopwatch stop_watch;
+  int n;
+
+  if (num_frames <= 0 || mux == NULL) {
+    fprintf(stderr, "Usage: %s [num_frames]\n", argv[0]);
+    goto End;
+  }
+
+  StopwatchReset(&stop_watch);
+  for (n = 0; n < num_frames; ++n) {
+    WebPMuxFrameInfo info;
+    info.bitstream.bytes = kFrameBytes;
+    info.bitstream.size = sizeof(kFrameBytes);
+    info.x_offset = 2 * (n % (CANVAS_SIZE / 2));
+    info.y_offset = 2 * ((n / (CANVAS_SIZE / 2)) % (CANVAS_SIZE / 2));
+    info.duration = 10;
+    info.id = WEBP_CHUNK_ANMF;
+    info.dispose_method = WEBP_MUX_DISPOSE_NONE;
+    info.blend_method = WEBP_MUX_BLEND;
+    if (WebPMuxPushFrame(mux, &info, 0) != WEBP_MUX_OK) {
+      fprintf(stderr, "Error pushing frame #%d\n", n + 1);
+      goto End;
+    }
+  }
+  Report("WebPMuxPushFrame()", num_frames, StopwatchReadAndReset(&stop_watch));
+
+  params.bgcolor = 0xffffffffu;
+  params.loop_count = 0;
+  if (WebPMuxSetAnimationParams(mux, &params) != WEBP_MUX_OK ||
+      WebPMuxSetCanvasSize(mux, CANVAS_SIZE, CANVAS_SIZE) != WEBP_MUX_OK ||
+      WebPMuxAssemble(mux, &assembled) != WEBP_MUX_OK) {
+    fprintf(stderr, "Error assembling the animation\n");
+    goto End;
+  }
+  Report("WebPMuxAssemble()", num_frames, StopwatchReadAndReset(&stop_watch));
+
+  mux_read = WebPMuxCreate(&assembled, 0);
+  if (mux_read == NULL) {
+    fprintf(stderr, "Error parsing the animation with WebPMuxCreate()\n");
+    goto End;
+  }
+  Report("WebPMuxCreate()", num_frames, StopwatchReadAndReset(&stop_watch));
+
+  for (n = 1; n <= num_frames; ++n) {
+    WebPMuxFrameInfo info;
+    if (WebPMuxGetFrame(mux_read, n, &info) != WEBP_MUX_OK) {
+      fprintf(stderr, "Error getting frame #%d from the mux\n", n);
+      goto End;
+    }
+  }
+  Report("WebPMuxGetFrame()", num_frames, StopwatchReadAndReset(&stop_watch));
+
+  demux = WebPDemux(&assembled);
+  if (demux == NULL) {
+    fprintf(stderr, "Error parsing the animation with WebPDemux()\n");
+    goto End;
+  }
+  Report("WebPDemux()", num_frames, StopwatchReadAndReset(&stop_watch));
+
+  for (n = 1; n <= num_frames; ++n) {
+    if (!WebPDemuxGetFrame(demux, n, &iter)) {
+      fprintf(stderr, "Error getting frame #%d from the demuxer\n", n);
+      goto End;
+    }
+    WebPDemuxReleaseIterator(&iter);
+  }
+  Report("WebPDemuxGetFrame()", num_frames,
+         StopwatchReadAndReset(&stop_watch));
+
+  n = 0;
+  if (WebPDemuxGetFrame(demux, 1, &iter)) {
+    do {
+      ++n;
+    } while (WebPDemuxNextFrame(&iter));
+    WebPDemuxReleaseIterator(&iter);
+  }
+  if (n != num_frames) {
+    fprintf(stderr, "Error: iterated over %d frames instead of %d\n",
+            n, num_frames);
+    goto End;
+  }
+  Report("WebPDemuxNextFrame()", num_frames,
+         StopwatchReadAndReset(&stop_watch));
+  ok = 1;
+
+ End:
+  WebPDemuxDelete(demux);
+  WebPMuxDelete(mux_read);
+  WebPMuxDelete(mux);
+  WebPDataClear(&assembled);
+  return ok ? 0 : 1;
+}
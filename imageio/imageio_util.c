@@ -15,6 +15,10 @@
 #if defined(_WIN32)
 #include <fcntl.h>   // for _O_BINARY
 #include <io.h>      // for _setmode()
+#include <process.h> // for _getpid()
+#define getpid _getpid
+#else
+#include <unistd.h>  // for getpid()
 #endif
 #include <stdlib.h>
 #include <string.h>
@@ -135,6 +139,113 @@ int ImgIoUtilWriteFile(const char* const file_name,
   return ok;
 }
 
+// -----------------------------------------------------------------------------
+// Encoding cache storage, one file per entry.
+
+typedef struct {
+  W_CHAR* path;           // "<dir_name>/<hex key>.webp"
+  W_CHAR* tmp_path;       // 'path' followed by ".<pid>.tmp"
+  size_t path_len;        // length of 'path', without the terminator
+  size_t key_pos;         // position of the hex key in 'path'
+  uint8_t* data;          // last bitstream returned by DirCacheLookup()
+} DirCache;
+
+static const W_CHAR* DirCacheGetPath(DirCache* const cache,
+                                     const uint8_t* key) {
+  static const char kHex[] = "0123456789abcdef";
+  W_CHAR* const dst = cache->path + cache->key_pos;
+  int i;
+  for (i = 0; i < WEBP_ENCODE_CACHE_KEY_SIZE; ++i) {
+    dst[2 * i + 0] = (W_CHAR)kHex[key[i] >> 4];
+    dst[2 * i + 1] = (W_CHAR)kHex[key[i] & 15];
+  }
+  return cache->path;
+}
+
+static const uint8_t* DirCacheLookup(void* opaque, const uint8_t* key,
+                                     size_t* data_size) {
+  DirCache* const cache = (DirCache*)opaque;
+  FILE* const in = WFOPEN(DirCacheGetPath(cache, key), "rb");
+  long size;
+  free(cache->data);
+  cache->data = NULL;
+  if (in == NULL) return NULL;   // not cached yet
+  fseek(in, 0, SEEK_END);
+  size = ftell(in);
+  fseek(in, 0, SEEK_SET);
+  if (size > 0) cache->data = (uint8_t*)malloc((size_t)size);
+  if (cache->data != NULL && fread(cache->data, (size_t)size, 1, in) != 1) {
+    free(cache->data);
+    cache->data = NULL;
+  }
+  fclose(in);
+  *data_size = (size_t)size;
+  return cache->data;
+}
+
+// The entry is written under a temporary name then renamed, so that a
+// concurrent lookup or an interrupted write never exposes a truncated file.
+static int DirCacheStore(void* opaque, const uint8_t* key,
+                         const uint8_t* data, size_t data_size) {
+  DirCache* const cache = (DirCache*)opaque;
+  const W_CHAR* const path = DirCacheGetPath(cache, key);
+  FILE* out;
+  int ok;
+  memcpy(cache->tmp_path, path, cache->path_len * sizeof(*path));
+  out = WFOPEN(cache->tmp_path, "wb");
+  if (out == NULL) return 0;
+  ok = (fwrite(data, data_size, 1, out) == 1);
+  ok = (fclose(out) == 0) && ok;
+  ok = ok && (WRENAME(cache->tmp_path, path) == 0);
+  if (!ok) WREMOVE(cache->tmp_path);
+  return ok;
+}
+
+static void DirCacheRelease(void* opaque) {
+  DirCache* const cache = (DirCache*)opaque;
+  if (cache == NULL) return;
+  free(cache->data);
+  free(cache->tmp_path);
+  free(cache->path);
+  free(cache);
+}
+
+int ImgIoUtilInitCacheDirStorage(const char* const dir_name,
+                                 WebPEncodeCacheStorage* const storage) {
+  static const char kSuffix[] = ".webp";
+  static const size_t kTmpSuffixSize = 32;   // ".<pid>.tmp" and terminator
+  DirCache* cache;
+  size_t dir_len, i;
+  if (dir_name == NULL || storage == NULL) return 0;
+  dir_len = WSTRLEN(dir_name);
+  cache = (DirCache*)calloc(1, sizeof(*cache));
+  if (cache == NULL) return 0;
+  cache->key_pos = dir_len + 1;
+  cache->path_len = cache->key_pos + 2 * WEBP_ENCODE_CACHE_KEY_SIZE +
+                    sizeof(kSuffix) - 1;
+  cache->path = (W_CHAR*)malloc((cache->path_len + 1) * sizeof(*cache->path));
+  cache->tmp_path = (W_CHAR*)malloc((cache->path_len + kTmpSuffixSize) *
+                                    sizeof(*cache->tmp_path));
+  if (cache->path == NULL || cache->tmp_path == NULL) {
+    DirCacheRelease(cache);
+    return 0;
+  }
+  memcpy(cache->path, dir_name, dir_len * sizeof(*cache->path));
+  cache->path[dir_len] = (W_CHAR)'/';
+  for (i = 0; i < sizeof(kSuffix); ++i) {  // also copies the terminator
+    cache->path[cache->key_pos + 2 * WEBP_ENCODE_CACHE_KEY_SIZE + i] =
+        (W_CHAR)kSuffix[i];
+  }
+  // Entries written concurrently by other processes get a distinct name.
+  WSNPRINTF(cache->tmp_path + cache->path_len, kTmpSuffixSize, ".%d.tmp",
+            (int)getpid());
+  storage->lookup = DirCacheLookup;
+  storage->store = DirCacheStore;
+  storage->release = DirCacheRelease;
+  storage->opaque = cache;
+  return 1;
+}
+
 // -----------------------------------------------------------------------------
 
 void ImgIoUtilCopyPlane(const uint8_t* src, int src_stride,
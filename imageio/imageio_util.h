@@ -14,6 +14,7 @@
 #define WEBP_IMAGEIO_IMAGEIO_UTIL_H_
 
 #include <stdio.h>
+#include "webp/encode.h"
 #include "webp/types.h"
 
 #ifdef __cplusplus
@@ -46,6 +47,15 @@ int ImgIoUtilReadFromStdin(const uint8_t** data, size_t* data_size);
 int ImgIoUtilWriteFile(const char* const file_name,
                        const uint8_t* data, size_t data_size);
 
+//------------------------------------------------------------------------------
+// Encoding cache
+
+// Initializes 'storage' as a WebPEncodeCacheStorage keeping each bitstream in
+// its own file inside the (existing) directory 'dir_name'. Entries are never
+// evicted. Returns false in case of memory error.
+int ImgIoUtilInitCacheDirStorage(const char* const dir_name,
+                                 WebPEncodeCacheStorage* const storage);
+
 //------------------------------------------------------------------------------
 
 // Copy width x height pixels from 'src' to 'dst' honoring the strides.
@@ -333,6 +333,8 @@ static VP8StatusCode DecodeWebPHeaders(WebPIDecoder* const idec) {
     if (dec == NULL) {
       return VP8_STATUS_OUT_OF_MEMORY;
     }
+    dec->use_threads_ = (idec->params_.options != NULL) &&
+                        idec->params_.options->use_threads;
     idec->dec_ = dec;
     ChangeState(idec, STATE_VP8L_HEADER, headers.offset);
   }
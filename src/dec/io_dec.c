@@ -254,20 +254,48 @@ static int Rescale(const uint8_t* src, int src_stride,
   return num_lines_out;
 }
 
+// Same as Rescale(), but premultiplies the luma rows one at a time in the
+// 'tmp' row rather than in place.
+static int RescalePremultiplied(const uint8_t* src, int src_stride,
+                                const uint8_t* alpha, int alpha_stride,
+                                int new_lines, uint8_t* const tmp,
+                                WebPRescaler* const wrk) {
+  int num_lines_out = 0;
+  while (new_lines-- > 0) {
+    memcpy(tmp, src, wrk->src_width * sizeof(*tmp));
+    WebPMultRows(tmp, 0, alpha, 0, wrk->src_width, 1, 0);
+    WebPRescalerImport(wrk, 1, tmp, 0);
+    src += src_stride;
+    alpha += alpha_stride;
+    num_lines_out += WebPRescalerExport(wrk);
+  }
+  return num_lines_out;
+}
+
 static int EmitRescaledYUV(const VP8Io* const io, WebPDecParams* const p) {
   const int mb_h = io->mb_h;
   const int uv_mb_h = (mb_h + 1) >> 1;
   WebPRescaler* const scaler = p->scaler_y;
   int num_lines_out = 0;
   if (WebPIsAlphaMode(p->output->colorspace) && io->a != NULL) {
-    // Before rescaling, we premultiply the luma directly into the io->y
-    // internal buffer. This is OK since these samples are not used for
-    // intra-prediction (the top samples are saved in cache_y_/u_/v_).
-    // But we need to cast the const away, though.
-    WebPMultRows((uint8_t*)io->y, io->y_stride,
-                 io->a, io->width, io->mb_w, mb_h, 0);
-  }
-  num_lines_out = Rescale(io->y, io->y_stride, mb_h, scaler);
+    if (p->tmp_y != NULL) {
+      // The io->y samples are shared with other outputs: they are
+      // premultiplied one row at a time in p->tmp_y instead.
+      num_lines_out = RescalePremultiplied(io->y, io->y_stride,
+                                           io->a, io->width, mb_h,
+                                           p->tmp_y, scaler);
+    } else {
+      // Before rescaling, we premultiply the luma directly into the io->y
+      // internal buffer. This is OK since these samples are not used for
+      // intra-prediction (the top samples are saved in cache_y_/u_/v_).
+      // But we need to cast the const away, though.
+      WebPMultRows((uint8_t*)io->y, io->y_stride,
+                   io->a, io->width, io->mb_w, mb_h, 0);
+      num_lines_out = Rescale(io->y, io->y_stride, mb_h, scaler);
+    }
+  } else {
+    num_lines_out = Rescale(io->y, io->y_stride, mb_h, scaler);
+  }
   Rescale(io->u, io->uv_stride, uv_mb_h, p->scaler_u);
   Rescale(io->v, io->uv_stride, uv_mb_h, p->scaler_v);
   return num_lines_out;
@@ -294,7 +322,10 @@ static int EmitRescaledAlphaYUV(const VP8Io* const io, WebPDecParams* const p,
   return 0;
 }
 
-static int InitYUVRescaler(const VP8Io* const io, WebPDecParams* const p) {
+// If 'shared', the luma samples are premultiplied in a scratch row instead of
+// in place (see EmitRescaledYUV()).
+static int InitYUVRescaler(const VP8Io* const io, WebPDecParams* const p,
+                           int shared) {
   const int has_alpha = WebPIsAlphaMode(p->output->colorspace);
   const WebPYUVABuffer* const buf = &p->output->u.YUVA;
   const int out_width  = io->scaled_width;
@@ -305,6 +336,7 @@ static int InitYUVRescaler(const VP8Io* const io, WebPDecParams* const p) {
   const int uv_in_height = (io->mb_h + 1) >> 1;
   const size_t work_size = 2 * out_width;   // scratch memory for luma rescaler
   const size_t uv_work_size = 2 * uv_out_width;  // and for each u/v ones
+  const size_t premult_size = (has_alpha && shared) ? io->mb_w : 0;
   size_t tmp_size, rescaler_size;
   rescaler_t* work;
   WebPRescaler* scalers;
@@ -316,7 +348,7 @@ static int InitYUVRescaler(const VP8Io* const io, WebPDecParams* const p) {
   }
   rescaler_size = num_rescalers * sizeof(*p->scaler_y) + WEBP_ALIGN_CST;
 
-  p->memory = WebPSafeMalloc(1ULL, tmp_size + rescaler_size);
+  p->memory = WebPSafeMalloc(1ULL, tmp_size + rescaler_size + premult_size);
   if (p->memory == NULL) {
     return 0;   // memory error
   }
@@ -327,6 +359,7 @@ static int InitYUVRescaler(const VP8Io* const io, WebPDecParams* const p) {
   p->scaler_u = &scalers[1];
   p->scaler_v = &scalers[2];
   p->scaler_a = has_alpha ? &scalers[3] : NULL;
+  p->tmp_y = (premult_size > 0) ? (uint8_t*)&scalers[num_rescalers] : NULL;
 
   WebPRescalerInit(p->scaler_y, io->mb_w, io->mb_h,
                    buf->y, out_width, out_height, buf->y_stride, 1,
@@ -547,29 +580,26 @@ static int InitRGBRescaler(const VP8Io* const io, WebPDecParams* const p) {
 //------------------------------------------------------------------------------
 // Default custom functions
 
-static int CustomSetup(VP8Io* io) {
-  WebPDecParams* const p = (WebPDecParams*)io->opaque;
+// Sets up the emitters of the output 'p', for the settings of 'io'. If
+// 'shared', the samples of 'io' are also fed to other outputs.
+static int InitOutput(const VP8Io* const io, WebPDecParams* const p,
+                      int shared) {
   const WEBP_CSP_MODE colorspace = p->output->colorspace;
   const int is_rgb = WebPIsRGBMode(colorspace);
   const int is_alpha = WebPIsAlphaMode(colorspace);
 
-  p->memory = NULL;
-  p->emit = NULL;
-  p->emit_alpha = NULL;
-  p->emit_alpha_row = NULL;
-  if (!WebPIoInitFromOptions(p->options, io, is_alpha ? MODE_YUV : MODE_YUVA)) {
-    return 0;
-  }
   if (is_alpha && WebPIsPremultipliedMode(colorspace)) {
     WebPInitUpsamplers();
   }
   if (io->use_scaling) {
 #if !defined(WEBP_REDUCE_SIZE)
-    const int ok = is_rgb ? InitRGBRescaler(io, p) : InitYUVRescaler(io, p);
+    const int ok = is_rgb ? InitRGBRescaler(io, p)
+                          : InitYUVRescaler(io, p, shared);
     if (!ok) {
       return 0;    // memory error
     }
 #else
+    (void)shared;
     return 0;   // rescaling support not compiled
 #endif
   } else {
@@ -604,36 +634,71 @@ static int CustomSetup(VP8Io* io) {
       }
     }
   }
-
   return 1;
 }
 
+static int CustomSetup(VP8Io* io) {
+  WebPDecParams* const p = (WebPDecParams*)io->opaque;
+  const int is_alpha = WebPIsAlphaMode(p->output->colorspace);
+  const WEBP_CSP_MODE src_colorspace = is_alpha ? MODE_YUV : MODE_YUVA;
+  WebPDecParams* q;
+
+  for (q = p; q != NULL; q = q->next) {
+    q->memory = NULL;
+    q->emit = NULL;
+    q->emit_alpha = NULL;
+    q->emit_alpha_row = NULL;
+  }
+  if (!WebPIoInitFromOptions(p->options, io, src_colorspace)) {
+    return 0;
+  }
+  for (q = p->next; q != NULL; q = q->next) {
+    VP8Io sub_io;
+    if (!WebPIoInitChainedOutput(q, io, &sub_io, src_colorspace) ||
+        !InitOutput(&sub_io, q, 1)) {
+      return 0;
+    }
+  }
+  return InitOutput(io, p, (p->next != NULL));
+}
+
 //------------------------------------------------------------------------------
 
+static void EmitOutput(const VP8Io* const io, WebPDecParams* const p) {
+  const int num_lines_out = p->emit(io, p);
+  if (p->emit_alpha != NULL) {
+    p->emit_alpha(io, p, num_lines_out);
+  }
+  p->last_y += num_lines_out;
+}
+
 static int CustomPut(const VP8Io* io) {
   WebPDecParams* const p = (WebPDecParams*)io->opaque;
+  WebPDecParams* q;
   const int mb_w = io->mb_w;
   const int mb_h = io->mb_h;
-  int num_lines_out;
   assert(!(io->mb_y & 1));
 
   if (mb_w <= 0 || mb_h <= 0) {
     return 0;
   }
-  num_lines_out = p->emit(io, p);
-  if (p->emit_alpha != NULL) {
-    p->emit_alpha(io, p, num_lines_out);
+  for (q = p->next; q != NULL; q = q->next) {
+    VP8Io sub_io;
+    WebPIoGetChainedOutput(q, io, &sub_io);
+    EmitOutput(&sub_io, q);
   }
-  p->last_y += num_lines_out;
+  EmitOutput(io, p);
   return 1;
 }
 
 //------------------------------------------------------------------------------
 
 static void CustomTeardown(const VP8Io* io) {
-  WebPDecParams* const p = (WebPDecParams*)io->opaque;
-  WebPSafeFree(p->memory);
-  p->memory = NULL;
+  WebPDecParams* p;
+  for (p = (WebPDecParams*)io->opaque; p != NULL; p = p->next) {
+    WebPSafeFree(p->memory);
+    p->memory = NULL;
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -17,6 +17,7 @@
 #include "src/dec/vp8i_dec.h"
 #include "src/dec/vp8li_dec.h"
 #include "src/dec/webpi_dec.h"
+#include "src/dsp/lossless.h"
 #include "src/utils/bit_reader_inl_utils.h"
 #include "src/utils/utils.h"
 
@@ -36,6 +37,34 @@ static volatile GetCoeffsFunc GetCoeffs = NULL;
 
 static void InitGetCoeffs(void);
 
+//------------------------------------------------------------------------------
+// One-time initialization
+
+static WEBP_TSAN_IGNORE_FUNCTION void InitDecoderOnce(void) {
+  InitGetCoeffs();
+  VP8DspInit();
+  VP8LDspInit();
+  VP8FiltersInit();
+  WebPInitAlphaProcessing();
+  WebPInitSamplers();
+  WebPInitUpsamplers();
+  WebPInitYUV444Converters();
+  WebPInitConvertARGBToYUV();
+  WebPRescalerDspInit();
+}
+
+#if defined(WEBP_USE_THREAD) && !defined(_WIN32)
+static pthread_once_t decoder_init_once = PTHREAD_ONCE_INIT;
+#endif
+
+void WebPInitDecoder(void) {
+#if defined(WEBP_USE_THREAD) && !defined(_WIN32)
+  (void)pthread_once(&decoder_init_once, InitDecoderOnce);
+#else
+  InitDecoderOnce();   // each of the calls is guarded already
+#endif
+}
+
 //------------------------------------------------------------------------------
 // VP8Decoder
 
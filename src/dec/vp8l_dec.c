@@ -22,10 +22,17 @@
 #include "src/dsp/yuv.h"
 #include "src/utils/endian_inl_utils.h"
 #include "src/utils/huffman_utils.h"
+#include "src/utils/thread_utils.h"
+#include "src/utils/trace_utils.h"
 #include "src/utils/utils.h"
 
 #define NUM_ARGB_CACHE_ROWS          16
 
+// Largest backward-reference length, and largest distance before mapping to
+// the 2D plane, that can be signalled (see GetCopyDistance()).
+#define MAX_COPY_LENGTH              4096
+#define MAX_PLANE_CODE               (1 << 20)
+
 static const int kCodeLengthLiterals = 16;
 static const int kCodeLengthRepeatCode = 16;
 static const uint8_t kCodeLengthExtraBits[3] = { 2, 3, 7 };
@@ -85,7 +92,9 @@ static const uint8_t kCodeToPlane[CODE_TO_PLANE_CODES] = {
 // + color_cache_size (between 0 and 2048).
 // All values computed for 8-bit first level lookup with Mark Adler's tool:
 // http://www.hdfgroup.org/ftp/lib-external/zlib/zlib-1.2.5/examples/enough.c
-#define FIXED_TABLE_SIZE (630 * 3 + 410)
+#define MAX_RBA_TABLE_SIZE   630   // red, blue or alpha
+#define MAX_DIST_TABLE_SIZE  410
+#define FIXED_TABLE_SIZE (MAX_RBA_TABLE_SIZE * 3 + MAX_DIST_TABLE_SIZE)
 static const uint16_t kTableSize[12] = {
   FIXED_TABLE_SIZE + 654,
   FIXED_TABLE_SIZE + 656,
@@ -306,10 +315,10 @@ static int ReadHuffmanCodeLengths(
 
 // 'code_lengths' is pre-allocated temporary buffer, used for creating Huffman
 // tree.
-static int ReadHuffmanCode(int alphabet_size, VP8LDecoder* const dec,
-                           int* const code_lengths, HuffmanCode* const table) {
+// Reads the 'alphabet_size' code lengths of a Huffman code.
+static int ReadCodeLengths(int alphabet_size, VP8LDecoder* const dec,
+                           int* const code_lengths) {
   int ok = 0;
-  int size = 0;
   VP8LBitReader* const br = &dec->br_;
   const int simple_code = VP8LReadBits(br, 1);
 
@@ -344,17 +353,198 @@ static int ReadHuffmanCode(int alphabet_size, VP8LDecoder* const dec,
   }
 
   ok = ok && !br->eos_;
-  if (ok) {
-    size = VP8LBuildHuffmanTable(table, HUFFMAN_TABLE_BITS,
-                                 code_lengths, alphabet_size);
+  if (!ok) {
+    dec->status_ = VP8_STATUS_BITSTREAM_ERROR;
+    return 0;
   }
-  if (!ok || size == 0) {
+  return 1;
+}
+
+// Reads a Huffman code and builds its lookup table (or only checks that the
+// code is valid, if 'table' is NULL). Returns the table size, 0 on error.
+static int ReadHuffmanCode(int alphabet_size, VP8LDecoder* const dec,
+                           int* const code_lengths, HuffmanCode* const table) {
+  int size = 0;
+  if (!ReadCodeLengths(alphabet_size, dec, code_lengths)) return 0;
+  size = VP8LBuildHuffmanTable(table, HUFFMAN_TABLE_BITS,
+                               code_lengths, alphabet_size);
+  if (size == 0) {
     dec->status_ = VP8_STATUS_BITSTREAM_ERROR;
     return 0;
   }
   return size;
 }
 
+//------------------------------------------------------------------------------
+// Deferred construction of the Huffman lookup tables.
+// The codes are read sequentially, as the format requires, but their tables
+// are built once all the codes are known, possibly in parallel. Each code has
+// a slot of the worst-case table size for its type. Until its table is built,
+// the slot holds the code lengths, as bytes. Codes with identical lengths share
+// a single table.
+
+#define HUFFMAN_NUM_THREADS 4          // max number of threads building tables
+#define HUFFMAN_MIN_CODES_PER_JOB 48   // less work than that isn't worth a job
+
+typedef struct {
+  HuffmanCode* table;   // table slot (holding the code lengths until built)
+  int alphabet_size;
+  uint32_t hash;        // hash of the code lengths
+} PendingCode;
+
+typedef struct {
+  PendingCode* codes;   // unique codes, in reading order
+  int num_codes;
+  int* hash_table;      // index + 1 in codes[], or 0 if unused
+  int hash_mask;
+} PendingCodes;
+
+typedef struct {
+  WebPWorker worker;
+  const PendingCode* codes;   // codes to build
+  int num_codes;
+  int* code_lengths;          // scratch area of the maximum alphabet size
+} BuildTablesJob;
+
+static int PendingCodesInit(PendingCodes* const pending, int max_codes) {
+  int hash_size = 1;
+  while (hash_size < 2 * max_codes) hash_size <<= 1;
+  pending->num_codes = 0;
+  pending->hash_mask = hash_size - 1;
+  pending->codes =
+      (PendingCode*)WebPSafeMalloc(max_codes, sizeof(*pending->codes));
+  pending->hash_table =
+      (int*)WebPSafeCalloc(hash_size, sizeof(*pending->hash_table));
+  return (pending->codes != NULL && pending->hash_table != NULL);
+}
+
+static void PendingCodesClear(PendingCodes* const pending) {
+  WebPSafeFree(pending->codes);
+  WebPSafeFree(pending->hash_table);
+}
+
+static uint32_t HashCodeLengths(const int* const code_lengths,
+                                int alphabet_size) {
+  uint32_t hash = (uint32_t)alphabet_size;
+  int i;
+  for (i = 0; i < alphabet_size; ++i) {
+    hash = (hash * 0x9e3779b1u) ^ (uint32_t)code_lengths[i];
+  }
+  return hash ^ (hash >> 15);
+}
+
+static int SameCodeLengths(const uint8_t* const lengths,
+                           const int* const code_lengths, int alphabet_size) {
+  int i;
+  for (i = 0; i < alphabet_size; ++i) {
+    if (lengths[i] != code_lengths[i]) return 0;
+  }
+  return 1;
+}
+
+// Returns the table to use for 'code_lengths': either the one of an identical
+// code read before, or 'slot', which is then recorded for building.
+static HuffmanCode* AddPendingCode(PendingCodes* const pending,
+                                   const int* const code_lengths,
+                                   int alphabet_size, HuffmanCode* const slot) {
+  const uint32_t hash = HashCodeLengths(code_lengths, alphabet_size);
+  uint32_t pos = hash & pending->hash_mask;
+  uint8_t* lengths;
+  int i;
+  while (pending->hash_table[pos] != 0) {
+    const PendingCode* const code =
+        &pending->codes[pending->hash_table[pos] - 1];
+    if (code->hash == hash && code->alphabet_size == alphabet_size &&
+        SameCodeLengths((const uint8_t*)code->table, code_lengths,
+                        alphabet_size)) {
+      return code->table;
+    }
+    pos = (pos + 1) & pending->hash_mask;
+  }
+  // The slot is larger than 'alphabet_size' bytes for all code types.
+  lengths = (uint8_t*)slot;
+  for (i = 0; i < alphabet_size; ++i) lengths[i] = (uint8_t)code_lengths[i];
+  pending->codes[pending->num_codes].table = slot;
+  pending->codes[pending->num_codes].alphabet_size = alphabet_size;
+  pending->codes[pending->num_codes].hash = hash;
+  pending->hash_table[pos] = ++pending->num_codes;
+  return slot;
+}
+
+static int BuildTablesHook(void* arg1, void* arg2) {
+  BuildTablesJob* const job = (BuildTablesJob*)arg1;
+  int n, i;
+  (void)arg2;
+  for (n = 0; n < job->num_codes; ++n) {
+    const PendingCode* const code = &job->codes[n];
+    const uint8_t* const lengths = (const uint8_t*)code->table;
+    // The code lengths are overwritten by the table: make a copy first.
+    for (i = 0; i < code->alphabet_size; ++i) {
+      job->code_lengths[i] = lengths[i];
+    }
+    if (VP8LBuildHuffmanTable(code->table, HUFFMAN_TABLE_BITS,
+                              job->code_lengths, code->alphabet_size) == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int BuildPendingCodes(VP8LDecoder* const dec,
+                             const PendingCodes* const pending,
+                             int* const code_lengths, int max_alphabet_size) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  BuildTablesJob jobs[HUFFMAN_NUM_THREADS];
+  int num_jobs = 1;
+  int first = 0;
+  int ok = 1, out_of_memory = 0;
+  int i;
+#ifdef WEBP_USE_THREAD
+  if (dec->use_threads_) {
+    num_jobs = pending->num_codes / HUFFMAN_MIN_CODES_PER_JOB;
+    if (num_jobs > HUFFMAN_NUM_THREADS) num_jobs = HUFFMAN_NUM_THREADS;
+    if (num_jobs < 1) num_jobs = 1;
+  }
+#endif
+  for (i = 0; i < num_jobs; ++i) {
+    BuildTablesJob* const job = &jobs[i];
+    const int last = (int)((int64_t)pending->num_codes * (i + 1) / num_jobs);
+    worker_interface->Init(&job->worker);
+    job->worker.hook = BuildTablesHook;
+    job->worker.data1 = job;
+    job->codes = pending->codes + first;
+    job->num_codes = last - first;
+    job->code_lengths = (i == 0) ? code_lengths
+                      : (int*)WebPSafeMalloc(max_alphabet_size,
+                                             sizeof(*job->code_lengths));
+    if (job->code_lengths == NULL) {
+      out_of_memory = 1;
+    } else if (i > 0) {
+      if (worker_interface->Reset(&job->worker)) {
+        worker_interface->Launch(&job->worker);
+      } else {   // no thread available: build here
+        worker_interface->Execute(&job->worker);
+      }
+    }
+    first = last;
+  }
+  worker_interface->Execute(&jobs[0].worker);   // main thread's share
+  for (i = 0; i < num_jobs; ++i) {
+    ok &= worker_interface->Sync(&jobs[i].worker);
+    worker_interface->End(&jobs[i].worker);
+    if (i > 0) WebPSafeFree(jobs[i].code_lengths);
+  }
+  if (out_of_memory) {
+    dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
+    return 0;
+  }
+  if (!ok) {
+    dec->status_ = VP8_STATUS_BITSTREAM_ERROR;
+    return 0;
+  }
+  return 1;
+}
+
 static int ReadHuffmanCodes(VP8LDecoder* const dec, int xsize, int ysize,
                             int color_cache_bits, int allow_recursion) {
   int i, j;
@@ -363,13 +553,14 @@ static int ReadHuffmanCodes(VP8LDecoder* const dec, int xsize, int ysize,
   uint32_t* huffman_image = NULL;
   HTreeGroup* htree_groups = NULL;
   HuffmanCode* huffman_tables = NULL;
-  HuffmanCode* huffman_table = NULL;
   int num_htree_groups = 1;
   int num_htree_groups_max = 1;
   int max_alphabet_size = 0;
   int* code_lengths = NULL;
   const int table_size = kTableSize[color_cache_bits];
   int* mapping = NULL;
+  int* max_bits = NULL;   // per group, sum of the max red/green/blue/alpha bits
+  PendingCodes pending = { NULL, 0, NULL, 0 };
   int ok = 0;
 
   if (allow_recursion && VP8LReadBits(br, 1)) {
@@ -437,13 +628,16 @@ static int ReadHuffmanCodes(VP8LDecoder* const dec, int xsize, int ysize,
   huffman_tables = (HuffmanCode*)WebPSafeMalloc(num_htree_groups * table_size,
                                                 sizeof(*huffman_tables));
   htree_groups = VP8LHtreeGroupsNew(num_htree_groups);
+  max_bits = (int*)WebPSafeCalloc(num_htree_groups, sizeof(*max_bits));
 
-  if (htree_groups == NULL || code_lengths == NULL || huffman_tables == NULL) {
+  if (htree_groups == NULL || code_lengths == NULL || huffman_tables == NULL ||
+      max_bits == NULL ||
+      !PendingCodesInit(&pending,
+                        num_htree_groups * HUFFMAN_CODES_PER_META_CODE)) {
     dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
     goto Error;
   }
 
-  huffman_table = huffman_tables;
   for (i = 0; i < num_htree_groups_max; ++i) {
     // If the index "i" is unused in the Huffman image, just make sure the
     // coefficients are valid but do not store them.
@@ -459,28 +653,21 @@ static int ReadHuffmanCodes(VP8LDecoder* const dec, int xsize, int ysize,
         }
       }
     } else {
-      HTreeGroup* const htree_group =
-          &htree_groups[(mapping == NULL) ? i : mapping[i]];
-      HuffmanCode** const htrees = htree_group->htrees;
-      int size;
-      int total_size = 0;
-      int is_trivial_literal = 1;
-      int max_bits = 0;
+      const int group = (mapping == NULL) ? i : mapping[i];
+      HuffmanCode** const htrees = htree_groups[group].htrees;
+      // slots of the tables of this group: green first, then the fixed sizes.
+      HuffmanCode* slot = huffman_tables + group * table_size;
       for (j = 0; j < HUFFMAN_CODES_PER_META_CODE; ++j) {
         int alphabet_size = kAlphabetSize[j];
-        htrees[j] = huffman_table;
         if (j == 0 && color_cache_bits > 0) {
           alphabet_size += (1 << color_cache_bits);
         }
-        size = ReadHuffmanCode(alphabet_size, dec, code_lengths, huffman_table);
-        if (size == 0) {
+        if (!ReadCodeLengths(alphabet_size, dec, code_lengths)) {
           goto Error;
         }
-        if (is_trivial_literal && kLiteralMap[j] == 1) {
-          is_trivial_literal = (huffman_table->bits == 0);
-        }
-        total_size += huffman_table->bits;
-        huffman_table += size;
+        htrees[j] = AddPendingCode(&pending, code_lengths, alphabet_size, slot);
+        slot += (j == GREEN) ? table_size - FIXED_TABLE_SIZE
+              : (j == DIST) ? MAX_DIST_TABLE_SIZE : MAX_RBA_TABLE_SIZE;
         if (j <= ALPHA) {
           int local_max_bits = code_lengths[0];
           int k;
@@ -489,25 +676,42 @@ static int ReadHuffmanCodes(VP8LDecoder* const dec, int xsize, int ysize,
               local_max_bits = code_lengths[k];
             }
           }
-          max_bits += local_max_bits;
+          max_bits[group] += local_max_bits;
         }
       }
-      htree_group->is_trivial_literal = is_trivial_literal;
-      htree_group->is_trivial_code = 0;
-      if (is_trivial_literal) {
-        const int red = htrees[RED][0].value;
-        const int blue = htrees[BLUE][0].value;
-        const int alpha = htrees[ALPHA][0].value;
-        htree_group->literal_arb = ((uint32_t)alpha << 24) | (red << 16) | blue;
-        if (total_size == 0 && htrees[GREEN][0].value < NUM_LITERAL_CODES) {
-          htree_group->is_trivial_code = 1;
-          htree_group->literal_arb |= htrees[GREEN][0].value << 8;
-        }
+    }
+  }
+
+  if (!BuildPendingCodes(dec, &pending, code_lengths, max_alphabet_size)) {
+    goto Error;
+  }
+
+  for (i = 0; i < num_htree_groups; ++i) {
+    HTreeGroup* const htree_group = &htree_groups[i];
+    HuffmanCode** const htrees = htree_group->htrees;
+    int total_size = 0;
+    int is_trivial_literal = 1;
+    for (j = 0; j < HUFFMAN_CODES_PER_META_CODE; ++j) {
+      if (is_trivial_literal && kLiteralMap[j] == 1) {
+        is_trivial_literal = (htrees[j]->bits == 0);
+      }
+      total_size += htrees[j]->bits;
+    }
+    htree_group->is_trivial_literal = is_trivial_literal;
+    htree_group->is_trivial_code = 0;
+    if (is_trivial_literal) {
+      const int red = htrees[RED][0].value;
+      const int blue = htrees[BLUE][0].value;
+      const int alpha = htrees[ALPHA][0].value;
+      htree_group->literal_arb = ((uint32_t)alpha << 24) | (red << 16) | blue;
+      if (total_size == 0 && htrees[GREEN][0].value < NUM_LITERAL_CODES) {
+        htree_group->is_trivial_code = 1;
+        htree_group->literal_arb |= htrees[GREEN][0].value << 8;
       }
-      htree_group->use_packed_table =
-          !htree_group->is_trivial_code && (max_bits < HUFFMAN_PACKED_BITS);
-      if (htree_group->use_packed_table) BuildPackedTable(htree_group);
     }
+    htree_group->use_packed_table =
+        !htree_group->is_trivial_code && (max_bits[i] < HUFFMAN_PACKED_BITS);
+    if (htree_group->use_packed_table) BuildPackedTable(htree_group);
   }
   ok = 1;
 
@@ -520,6 +724,8 @@ static int ReadHuffmanCodes(VP8LDecoder* const dec, int xsize, int ysize,
  Error:
   WebPSafeFree(code_lengths);
   WebPSafeFree(mapping);
+  WebPSafeFree(max_bits);
+  PendingCodesClear(&pending);
   if (!ok) {
     WebPSafeFree(huffman_image);
     WebPSafeFree(huffman_tables);
@@ -532,7 +738,10 @@ static int ReadHuffmanCodes(VP8LDecoder* const dec, int xsize, int ysize,
 // Scaling.
 
 #if !defined(WEBP_REDUCE_SIZE)
-static int AllocateAndInitRescaler(VP8LDecoder* const dec, VP8Io* const io) {
+// Returns a rescaler from the crop window of 'io' to its scaled dimensions,
+// or NULL in case of memory error. '*memory' is the allocation to release.
+static WebPRescaler* AllocateAndInitRescaler(const VP8Io* const io,
+                                             uint8_t** const memory) {
   const int num_channels = 4;
   const int in_width = io->mb_w;
   const int out_width = io->scaled_width;
@@ -542,26 +751,23 @@ static int AllocateAndInitRescaler(VP8LDecoder* const dec, VP8Io* const io) {
   rescaler_t* work;        // Rescaler work area.
   const uint64_t scaled_data_size = (uint64_t)out_width;
   uint32_t* scaled_data;  // Temporary storage for scaled BGRA data.
-  const uint64_t memory_size = sizeof(*dec->rescaler) +
+  WebPRescaler* rescaler;
+  const uint64_t memory_size = sizeof(*rescaler) +
                                work_size * sizeof(*work) +
                                scaled_data_size * sizeof(*scaled_data);
-  uint8_t* memory = (uint8_t*)WebPSafeMalloc(memory_size, sizeof(*memory));
-  if (memory == NULL) {
-    dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
-    return 0;
-  }
-  assert(dec->rescaler_memory == NULL);
-  dec->rescaler_memory = memory;
+  uint8_t* mem = (uint8_t*)WebPSafeMalloc(memory_size, sizeof(*mem));
+  if (mem == NULL) return NULL;
+  *memory = mem;
 
-  dec->rescaler = (WebPRescaler*)memory;
-  memory += sizeof(*dec->rescaler);
-  work = (rescaler_t*)memory;
-  memory += work_size * sizeof(*work);
-  scaled_data = (uint32_t*)memory;
+  rescaler = (WebPRescaler*)mem;
+  mem += sizeof(*rescaler);
+  work = (rescaler_t*)mem;
+  mem += work_size * sizeof(*work);
+  scaled_data = (uint32_t*)mem;
 
-  WebPRescalerInit(dec->rescaler, in_width, in_height, (uint8_t*)scaled_data,
+  WebPRescalerInit(rescaler, in_width, in_height, (uint8_t*)scaled_data,
                    out_width, out_height, 0, num_channels, work);
-  return 1;
+  return rescaler;
 }
 #endif   // WEBP_REDUCE_SIZE
 
@@ -587,26 +793,26 @@ static int Export(WebPRescaler* const rescaler, WEBP_CSP_MODE colorspace,
 }
 
 // Emit scaled rows.
-static int EmitRescaledRowsRGBA(const VP8LDecoder* const dec,
+static int EmitRescaledRowsRGBA(WebPRescaler* const rescaler,
+                                WEBP_CSP_MODE colorspace,
                                 uint8_t* in, int in_stride, int mb_h,
                                 uint8_t* const out, int out_stride) {
-  const WEBP_CSP_MODE colorspace = dec->output_->colorspace;
   int num_lines_in = 0;
   int num_lines_out = 0;
   while (num_lines_in < mb_h) {
     uint8_t* const row_in = in + num_lines_in * in_stride;
     uint8_t* const row_out = out + num_lines_out * out_stride;
     const int lines_left = mb_h - num_lines_in;
-    const int needed_lines = WebPRescaleNeededLines(dec->rescaler, lines_left);
+    const int needed_lines = WebPRescaleNeededLines(rescaler, lines_left);
     int lines_imported;
     assert(needed_lines > 0 && needed_lines <= lines_left);
     WebPMultARGBRows(row_in, in_stride,
-                     dec->rescaler->src_width, needed_lines, 0);
+                     rescaler->src_width, needed_lines, 0);
     lines_imported =
-        WebPRescalerImport(dec->rescaler, lines_left, row_in, in_stride);
+        WebPRescalerImport(rescaler, lines_left, row_in, in_stride);
     assert(lines_imported == needed_lines);
     num_lines_in += lines_imported;
-    num_lines_out += Export(dec->rescaler, colorspace, out_stride, row_out);
+    num_lines_out += Export(rescaler, colorspace, out_stride, row_out);
   }
   return num_lines_out;
 }
@@ -657,46 +863,45 @@ static void ConvertToYUVA(const uint32_t* const src, int width, int y_pos,
   }
 }
 
-static int ExportYUVA(const VP8LDecoder* const dec, int y_pos) {
-  WebPRescaler* const rescaler = dec->rescaler;
+static int ExportYUVA(WebPRescaler* const rescaler,
+                      const WebPDecBuffer* const output, int y_pos) {
   uint32_t* const src = (uint32_t*)rescaler->dst;
   const int dst_width = rescaler->dst_width;
   int num_lines_out = 0;
   while (WebPRescalerHasPendingOutput(rescaler)) {
     WebPRescalerExportRow(rescaler);
     WebPMultARGBRow(src, dst_width, 1);
-    ConvertToYUVA(src, dst_width, y_pos, dec->output_);
+    ConvertToYUVA(src, dst_width, y_pos, output);
     ++y_pos;
     ++num_lines_out;
   }
   return num_lines_out;
 }
 
-static int EmitRescaledRowsYUVA(const VP8LDecoder* const dec,
+static int EmitRescaledRowsYUVA(WebPRescaler* const rescaler,
+                                const WebPDecBuffer* const output, int y_pos,
                                 uint8_t* in, int in_stride, int mb_h) {
   int num_lines_in = 0;
-  int y_pos = dec->last_out_row_;
   while (num_lines_in < mb_h) {
     const int lines_left = mb_h - num_lines_in;
-    const int needed_lines = WebPRescaleNeededLines(dec->rescaler, lines_left);
+    const int needed_lines = WebPRescaleNeededLines(rescaler, lines_left);
     int lines_imported;
-    WebPMultARGBRows(in, in_stride, dec->rescaler->src_width, needed_lines, 0);
+    WebPMultARGBRows(in, in_stride, rescaler->src_width, needed_lines, 0);
     lines_imported =
-        WebPRescalerImport(dec->rescaler, lines_left, in, in_stride);
+        WebPRescalerImport(rescaler, lines_left, in, in_stride);
     assert(lines_imported == needed_lines);
     num_lines_in += lines_imported;
     in += needed_lines * in_stride;
-    y_pos += ExportYUVA(dec, y_pos);
+    y_pos += ExportYUVA(rescaler, output, y_pos);
   }
   return y_pos;
 }
 
-static int EmitRowsYUVA(const VP8LDecoder* const dec,
+static int EmitRowsYUVA(const WebPDecBuffer* const output, int y_pos,
                         const uint8_t* in, int in_stride,
                         int mb_w, int num_rows) {
-  int y_pos = dec->last_out_row_;
   while (num_rows-- > 0) {
-    ConvertToYUVA((const uint32_t*)in, mb_w, y_pos, dec->output_);
+    ConvertToYUVA((const uint32_t*)in, mb_w, y_pos, output);
     in += in_stride;
     ++y_pos;
   }
@@ -775,10 +980,42 @@ static void ApplyInverseTransforms(VP8LDecoder* const dec,
   }
 }
 
+// Scales & color-converts the rows of the crop window of 'io' into 'output',
+// starting at 'last_out_row'. Returns the updated last output row.
+static int EmitOutputRows(const VP8Io* const io,
+                          const WebPDecBuffer* const output,
+                          WebPRescaler* const rescaler, int last_out_row,
+                          uint8_t* const rows_data, int in_stride) {
+  if (WebPIsRGBMode(output->colorspace)) {  // convert to RGBA
+    const WebPRGBABuffer* const buf = &output->u.RGBA;
+    uint8_t* const rgba = buf->rgba + last_out_row * buf->stride;
+    const int num_rows_out =
+#if !defined(WEBP_REDUCE_SIZE)
+     io->use_scaling ?
+        EmitRescaledRowsRGBA(rescaler, output->colorspace,
+                             rows_data, in_stride, io->mb_h,
+                             rgba, buf->stride) :
+#endif  // WEBP_REDUCE_SIZE
+        EmitRows(output->colorspace, rows_data, in_stride,
+                 io->mb_w, io->mb_h, rgba, buf->stride);
+    // Update 'last_out_row'.
+    last_out_row += num_rows_out;
+  } else {                              // convert to YUVA
+    last_out_row = io->use_scaling ?
+        EmitRescaledRowsYUVA(rescaler, output, last_out_row,
+                             rows_data, in_stride, io->mb_h) :
+        EmitRowsYUVA(output, last_out_row,
+                     rows_data, in_stride, io->mb_w, io->mb_h);
+  }
+  assert(last_out_row <= output->height);
+  return last_out_row;
+}
+
 // Processes (transforms, scales & color-converts) the rows decoded after the
 // last call.
 static void ProcessRows(VP8LDecoder* const dec, int row) {
-  const uint32_t* const rows = dec->pixels_ + dec->width_ * dec->last_row_;
+  const uint32_t* const rows =
+      dec->pixels_ + dec->width_ * (dec->last_row_ - dec->window_row_);
   const int num_rows = row - dec->last_row_;
 
   assert(row <= dec->io_->crop_bottom);
@@ -793,26 +1030,25 @@ static void ProcessRows(VP8LDecoder* const dec, int row) {
     if (!SetCropWindow(io, dec->last_row_, row, &rows_data, in_stride)) {
       // Nothing to output (this time).
     } else {
-      const WebPDecBuffer* const output = dec->output_;
-      if (WebPIsRGBMode(output->colorspace)) {  // convert to RGBA
-        const WebPRGBABuffer* const buf = &output->u.RGBA;
-        uint8_t* const rgba = buf->rgba + dec->last_out_row_ * buf->stride;
-        const int num_rows_out =
-#if !defined(WEBP_REDUCE_SIZE)
-         io->use_scaling ?
-            EmitRescaledRowsRGBA(dec, rows_data, in_stride, io->mb_h,
-                                 rgba, buf->stride) :
-#endif  // WEBP_REDUCE_SIZE
-            EmitRows(output->colorspace, rows_data, in_stride,
-                     io->mb_w, io->mb_h, rgba, buf->stride);
-        // Update 'last_out_row_'.
-        dec->last_out_row_ += num_rows_out;
-      } else {                              // convert to YUVA
-        dec->last_out_row_ = io->use_scaling ?
-            EmitRescaledRowsYUVA(dec, rows_data, in_stride, io->mb_h) :
-            EmitRowsYUVA(dec, rows_data, in_stride, io->mb_w, io->mb_h);
+      WebPDecParams* p;
+      for (p = dec->next_output_; p != NULL; p = p->next) {
+        VP8Io sub_io;
+        uint8_t* sub_rows_data = rows_data;
+        int sub_in_stride = in_stride;
+        WebPIoGetChainedOutput(p, io, &sub_io);
+        if (sub_io.use_scaling) {
+          // The rows are premultiplied in place before rescaling.
+          sub_rows_data = (uint8_t*)dec->rows_copy_;
+          sub_in_stride = io->mb_w * sizeof(uint32_t);
+          WebPCopyPlane(rows_data, in_stride, sub_rows_data, sub_in_stride,
+                        sub_in_stride, io->mb_h);
+        }
+        p->last_y = EmitOutputRows(&sub_io, p->output, p->scaler_y, p->last_y,
+                                   sub_rows_data, sub_in_stride);
       }
-      assert(dec->last_out_row_ <= output->height);
+      dec->last_out_row_ = EmitOutputRows(io, dec->output_, dec->rescaler,
+                                          dec->last_out_row_,
+                                          rows_data, in_stride);
     }
   }
 
@@ -1106,6 +1342,75 @@ static void RestoreState(VP8LDecoder* const dec) {
   }
 }
 
+//------------------------------------------------------------------------------
+// Sliding pixel window
+//
+// Backward references can't reach further than a fixed number of pixels, and
+// decoded rows are handed over to ProcessRows() every NUM_ARGB_CACHE_ROWS.
+// So, when not decoding incrementally, the main image doesn't need to be kept
+// in full: a window of rows is enough, which is slid up as decoding goes.
+
+// Returns the largest distance a backward reference can span.
+static int GetMaxCopyDistance(int width) {
+  const int max_plane_dist = 7 * width + 8;   // see PlaneCodeToDistance()
+  const int max_dist = MAX_PLANE_CODE - CODE_TO_PLANE_CODES;
+  return (max_plane_dist > max_dist) ? max_plane_dist : max_dist;
+}
+
+// Number of rows to keep free at the bottom of the window, so that a full row
+// followed by the longest copy always fits.
+static int GetWindowMarginRows(int width) {
+  return (MAX_COPY_LENGTH + width - 1) / width + 1;
+}
+
+// Returns the number of rows of the window to use for decoding the main image,
+// or 0 if the whole image should be kept.
+static int GetWindowRows(const VP8LDecoder* const dec) {
+  const int width = dec->width_;
+  const int dist_rows = (GetMaxCopyDistance(width) + width - 1) / width + 1;
+  const int keep_rows = (dist_rows > NUM_ARGB_CACHE_ROWS + 1) ?
+                        dist_rows : NUM_ARGB_CACHE_ROWS + 1;
+  // Leave as much room as what is kept, so that sliding is amortized.
+  const int window_rows = 2 * keep_rows + GetWindowMarginRows(width);
+  if (dec->incremental_) return 0;   // we may need to rewind to any row
+  return (2 * window_rows <= dec->height_) ? window_rows : 0;
+}
+
+// Returns the row at which the window must be slid up.
+static int GetWindowSlideRow(const VP8LDecoder* const dec) {
+  return dec->window_row_ + dec->window_rows_ -
+         GetWindowMarginRows(dec->width_);
+}
+
+// Moves the rows still reachable by backward references or not yet processed
+// to the top of the window. 'pos' is the position of the next pixel to decode,
+// relative to the window. Returns the number of pixels the content moved by.
+static int SlideWindow(VP8LDecoder* const dec, int pos) {
+  const int width = dec->width_;
+  const int abs_pos = dec->window_row_ * width + pos;
+  const int max_dist = GetMaxCopyDistance(width);
+  int keep_row = (abs_pos > max_dist) ? (abs_pos - max_dist) / width : 0;
+  int shift;
+  if (keep_row > dec->last_row_) keep_row = dec->last_row_;
+  if (keep_row < dec->window_row_) keep_row = dec->window_row_;
+  shift = (keep_row - dec->window_row_) * width;
+  if (shift > 0) {
+    memmove(dec->pixels_, dec->pixels_ + shift,
+            (pos - shift) * sizeof(*dec->pixels_));
+    dec->window_row_ = keep_row;
+  }
+  return shift;
+}
+
+// Returns the number of pixels of 'data' available for decoding, up to
+// 'last_row' of an image of size 'width' x 'height'.
+static int GetWindowEnd(const VP8LDecoder* const dec, int width, int last_row) {
+  const int window_pos = dec->window_row_ * width;
+  const int end = width * last_row - window_pos;
+  const int window_end = dec->window_rows_ * width;
+  return (dec->window_rows_ > 0 && end > window_end) ? window_end : end;
+}
+
 #define SYNC_EVERY_N_ROWS 8  // minimum number of rows between check-points
 static int DecodeImageData(VP8LDecoder* const dec, uint32_t* const data,
                            int width, int height, int last_row,
@@ -1116,11 +1421,14 @@ static int DecodeImageData(VP8LDecoder* const dec, uint32_t* const data,
   VP8LMetadata* const hdr = &dec->hdr_;
   uint32_t* src = data + dec->last_pixel_;
   uint32_t* last_cached = src;
-  uint32_t* const src_end = data + width * height;     // End of data
-  uint32_t* const src_last = data + width * last_row;  // Last pixel to decode
+  uint32_t* src_end = data + GetWindowEnd(dec, width, height);  // End of data
+  uint32_t* src_last =
+      data + GetWindowEnd(dec, width, last_row);   // Last pixel to decode
   const int len_code_limit = NUM_LITERAL_CODES + NUM_LENGTH_CODES;
   const int color_cache_limit = len_code_limit + hdr->color_cache_size_;
-  int next_sync_row = dec->incremental_ ? row : 1 << 24;
+  int next_sync_row = dec->incremental_ ? row
+                    : (dec->window_rows_ > 0) ? GetWindowSlideRow(dec)
+                    : 1 << 24;
   VP8LColorCache* const color_cache =
       (hdr->color_cache_size_ > 0) ? &hdr->color_cache_ : NULL;
   const int mask = hdr->huffman_mask_;
@@ -1132,8 +1440,18 @@ static int DecodeImageData(VP8LDecoder* const dec, uint32_t* const data,
   while (src < src_last) {
     int code;
     if (row >= next_sync_row) {
-      SaveState(dec, (int)(src - data));
-      next_sync_row = row + SYNC_EVERY_N_ROWS;
+      if (dec->incremental_) {
+        SaveState(dec, (int)(src - data));
+        next_sync_row = row + SYNC_EVERY_N_ROWS;
+      } else {   // Make room in the sliding window.
+        const int shift = SlideWindow(dec, (int)(src - data));
+        src -= shift;
+        last_cached -= shift;
+        src_end = data + GetWindowEnd(dec, width, height);
+        src_last = data + GetWindowEnd(dec, width, last_row);
+        next_sync_row = GetWindowSlideRow(dec);
+        assert(row < next_sync_row);
+      }
     }
     // Only update when changing tile. Note we could use this test:
     // if "((((prev_col ^ col) | prev_row ^ row)) > mask)" -> tile changed
@@ -1241,7 +1559,8 @@ static int DecodeImageData(VP8LDecoder* const dec, uint32_t* const data,
       process_func(dec, row > last_row ? last_row : row);
     }
     dec->status_ = VP8_STATUS_OK;
-    dec->last_pixel_ = (int)(src - data);  // end-of-scan marker
+    // end-of-scan marker
+    dec->last_pixel_ = dec->window_row_ * width + (int)(src - data);
   } else {
     // if not incremental, and we are past the end of buffer (eos_=1), then this
     // is a real bitstream error.
@@ -1376,12 +1695,15 @@ VP8LDecoder* VP8LNew(void) {
 }
 
 void VP8LClear(VP8LDecoder* const dec) {
+  WebPDecParams* p;
   int i;
   if (dec == NULL) return;
   ClearMetadata(&dec->hdr_);
 
   WebPSafeFree(dec->pixels_);
   dec->pixels_ = NULL;
+  dec->window_rows_ = 0;
+  dec->window_row_ = 0;
   for (i = 0; i < dec->next_transform_; ++i) {
     ClearTransform(&dec->transforms_[i]);
   }
@@ -1390,6 +1712,13 @@ void VP8LClear(VP8LDecoder* const dec) {
 
   WebPSafeFree(dec->rescaler_memory);
   dec->rescaler_memory = NULL;
+  for (p = dec->next_output_; p != NULL; p = p->next) {
+    WebPSafeFree(p->memory);
+    p->memory = NULL;
+  }
+  dec->next_output_ = NULL;
+  WebPSafeFree(dec->rows_copy_);
+  dec->rows_copy_ = NULL;
 
   dec->output_ = NULL;   // leave no trace behind
 }
@@ -1441,8 +1770,10 @@ static int DecodeImageStream(int xsize, int ysize,
   }
 
   // Read the Huffman codes (may recurse).
+  WEBP_TRACE_BEGIN("ReadHuffmanCodes");
   ok = ok && ReadHuffmanCodes(dec, transform_xsize, transform_ysize,
                               color_cache_bits, is_level0);
+  WEBP_TRACE_END("ReadHuffmanCodes");
   if (!ok) {
     dec->status_ = VP8_STATUS_BITSTREAM_ERROR;
     goto End;
@@ -1502,8 +1833,11 @@ static int DecodeImageStream(int xsize, int ysize,
 
 //------------------------------------------------------------------------------
 // Allocate internal buffers dec->pixels_ and dec->argb_cache_.
+// If dec->window_rows_ is set, 'pixels_' only holds that many rows.
 static int AllocateInternalBuffers32b(VP8LDecoder* const dec, int final_width) {
-  const uint64_t num_pixels = (uint64_t)dec->width_ * dec->height_;
+  const int num_rows =
+      (dec->window_rows_ > 0) ? dec->window_rows_ : dec->height_;
+  const uint64_t num_pixels = (uint64_t)dec->width_ * num_rows;
   // Scratch buffer corresponding to top-prediction row for transforming the
   // first row in the row-blocks. Not needed for paletted alpha.
   const uint64_t cache_top_pixels = (uint16_t)final_width;
@@ -1663,9 +1997,44 @@ int VP8LDecodeHeader(VP8LDecoder* const dec, VP8Io* const io) {
   return 0;
 }
 
+// Sets up the emission of the rows to 'output', for the settings of 'io'.
+// '*rescaler' is set if scaling is needed, with '*memory' to release.
+static int InitOutput(VP8LDecoder* const dec, const VP8Io* const io,
+                      const WebPDecBuffer* const output,
+                      uint8_t** const memory, WebPRescaler** const rescaler) {
+  *rescaler = NULL;
+#if !defined(WEBP_REDUCE_SIZE)
+  if (io->use_scaling) {
+    assert(*memory == NULL);
+    *rescaler = AllocateAndInitRescaler(io, memory);
+    if (*rescaler == NULL) {
+      dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
+      return 0;
+    }
+  }
+#else
+  (void)memory;
+  if (io->use_scaling) {
+    dec->status_ = VP8_STATUS_INVALID_PARAM;
+    return 0;
+  }
+#endif
+  if (io->use_scaling || WebPIsPremultipliedMode(output->colorspace)) {
+    // need the alpha-multiply functions for premultiplied output or rescaling
+    WebPInitAlphaProcessing();
+  }
+
+  if (!WebPIsRGBMode(output->colorspace)) {
+    WebPInitConvertARGBToYUV();
+    if (output->u.YUVA.a != NULL) WebPInitAlphaProcessing();
+  }
+  return 1;
+}
+
 int VP8LDecodeImage(VP8LDecoder* const dec) {
   VP8Io* io = NULL;
   WebPDecParams* params = NULL;
+  WebPDecParams* p;
 
   // Sanity checks.
   if (dec == NULL) return 0;
@@ -1689,24 +2058,38 @@ int VP8LDecodeImage(VP8LDecoder* const dec) {
       goto Err;
     }
 
+    dec->window_rows_ = GetWindowRows(dec);
     if (!AllocateInternalBuffers32b(dec, io->width)) goto Err;
 
-#if !defined(WEBP_REDUCE_SIZE)
-    if (io->use_scaling && !AllocateAndInitRescaler(dec, io)) goto Err;
-#else
-    if (io->use_scaling) {
-      dec->status_ = VP8_STATUS_INVALID_PARAM;
+    if (!InitOutput(dec, io, dec->output_, &dec->rescaler_memory,
+                    &dec->rescaler)) {
       goto Err;
     }
-#endif
-    if (io->use_scaling || WebPIsPremultipliedMode(dec->output_->colorspace)) {
-      // need the alpha-multiply functions for premultiplied output or rescaling
-      WebPInitAlphaProcessing();
+    // The other outputs are fed with the same rows. Their rescaler, if any,
+    // is kept in 'scaler_y'.
+    dec->next_output_ = params->next;
+    for (p = params->next; p != NULL; p = p->next) {
+      p->memory = NULL;
     }
-
-    if (!WebPIsRGBMode(dec->output_->colorspace)) {
-      WebPInitConvertARGBToYUV();
-      if (dec->output_->u.YUVA.a != NULL) WebPInitAlphaProcessing();
+    for (p = params->next; p != NULL; p = p->next) {
+      VP8Io sub_io;
+      uint8_t* memory = NULL;
+      if (!WebPIoInitChainedOutput(p, io, &sub_io, MODE_BGRA)) {
+        dec->status_ = VP8_STATUS_INVALID_PARAM;
+        goto Err;
+      }
+      if (!InitOutput(dec, &sub_io, p->output, &memory, &p->scaler_y)) {
+        goto Err;
+      }
+      p->memory = memory;
+      if (sub_io.use_scaling && dec->rows_copy_ == NULL) {
+        dec->rows_copy_ = (uint32_t*)WebPSafeMalloc(
+            (uint64_t)io->mb_w * NUM_ARGB_CACHE_ROWS, sizeof(*dec->rows_copy_));
+        if (dec->rows_copy_ == NULL) {
+          dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
+          goto Err;
+        }
+      }
     }
     if (dec->incremental_) {
       if (dec->hdr_.color_cache_size_ > 0 &&
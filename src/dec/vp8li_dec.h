@@ -65,9 +65,14 @@ struct VP8LDecoder {
   uint32_t*        pixels_;        // Internal data: either uint8_t* for alpha
                                    // or uint32_t* for BGRA.
   uint32_t*        argb_cache_;    // Scratch buffer for temporary BGRA storage.
+  int              window_rows_;   // If > 0, 'pixels_' is a sliding window
+                                   // only holding this many rows of the image
+  int              window_row_;    // image row stored at the top of 'pixels_'
 
   VP8LBitReader    br_;
   int              incremental_;   // if true, incremental decoding is expected
+  int              use_threads_;   // if true, Huffman tables are built with
+                                   // several threads, when worth it
   VP8LBitReader    saved_br_;      // note: could be local variables too
   int              saved_last_pixel_;
 
@@ -88,6 +93,10 @@ struct VP8LDecoder {
 
   uint8_t*         rescaler_memory;  // Working memory for rescaling work.
   WebPRescaler*    rescaler;         // Common rescaler for all channels.
+
+  WebPDecParams*   next_output_;     // other outputs fed with the same rows
+  uint32_t*        rows_copy_;       // copy of the rows, for these outputs
+                                     // to premultiply when rescaling
 };
 
 //------------------------------------------------------------------------------
@@ -16,6 +16,7 @@
 #include "src/dec/vp8i_dec.h"
 #include "src/dec/vp8li_dec.h"
 #include "src/dec/webpi_dec.h"
+#include "src/utils/trace_utils.h"
 #include "src/utils/utils.h"
 #include "src/webp/mux_types.h"  // ALPHA_FLAG
 
@@ -443,12 +444,25 @@ void WebPResetDecParams(WebPDecParams* const params) {
 //------------------------------------------------------------------------------
 // "Into" decoding variants
 
+// Allocates (or checks) the buffers of 'params' and of its chained outputs.
+static VP8StatusCode AllocateOutputs(int width, int height,
+                                     const WebPDecParams* params) {
+  VP8StatusCode status = VP8_STATUS_OK;
+  for (; params != NULL && status == VP8_STATUS_OK; params = params->next) {
+    status = WebPAllocateDecBuffer(width, height, params->options,
+                                   params->output);
+  }
+  return status;
+}
+
 // Main flow
 static VP8StatusCode DecodeInto(const uint8_t* const data, size_t data_size,
                                 WebPDecParams* const params) {
   VP8StatusCode status;
   VP8Io io;
   WebPHeaderStructure headers;
+  const WebPDecParams* p;
+  int ok;
 
   headers.data = data;
   headers.data_size = data_size;
@@ -473,18 +487,23 @@ static VP8StatusCode DecodeInto(const uint8_t* const data, size_t data_size,
     dec->alpha_data_size_ = headers.alpha_data_size;
 
     // Decode bitstream header, update io->width/io->height.
-    if (!VP8GetHeaders(dec, &io)) {
+    WEBP_TRACE_BEGIN("VP8GetHeaders");
+    ok = VP8GetHeaders(dec, &io);
+    WEBP_TRACE_END("VP8GetHeaders");
+    if (!ok) {
       status = dec->status_;   // An error occurred. Grab error status.
     } else {
       // Allocate/check output buffers.
-      status = WebPAllocateDecBuffer(io.width, io.height, params->options,
-                                     params->output);
+      status = AllocateOutputs(io.width, io.height, params);
       if (status == VP8_STATUS_OK) {  // Decode
         // This change must be done before calling VP8Decode()
         dec->mt_method_ = VP8GetThreadMethod(params->options, &headers,
                                              io.width, io.height);
         VP8InitDithering(params->options, dec);
-        if (!VP8Decode(dec, &io)) {
+        WEBP_TRACE_BEGIN("VP8Decode");
+        ok = VP8Decode(dec, &io);
+        WEBP_TRACE_END("VP8Decode");
+        if (!ok) {
           status = dec->status_;
         }
       }
@@ -495,14 +514,21 @@ static VP8StatusCode DecodeInto(const uint8_t* const data, size_t data_size,
     if (dec == NULL) {
       return VP8_STATUS_OUT_OF_MEMORY;
     }
-    if (!VP8LDecodeHeader(dec, &io)) {
+    dec->use_threads_ =
+        (params->options != NULL) && params->options->use_threads;
+    WEBP_TRACE_BEGIN("VP8LDecodeHeader");
+    ok = VP8LDecodeHeader(dec, &io);
+    WEBP_TRACE_END("VP8LDecodeHeader");
+    if (!ok) {
       status = dec->status_;   // An error occurred. Grab error status.
     } else {
       // Allocate/check output buffers.
-      status = WebPAllocateDecBuffer(io.width, io.height, params->options,
-                                     params->output);
+      status = AllocateOutputs(io.width, io.height, params);
       if (status == VP8_STATUS_OK) {  // Decode
-        if (!VP8LDecodeImage(dec)) {
+        WEBP_TRACE_BEGIN("VP8LDecodeImage");
+        ok = VP8LDecodeImage(dec);
+        WEBP_TRACE_END("VP8LDecodeImage");
+        if (!ok) {
           status = dec->status_;
         }
       }
@@ -511,12 +537,14 @@ static VP8StatusCode DecodeInto(const uint8_t* const data, size_t data_size,
   }
 
   if (status != VP8_STATUS_OK) {
-    WebPFreeDecBuffer(params->output);
+    for (p = params; p != NULL; p = p->next) WebPFreeDecBuffer(p->output);
   } else {
-    if (params->options != NULL && params->options->flip) {
-      // This restores the original stride values if options->flip was used
-      // during the call to WebPAllocateDecBuffer above.
-      status = WebPFlipBuffer(params->output);
+    for (p = params; p != NULL && status == VP8_STATUS_OK; p = p->next) {
+      if (p->options != NULL && p->options->flip) {
+        // This restores the original stride values if options->flip was used
+        // during the call to WebPAllocateDecBuffer above.
+        status = WebPFlipBuffer(p->output);
+      }
     }
   }
   return status;
@@ -782,6 +810,63 @@ VP8StatusCode WebPDecode(const uint8_t* data, size_t data_size,
   return status;
 }
 
+VP8StatusCode WebPDecodeRenditions(const uint8_t* data, size_t data_size,
+                                   WebPDecoderConfig* configs,
+                                   int num_configs) {
+  WebPDecParams* params;
+  WebPDecBuffer* in_mem_buffers;
+  VP8StatusCode status;
+  int i;
+
+  if (configs == NULL || num_configs <= 0) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+
+  status = GetFeatures(data, data_size, &configs[0].input);
+  if (status != VP8_STATUS_OK) {
+    if (status == VP8_STATUS_NOT_ENOUGH_DATA) {
+      return VP8_STATUS_BITSTREAM_ERROR;  // Not-enough-data treated as error.
+    }
+    return status;
+  }
+
+  params = (WebPDecParams*)WebPSafeMalloc(num_configs, sizeof(*params));
+  in_mem_buffers =
+      (WebPDecBuffer*)WebPSafeMalloc(num_configs, sizeof(*in_mem_buffers));
+  if (params == NULL || in_mem_buffers == NULL) {
+    status = VP8_STATUS_OUT_OF_MEMORY;
+    goto End;
+  }
+  for (i = 0; i < num_configs; ++i) {
+    WebPDecoderConfig* const config = &configs[i];
+    WebPDecParams* const p = &params[i];
+    config->input = configs[0].input;
+    WebPResetDecParams(p);
+    WebPInitDecBuffer(&in_mem_buffers[i]);
+    p->options = &config->options;
+    p->output = &config->output;
+    p->next = (i + 1 < num_configs) ? &params[i + 1] : NULL;
+    if (WebPAvoidSlowMemory(p->output, &config->input)) {
+      // decoding to slow memory: use a temporary in-mem buffer to decode into.
+      in_mem_buffers[i].colorspace = config->output.colorspace;
+      p->output = &in_mem_buffers[i];
+    }
+  }
+  status = DecodeInto(data, data_size, params);
+  for (i = 0; i < num_configs; ++i) {
+    if (params[i].output != &in_mem_buffers[i]) continue;
+    if (status == VP8_STATUS_OK) {  // do the slow-copy
+      status = WebPCopyDecBufferPixels(&in_mem_buffers[i], &configs[i].output);
+    }
+    WebPFreeDecBuffer(&in_mem_buffers[i]);
+  }
+
+ End:
+  WebPSafeFree(in_mem_buffers);
+  WebPSafeFree(params);
+  return status;
+}
+
 //------------------------------------------------------------------------------
 // Cropping and rescaling.
 
@@ -842,4 +927,31 @@ int WebPIoInitFromOptions(const WebPDecoderOptions* const options,
   return 1;
 }
 
+int WebPIoInitChainedOutput(WebPDecParams* const p, VP8Io* const io,
+                            VP8Io* const sub_io, WEBP_CSP_MODE src_colorspace) {
+  *sub_io = *io;
+  if (!WebPIoInitFromOptions(p->options, sub_io, src_colorspace)) return 0;
+  if (sub_io->crop_left != io->crop_left ||
+      sub_io->crop_top != io->crop_top ||
+      sub_io->crop_right != io->crop_right ||
+      sub_io->crop_bottom != io->crop_bottom) {
+    return 0;   // the samples are only reconstructed within one crop window
+  }
+  io->bypass_filtering &= sub_io->bypass_filtering;
+  p->use_scaling = sub_io->use_scaling;
+  p->scaled_width = sub_io->scaled_width;
+  p->scaled_height = sub_io->scaled_height;
+  p->fancy_upsampling = sub_io->fancy_upsampling;
+  return 1;
+}
+
+void WebPIoGetChainedOutput(const WebPDecParams* const p,
+                            const VP8Io* const io, VP8Io* const sub_io) {
+  *sub_io = *io;
+  sub_io->use_scaling = p->use_scaling;
+  sub_io->scaled_width = p->scaled_width;
+  sub_io->scaled_height = p->scaled_height;
+  sub_io->fancy_upsampling = p->fancy_upsampling;
+}
+
 //------------------------------------------------------------------------------
@@ -45,6 +45,14 @@ struct WebPDecParams {
   OutputFunc emit;               // output RGB or YUV samples
   OutputAlphaFunc emit_alpha;    // output alpha channel
   OutputRowFunc emit_alpha_row;  // output one line of rescaled alpha values
+
+  // Next output to feed with the same reconstructed samples, or NULL.
+  // Each of these chained outputs records the scaling and upsampling it was
+  // set up with, the cropping being common to all.
+  WebPDecParams* next;
+  int use_scaling;
+  int scaled_width, scaled_height;
+  int fancy_upsampling;
 };
 
 // Should be called first, before any use of the WebPDecParams object.
@@ -86,6 +94,18 @@ void WebPInitCustomIo(WebPDecParams* const params, VP8Io* const io);
 int WebPIoInitFromOptions(const WebPDecoderOptions* const options,
                           VP8Io* const io, WEBP_CSP_MODE src_colorspace);
 
+// Sets 'sub_io' up for the output 'p', chained to the one 'io' was set up for
+// with WebPIoInitFromOptions(), and records its settings in 'p'. The cropping
+// must be the same. The filtering of 'io' is kept unless 'p' bypasses it too.
+// Returns false in case of error.
+int WebPIoInitChainedOutput(WebPDecParams* const p, VP8Io* const io,
+                            VP8Io* const sub_io, WEBP_CSP_MODE src_colorspace);
+
+// Sets 'sub_io' to 'io' with the scaling and upsampling settings recorded in
+// 'p' by WebPIoInitChainedOutput().
+void WebPIoGetChainedOutput(const WebPDecParams* const p,
+                            const VP8Io* const io, VP8Io* const sub_io);
+
 //------------------------------------------------------------------------------
 // Internal functions regarding WebPDecBuffer memory (in buffer.c).
 // Don't really need to be externally visible for now.
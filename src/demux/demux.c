@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "src/utils/thread_utils.h"
 #include "src/utils/utils.h"
 #include "src/webp/decode.h"     // WebPGetFeatures
 #include "src/webp/demux.h"
@@ -49,6 +50,7 @@ typedef struct Frame {
   WebPMuxAnimBlend blend_method_;
   int frame_num_;
   int complete_;   // img_components_ contains a full image.
+  int unchecked_;  // the bitstream header of img_components_[0] is unread.
   ChunkData img_components_[2];  // 0=VP8{,L} 1=ALPH
   struct Frame* next_;
 } Frame;
@@ -69,6 +71,8 @@ struct WebPDemuxer {
   int num_frames_;
   Frame* frames_;
   Frame** frames_tail_;
+  Frame** frames_index_;    // frames_index_[n - 1] is the frame number 'n'.
+  int frames_index_size_;   // Allocated size of 'frames_index_'.
   Chunk* chunks_;  // non-image chunks
   Chunk** chunks_tail_;
 };
@@ -180,11 +184,34 @@ static void AddChunk(WebPDemuxer* const dmux, Chunk* const chunk) {
   dmux->chunks_tail_ = &chunk->next_;
 }
 
+// Stores 'frame', the next frame to be counted in 'num_frames_', in the index
+// used for random access. Returns false in case of memory error.
+static int IndexFrame(WebPDemuxer* const dmux, Frame* const frame) {
+  assert(frame->frame_num_ == dmux->num_frames_ + 1);
+  if (dmux->num_frames_ == dmux->frames_index_size_) {
+    const int new_size =
+        (dmux->frames_index_size_ == 0) ? 16 : 2 * dmux->frames_index_size_;
+    Frame** const new_index =
+        (Frame**)WebPSafeMalloc(new_size, sizeof(*new_index));
+    if (new_index == NULL) return 0;
+    if (dmux->num_frames_ > 0) {
+      memcpy(new_index, dmux->frames_index_,
+             dmux->num_frames_ * sizeof(*new_index));
+    }
+    WebPSafeFree(dmux->frames_index_);
+    dmux->frames_index_ = new_index;
+    dmux->frames_index_size_ = new_size;
+  }
+  dmux->frames_index_[dmux->num_frames_] = frame;
+  return 1;
+}
+
 // Add a frame to the end of the list, ensuring the last frame is complete.
 // Returns true on success, false otherwise.
 static int AddFrame(WebPDemuxer* const dmux, Frame* const frame) {
   const Frame* const last_frame = *dmux->frames_tail_;
   if (last_frame != NULL && !last_frame->complete_) return 0;
+  if (!IndexFrame(dmux, frame)) return 0;
 
   *dmux->frames_tail_ = frame;
   frame->next_ = NULL;
@@ -192,22 +219,31 @@ static int AddFrame(WebPDemuxer* const dmux, Frame* const frame) {
   return 1;
 }
 
+// 'features' can be NULL for a complete image chunk, which is then checked by
+// CheckFrames().
 static void SetFrameInfo(size_t start_offset, size_t size,
                          int frame_num, int complete,
                          const WebPBitstreamFeatures* const features,
                          Frame* const frame) {
   frame->img_components_[0].offset_ = start_offset;
   frame->img_components_[0].size_ = size;
-  frame->width_ = features->width;
-  frame->height_ = features->height;
-  frame->has_alpha_ |= features->has_alpha;
+  if (features != NULL) {
+    frame->width_ = features->width;
+    frame->height_ = features->height;
+    frame->has_alpha_ |= features->has_alpha;
+  } else {
+    assert(complete);
+    frame->unchecked_ = 1;
+  }
   frame->frame_num_ = frame_num;
   frame->complete_ = complete;
 }
 
 // Store image bearing chunks to 'frame'. 'min_size' is an optional size
-// requirement, it may be zero.
+// requirement, it may be zero. If 'defer_check' is true, the bitstream header
+// of a complete image chunk is left to CheckFrames().
 static ParseStatus StoreFrame(int frame_num, uint32_t min_size,
+                              int defer_check,
                               MemBuffer* const mem, Frame* const frame) {
   int alpha_chunks = 0;
   int image_chunks = 0;
@@ -247,7 +283,12 @@ static ParseStatus StoreFrame(int frame_num, uint32_t min_size,
         if (alpha_chunks > 0) return PARSE_ERROR;  // VP8L has its own alpha
         // fall through
       case MKFOURCC('V', 'P', '8', ' '):
-        if (image_chunks == 0) {
+        if (image_chunks == 0 && defer_check && status == PARSE_OK) {
+          ++image_chunks;
+          SetFrameInfo(chunk_start_offset, chunk_size, frame_num, 1, NULL,
+                       frame);
+          Skip(mem, payload_available);
+        } else if (image_chunks == 0) {
           // Extract the bitstream features, tolerating failures when the data
           // is incomplete.
           WebPBitstreamFeatures features;
@@ -332,7 +373,8 @@ static ParseStatus ParseAnimationFrame(
 
   // Store a frame only if the animation flag is set there is some data for
   // this frame is available.
-  status = StoreFrame(dmux->num_frames_ + 1, anmf_payload_size, mem, frame);
+  status = StoreFrame(dmux->num_frames_ + 1, anmf_payload_size,
+                      1 /*defer_check*/, mem, frame);
   if (status != PARSE_ERROR && is_animation && frame->frame_num_ > 0) {
     added_frame = AddFrame(dmux, frame);
     if (added_frame) {
@@ -405,7 +447,7 @@ static ParseStatus ParseSingleImage(WebPDemuxer* const dmux) {
 
   // For the single image case we allow parsing of a partial frame, so no
   // minimum size is imposed here.
-  status = StoreFrame(1, 0, &dmux->mem_, frame);
+  status = StoreFrame(1, 0, 0 /*defer_check*/, &dmux->mem_, frame);
   if (status != PARSE_ERROR) {
     const int has_alpha = !!(dmux->feature_flags_ & ALPHA_FLAG);
     // Clear any alpha when the alpha flag is missing.
@@ -557,6 +599,82 @@ static ParseStatus ParseVP8X(WebPDemuxer* const dmux) {
   return ParseVP8XChunks(dmux);
 }
 
+// -----------------------------------------------------------------------------
+// Frame checks
+
+// The bitstream headers of the frames of an animation are read once all the
+// chunks are indexed. With many frames, this is done concurrently on
+// contiguous ranges of frames.
+#define MIN_FRAMES_PER_CHECK_JOB 2048
+#define MAX_CHECK_JOBS 4
+
+typedef struct {
+  WebPWorker worker_;
+  const MemBuffer* mem_;
+  Frame** frames_;
+  int num_frames_;
+} FrameCheckJob;
+
+static int CheckFramesJob(void* arg1, void* arg2) {
+  const FrameCheckJob* const job = (const FrameCheckJob*)arg1;
+  int i;
+  (void)arg2;
+  for (i = 0; i < job->num_frames_; ++i) {
+    Frame* const frame = job->frames_[i];
+    if (frame->unchecked_) {
+      const ChunkData* const image = &frame->img_components_[0];
+      WebPBitstreamFeatures features;
+      if (WebPGetFeatures(job->mem_->buf_ + image->offset_, image->size_,
+                          &features) != VP8_STATUS_OK) {
+        return 0;
+      }
+      frame->width_ = features.width;
+      frame->height_ = features.height;
+      frame->has_alpha_ |= features.has_alpha;
+      frame->unchecked_ = 0;
+    }
+  }
+  return 1;
+}
+
+// Reads the bitstream headers left unread by StoreFrame().
+// Returns false if one of them is invalid.
+static int CheckFrames(WebPDemuxer* const dmux) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  FrameCheckJob jobs[MAX_CHECK_JOBS];
+  int num_jobs = dmux->num_frames_ / MIN_FRAMES_PER_CHECK_JOB;
+  int ok = 1;
+  int i;
+  if (num_jobs > MAX_CHECK_JOBS) num_jobs = MAX_CHECK_JOBS;
+  if (num_jobs < 1) num_jobs = 1;
+  for (i = 0; i < num_jobs; ++i) {
+    FrameCheckJob* const job = &jobs[i];
+    const int first = dmux->num_frames_ * i / num_jobs;
+    const int last = dmux->num_frames_ * (i + 1) / num_jobs;
+    worker_interface->Init(&job->worker_);
+    job->mem_ = &dmux->mem_;
+    job->frames_ = dmux->frames_index_ + first;
+    job->num_frames_ = last - first;
+    job->worker_.data1 = job;
+    job->worker_.data2 = NULL;
+    job->worker_.hook = CheckFramesJob;
+    // The last range is checked by the calling thread.
+    if (i + 1 < num_jobs && worker_interface->Reset(&job->worker_)) {
+      worker_interface->Launch(&job->worker_);
+    } else {
+      worker_interface->Execute(&job->worker_);
+    }
+  }
+  for (i = 0; i < num_jobs; ++i) {
+    ok &= worker_interface->Sync(&jobs[i].worker_);
+    worker_interface->End(&jobs[i].worker_);
+  }
+  return ok;
+}
+
+#undef MIN_FRAMES_PER_CHECK_JOB
+#undef MAX_CHECK_JOBS
+
 // -----------------------------------------------------------------------------
 // Format validation
 
@@ -739,6 +857,7 @@ WebPDemuxer* WebPDemuxInternal(const WebPData* data, int allow_partial,
       status = parser->parse(dmux);
       if (status == PARSE_OK) dmux->state_ = WEBP_DEMUX_DONE;
       if (status == PARSE_NEED_MORE_DATA && !partial) status = PARSE_ERROR;
+      if (status != PARSE_ERROR && !CheckFrames(dmux)) status = PARSE_ERROR;
       if (status != PARSE_ERROR && !parser->valid(dmux)) status = PARSE_ERROR;
       if (status == PARSE_ERROR) dmux->state_ = WEBP_DEMUX_PARSE_ERROR;
       break;
@@ -768,6 +887,7 @@ void WebPDemuxDelete(WebPDemuxer* dmux) {
     c = c->next_;
     WebPSafeFree(cur_chunk);
   }
+  WebPSafeFree(dmux->frames_index_);
   WebPSafeFree(dmux);
 }
 
@@ -792,9 +912,9 @@ uint32_t WebPDemuxGetI(const WebPDemuxer* dmux, WebPFormatFeature feature) {
 
 static const Frame* GetFrame(const WebPDemuxer* const dmux, int frame_num) {
   const Frame* f;
-  for (f = dmux->frames_; f != NULL; f = f->next_) {
-    if (frame_num == f->frame_num_) break;
-  }
+  if (frame_num < 1 || frame_num > dmux->num_frames_) return NULL;
+  f = dmux->frames_index_[frame_num - 1];
+  assert(f->frame_num_ == frame_num);
   return f;
 }
 
@@ -146,13 +146,27 @@ extern "C" {
 #if defined(WEBP_USE_THREAD) && !defined(_WIN32)
 #include <pthread.h>  // NOLINT
 
+// With acquire / release atomics, an initialization already done is detected
+// without taking the lock, which is then only used by the first callers.
+#if defined(__ATOMIC_ACQUIRE) && defined(__ATOMIC_RELEASE)
+#define WEBP_DSP_INIT_IS_DONE(last_cpuinfo_used) \
+  (__atomic_load_n(&(last_cpuinfo_used), __ATOMIC_ACQUIRE) == VP8GetCPUInfo)
+#define WEBP_DSP_INIT_SET_DONE(last_cpuinfo_used) \
+  __atomic_store_n(&(last_cpuinfo_used), VP8GetCPUInfo, __ATOMIC_RELEASE)
+#else
+#define WEBP_DSP_INIT_IS_DONE(last_cpuinfo_used) 0
+#define WEBP_DSP_INIT_SET_DONE(last_cpuinfo_used) \
+  (last_cpuinfo_used) = VP8GetCPUInfo
+#endif
+
 #define WEBP_DSP_INIT(func) do {                                    \
   static volatile VP8CPUInfo func ## _last_cpuinfo_used =           \
       (VP8CPUInfo)&func ## _last_cpuinfo_used;                      \
   static pthread_mutex_t func ## _lock = PTHREAD_MUTEX_INITIALIZER; \
+  if (WEBP_DSP_INIT_IS_DONE(func ## _last_cpuinfo_used)) break;     \
   if (pthread_mutex_lock(&func ## _lock)) break;                    \
   if (func ## _last_cpuinfo_used != VP8GetCPUInfo) func();          \
-  func ## _last_cpuinfo_used = VP8GetCPUInfo;                       \
+  WEBP_DSP_INIT_SET_DONE(func ## _last_cpuinfo_used);               \
   (void)pthread_mutex_unlock(&func ## _lock);                       \
 } while (0)
 #else  // !(defined(WEBP_USE_THREAD) && !defined(_WIN32))
@@ -140,6 +140,37 @@ typedef void (*VP8LCollectColorRedTransformsFunc)(
     int green_to_red, int histo[]);
 extern VP8LCollectColorRedTransformsFunc VP8LCollectColorRedTransforms;
 
+// Batched versions of the above: histos[i] is updated with the transform
+// using the i-th set of multipliers, reading the tile only once.
+#define VP8L_MAX_COLOR_TRANSFORM_BATCH 16   // max value of 'num_multipliers'
+typedef void (*VP8LCollectColorBlueTransformsBatchFunc)(
+    const uint32_t* argb, int stride,
+    int tile_width, int tile_height,
+    const int green_to_blue[], const int red_to_blue[], int num_multipliers,
+    int histos[][256]);
+extern VP8LCollectColorBlueTransformsBatchFunc
+    VP8LCollectColorBlueTransformsBatch;
+
+typedef void (*VP8LCollectColorRedTransformsBatchFunc)(
+    const uint32_t* argb, int stride,
+    int tile_width, int tile_height,
+    const int green_to_red[], int num_multipliers, int histos[][256]);
+extern VP8LCollectColorRedTransformsBatchFunc
+    VP8LCollectColorRedTransformsBatch;
+
+// Number of spatial predictors evaluated by the encoder (modes 0 to 13).
+#define VP8L_NUM_PREDICTOR_MODES 14
+
+// Accumulates in histos[mode] the ARGB histograms of the residuals of the tile
+// for every predictor mode, in a single pass over the tile. The tile must not
+// touch the top row nor the left column of the image: argb[-1] and the upper
+// row, including its pixel to the right, are read as context.
+typedef void (*VP8LCollectPredictorHistogramsFunc)(
+    const uint32_t* argb, int stride,
+    int tile_width, int tile_height,
+    int histos[VP8L_NUM_PREDICTOR_MODES][4][256]);
+extern VP8LCollectPredictorHistogramsFunc VP8LCollectPredictorHistograms;
+
 // Expose some C-only fallback functions
 void VP8LTransformColor_C(const VP8LMultipliers* const m,
                           uint32_t* data, int num_pixels);
@@ -151,6 +182,17 @@ void VP8LCollectColorBlueTransforms_C(const uint32_t* argb, int stride,
                                       int tile_width, int tile_height,
                                       int green_to_blue, int red_to_blue,
                                       int histo[]);
+void VP8LCollectColorRedTransformsBatch_C(const uint32_t* argb, int stride,
+                                          int tile_width, int tile_height,
+                                          const int green_to_red[],
+                                          int num_multipliers,
+                                          int histos[][256]);
+void VP8LCollectColorBlueTransformsBatch_C(const uint32_t* argb, int stride,
+                                           int tile_width, int tile_height,
+                                           const int green_to_blue[],
+                                           const int red_to_blue[],
+                                           int num_multipliers,
+                                           int histos[][256]);
 
 extern VP8LPredictorAddSubFunc VP8LPredictorsSub[16];
 extern VP8LPredictorAddSubFunc VP8LPredictorsSub_C[16];
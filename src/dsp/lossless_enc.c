@@ -582,6 +582,42 @@ void VP8LCollectColorBlueTransforms_C(const uint32_t* argb, int stride,
   }
 }
 
+void VP8LCollectColorRedTransformsBatch_C(const uint32_t* argb, int stride,
+                                          int tile_width, int tile_height,
+                                          const int green_to_red[],
+                                          int num_multipliers,
+                                          int histos[][256]) {
+  assert(num_multipliers <= VP8L_MAX_COLOR_TRANSFORM_BATCH);
+  while (tile_height-- > 0) {
+    int x, i;
+    for (x = 0; x < tile_width; ++x) {
+      for (i = 0; i < num_multipliers; ++i) {
+        ++histos[i][TransformColorRed((uint8_t)green_to_red[i], argb[x])];
+      }
+    }
+    argb += stride;
+  }
+}
+
+void VP8LCollectColorBlueTransformsBatch_C(const uint32_t* argb, int stride,
+                                           int tile_width, int tile_height,
+                                           const int green_to_blue[],
+                                           const int red_to_blue[],
+                                           int num_multipliers,
+                                           int histos[][256]) {
+  assert(num_multipliers <= VP8L_MAX_COLOR_TRANSFORM_BATCH);
+  while (tile_height-- > 0) {
+    int x, i;
+    for (x = 0; x < tile_width; ++x) {
+      for (i = 0; i < num_multipliers; ++i) {
+        ++histos[i][TransformColorBlue((uint8_t)green_to_blue[i],
+                                       (uint8_t)red_to_blue[i], argb[x])];
+      }
+    }
+    argb += stride;
+  }
+}
+
 //------------------------------------------------------------------------------
 
 static int VectorMismatch_C(const uint32_t* const array1,
@@ -865,6 +901,39 @@ GENERATE_PREDICTOR_SUB(Predictor13, PredictorSub13_C)
 
 //------------------------------------------------------------------------------
 
+#define PREDICTOR_HISTO_SPAN 64   // number of pixels predicted at once
+
+static void CollectPredictorHistograms_C(
+    const uint32_t* argb, int stride, int tile_width, int tile_height,
+    int histos[VP8L_NUM_PREDICTOR_MODES][4][256]) {
+  uint32_t residuals[PREDICTOR_HISTO_SPAN];
+  while (tile_height-- > 0) {
+    int x;
+    for (x = 0; x < tile_width; x += PREDICTOR_HISTO_SPAN) {
+      const int num_pixels = (tile_width - x < PREDICTOR_HISTO_SPAN) ?
+                             tile_width - x : PREDICTOR_HISTO_SPAN;
+      int mode, i;
+      // The span and its context stay in cache for all the predictors.
+      for (mode = 0; mode < VP8L_NUM_PREDICTOR_MODES; ++mode) {
+        int (* const histo)[256] = histos[mode];
+        VP8LPredictorsSub[mode](argb + x, argb + x - stride, num_pixels,
+                                residuals);
+        for (i = 0; i < num_pixels; ++i) {
+          const uint32_t r = residuals[i];
+          ++histo[0][r >> 24];
+          ++histo[1][(r >> 16) & 0xff];
+          ++histo[2][(r >> 8) & 0xff];
+          ++histo[3][r & 0xff];
+        }
+      }
+    }
+    argb += stride;
+  }
+}
+#undef PREDICTOR_HISTO_SPAN
+
+//------------------------------------------------------------------------------
+
 // Added for CUDA
 void VP8LColorSpaceTransform_C(int width, int height, int bits, int quality,
                                uint32_t* const argb, uint32_t* image);
@@ -876,6 +945,9 @@ VP8LTransformColorFunc VP8LTransformColor;
 
 VP8LCollectColorBlueTransformsFunc VP8LCollectColorBlueTransforms;
 VP8LCollectColorRedTransformsFunc VP8LCollectColorRedTransforms;
+VP8LCollectColorBlueTransformsBatchFunc VP8LCollectColorBlueTransformsBatch;
+VP8LCollectColorRedTransformsBatchFunc VP8LCollectColorRedTransformsBatch;
+VP8LCollectPredictorHistogramsFunc VP8LCollectPredictorHistograms;
 
 VP8LFastLog2SlowFunc VP8LFastLog2Slow;
 VP8LFastLog2SlowFunc VP8LFastSLog2Slow;
@@ -917,6 +989,9 @@ WEBP_DSP_INIT_FUNC(VP8LEncDspInit) {
 
   VP8LCollectColorBlueTransforms = VP8LCollectColorBlueTransforms_C;
   VP8LCollectColorRedTransforms = VP8LCollectColorRedTransforms_C;
+  VP8LCollectColorBlueTransformsBatch = VP8LCollectColorBlueTransformsBatch_C;
+  VP8LCollectColorRedTransformsBatch = VP8LCollectColorRedTransformsBatch_C;
+  VP8LCollectPredictorHistograms = CollectPredictorHistograms_C;
 
   VP8LFastLog2Slow = FastLog2Slow_C;
   VP8LFastSLog2Slow = FastSLog2Slow_C;
@@ -1012,6 +1087,9 @@ WEBP_DSP_INIT_FUNC(VP8LEncDspInit) {
   assert(VP8LTransformColor != NULL);
   assert(VP8LCollectColorBlueTransforms != NULL);
   assert(VP8LCollectColorRedTransforms != NULL);
+  assert(VP8LCollectColorBlueTransformsBatch != NULL);
+  assert(VP8LCollectColorRedTransformsBatch != NULL);
+  assert(VP8LCollectPredictorHistograms != NULL);
   assert(VP8LFastLog2Slow != NULL);
   assert(VP8LFastSLog2Slow != NULL);
   assert(VP8LExtraCost != NULL);
@@ -543,6 +543,128 @@ static void CollectColorBlueTransforms_CUDA(const uint32_t* argb, int stride,
     cudaCheckError(cudaFree(histo_result));
 }
 
+// Batched versions: blockIdx.z selects the candidate multipliers, so that the
+// tile is uploaded once and a single kernel is launched for all of them.
+__global__ void CollectColorBlueTransformsBatch_kernel(const uint32_t* argb, int stride,
+                                                         int tile_width, int tile_height,
+                                                         const int* green_to_blue,
+                                                         const int* red_to_blue,
+                                                         int histos[]) {
+    int x = blockIdx.x * blockDim.x + threadIdx.x;
+    int y = blockIdx.y * blockDim.y + threadIdx.y;
+    int k = blockIdx.z;
+    int ind = threadIdx.y * blockDim.x + threadIdx.x;
+
+    __shared__ int histo_temp[256];
+    if (ind < 256) histo_temp[ind] = 0;
+    __syncthreads();
+
+    if (x < tile_width && y < tile_height) {
+        int transform_index = TransformColorBlue((uint8_t)green_to_blue[k],
+                                                 (uint8_t)red_to_blue[k],
+                                                 argb[stride * y + x]);
+        atomicAdd(&histo_temp[transform_index], 1);
+    }
+    __syncthreads();
+
+    if (ind < 256) atomicAdd(&histos[k * 256 + ind], histo_temp[ind]);
+}
+
+__global__ void CollectColorRedTransformsBatch_kernel(const uint32_t* argb, int stride,
+                                                        int tile_width, int tile_height,
+                                                        const int* green_to_red,
+                                                        int histos[]) {
+    int x = blockIdx.x * blockDim.x + threadIdx.x;
+    int y = blockIdx.y * blockDim.y + threadIdx.y;
+    int k = blockIdx.z;
+    int ind = threadIdx.y * blockDim.x + threadIdx.x;
+
+    __shared__ int histo_temp[256];
+    if (ind < 256) histo_temp[ind] = 0;
+    __syncthreads();
+
+    if (x < tile_width && y < tile_height) {
+        int transform_index = TransformColorRed((uint8_t)green_to_red[k],
+                                                argb[stride * y + x]);
+        atomicAdd(&histo_temp[transform_index], 1);
+    }
+    __syncthreads();
+
+    if (ind < 256) atomicAdd(&histos[k * 256 + ind], histo_temp[ind]);
+}
+
+static void CollectColorBlueTransformsBatch_CUDA(const uint32_t* argb, int stride,
+                                                 int tile_width, int tile_height,
+                                                 const int green_to_blue[],
+                                                 const int red_to_blue[],
+                                                 int num_multipliers,
+                                                 int histos[][256]) {
+    // Dimensions: one z-slice of blocks per candidate
+    dim3 blockDim(16, 16);
+    dim3 gridDim((tile_width  + blockDim.x - 1) / blockDim.x,
+                 (tile_height + blockDim.y - 1) / blockDim.y,
+                 num_multipliers);
+
+    size_t argb_size = (tile_height - 1) * stride + tile_width;
+    size_t histos_size = num_multipliers * 256 * sizeof(int);
+    size_t mults_size = num_multipliers * sizeof(int);
+
+    uint32_t *argb_result;
+    int *histos_result, *green_to_blue_result, *red_to_blue_result;
+    cudaCheckError(cudaMalloc(&argb_result, argb_size * sizeof(uint32_t)));
+    cudaCheckError(cudaMalloc(&histos_result, histos_size));
+    cudaCheckError(cudaMalloc(&green_to_blue_result, mults_size));
+    cudaCheckError(cudaMalloc(&red_to_blue_result, mults_size));
+
+    cudaCheckError(cudaMemcpy(argb_result, argb, argb_size * sizeof(uint32_t), cudaMemcpyHostToDevice));
+    cudaCheckError(cudaMemcpy(histos_result, histos, histos_size, cudaMemcpyHostToDevice));
+    cudaCheckError(cudaMemcpy(green_to_blue_result, green_to_blue, mults_size, cudaMemcpyHostToDevice));
+    cudaCheckError(cudaMemcpy(red_to_blue_result, red_to_blue, mults_size, cudaMemcpyHostToDevice));
+
+    CollectColorBlueTransformsBatch_kernel<<<gridDim, blockDim>>>(argb_result, stride, tile_width, tile_height, green_to_blue_result, red_to_blue_result, histos_result);
+
+    cudaCheckError(cudaMemcpy(histos, histos_result, histos_size, cudaMemcpyDeviceToHost));
+
+    cudaCheckError(cudaFree(argb_result));
+    cudaCheckError(cudaFree(histos_result));
+    cudaCheckError(cudaFree(green_to_blue_result));
+    cudaCheckError(cudaFree(red_to_blue_result));
+}
+
+static void CollectColorRedTransformsBatch_CUDA(const uint32_t* argb, int stride,
+                                                int tile_width, int tile_height,
+                                                const int green_to_red[],
+                                                int num_multipliers,
+                                                int histos[][256]) {
+    // Dimensions: one z-slice of blocks per candidate
+    dim3 blockDim(16, 16);
+    dim3 gridDim((tile_width  + blockDim.x - 1) / blockDim.x,
+                 (tile_height + blockDim.y - 1) / blockDim.y,
+                 num_multipliers);
+
+    size_t argb_size = (tile_height - 1) * stride + tile_width;
+    size_t histos_size = num_multipliers * 256 * sizeof(int);
+    size_t mults_size = num_multipliers * sizeof(int);
+
+    uint32_t *argb_result;
+    int *histos_result, *green_to_red_result;
+    cudaCheckError(cudaMalloc(&argb_result, argb_size * sizeof(uint32_t)));
+    cudaCheckError(cudaMalloc(&histos_result, histos_size));
+    cudaCheckError(cudaMalloc(&green_to_red_result, mults_size));
+
+    cudaCheckError(cudaMemcpy(argb_result, argb, argb_size * sizeof(uint32_t), cudaMemcpyHostToDevice));
+    cudaCheckError(cudaMemcpy(histos_result, histos, histos_size, cudaMemcpyHostToDevice));
+    cudaCheckError(cudaMemcpy(green_to_red_result, green_to_red, mults_size, cudaMemcpyHostToDevice));
+
+    CollectColorRedTransformsBatch_kernel<<<gridDim, blockDim>>>(argb_result, stride, tile_width, tile_height, green_to_red_result, histos_result);
+
+    cudaCheckError(cudaMemcpy(histos, histos_result, histos_size, cudaMemcpyDeviceToHost));
+
+    cudaCheckError(cudaFree(argb_result));
+    cudaCheckError(cudaFree(histos_result));
+    cudaCheckError(cudaFree(green_to_red_result));
+}
+
 
 __global__ void VP8LBundleColorMap_kernel(const uint8_t *row, int width, int xbits,
                                           uint32_t *dst) {
@@ -694,6 +816,8 @@ WEBP_TSAN_IGNORE_FUNCTION void VP8LEncDspInitCUDA(void) {
 
     //VP8LTransformColor = TransformColor_CUDA;
     //VP8LCollectColorBlueTransforms = CollectColorBlueTransforms_CUDA;
+    //VP8LCollectColorBlueTransformsBatch = CollectColorBlueTransformsBatch_CUDA;
+    //VP8LCollectColorRedTransformsBatch = CollectColorRedTransformsBatch_CUDA;
     //VP8LBundleColorMap = BundleColorMap_CUDA;
 }
 
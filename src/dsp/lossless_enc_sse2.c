@@ -165,6 +165,109 @@ static void CollectColorRedTransforms_SSE2(const uint32_t* argb, int stride,
     }
   }
 }
+
+static void CollectColorBlueTransformsBatch_SSE2(
+    const uint32_t* argb, int stride, int tile_width, int tile_height,
+    const int green_to_blue[], const int red_to_blue[], int num_multipliers,
+    int histos[][256]) {
+  __m128i mults_r[VP8L_MAX_COLOR_TRANSFORM_BATCH];
+  __m128i mults_g[VP8L_MAX_COLOR_TRANSFORM_BATCH];
+  const __m128i mask_g = _mm_set1_epi32(0x00ff00);  // green mask
+  const __m128i mask_b = _mm_set1_epi32(0x0000ff);  // blue mask
+  int y, k;
+  assert(num_multipliers <= VP8L_MAX_COLOR_TRANSFORM_BATCH);
+  for (k = 0; k < num_multipliers; ++k) {
+    mults_r[k] = MK_CST_16(CST_5b(red_to_blue[k]), 0);
+    mults_g[k] = MK_CST_16(0, CST_5b(green_to_blue[k]));
+  }
+  for (y = 0; y < tile_height; ++y) {
+    const uint32_t* const src = argb + y * stride;
+    int i, x;
+    for (x = 0; x + SPAN <= tile_width; x += SPAN) {
+      const __m128i in0 = _mm_loadu_si128((__m128i*)&src[x +        0]);
+      const __m128i in1 = _mm_loadu_si128((__m128i*)&src[x + SPAN / 2]);
+      const __m128i A0 = _mm_slli_epi16(in0, 8);        // r 0  | b 0
+      const __m128i A1 = _mm_slli_epi16(in1, 8);
+      const __m128i B0 = _mm_and_si128(in0, mask_g);    // 0 0  | g 0
+      const __m128i B1 = _mm_and_si128(in1, mask_g);
+      for (k = 0; k < num_multipliers; ++k) {
+        uint16_t values[SPAN];
+        int* const histo = histos[k];
+        const __m128i C0 = _mm_mulhi_epi16(A0, mults_r[k]);  // x db | 0 0
+        const __m128i C1 = _mm_mulhi_epi16(A1, mults_r[k]);
+        const __m128i D0 = _mm_mulhi_epi16(B0, mults_g[k]);  // 0 0  | x db
+        const __m128i D1 = _mm_mulhi_epi16(B1, mults_g[k]);
+        const __m128i E0 = _mm_sub_epi8(in0, D0);            // x x  | x b'
+        const __m128i E1 = _mm_sub_epi8(in1, D1);
+        const __m128i F0 = _mm_srli_epi32(C0, 16);           // 0 0  | x db
+        const __m128i F1 = _mm_srli_epi32(C1, 16);
+        const __m128i G0 = _mm_sub_epi8(E0, F0);             // 0 0  | x b'
+        const __m128i G1 = _mm_sub_epi8(E1, F1);
+        const __m128i H0 = _mm_and_si128(G0, mask_b);        // 0 0  | 0 b
+        const __m128i H1 = _mm_and_si128(G1, mask_b);
+        const __m128i I = _mm_packs_epi32(H0, H1);           // 0 b' | 0 b'
+        _mm_storeu_si128((__m128i*)values, I);
+        for (i = 0; i < SPAN; ++i) ++histo[values[i]];
+      }
+    }
+  }
+  {
+    const int left_over = tile_width & (SPAN - 1);
+    if (left_over > 0) {
+      VP8LCollectColorBlueTransformsBatch_C(argb + tile_width - left_over,
+                                            stride, left_over, tile_height,
+                                            green_to_blue, red_to_blue,
+                                            num_multipliers, histos);
+    }
+  }
+}
+
+static void CollectColorRedTransformsBatch_SSE2(
+    const uint32_t* argb, int stride, int tile_width, int tile_height,
+    const int green_to_red[], int num_multipliers, int histos[][256]) {
+  __m128i mults_g[VP8L_MAX_COLOR_TRANSFORM_BATCH];
+  const __m128i mask_g = _mm_set1_epi32(0x00ff00);  // green mask
+  const __m128i mask = _mm_set1_epi32(0xff);
+  int y, k;
+  assert(num_multipliers <= VP8L_MAX_COLOR_TRANSFORM_BATCH);
+  for (k = 0; k < num_multipliers; ++k) {
+    mults_g[k] = MK_CST_16(0, CST_5b(green_to_red[k]));
+  }
+  for (y = 0; y < tile_height; ++y) {
+    const uint32_t* const src = argb + y * stride;
+    int i, x;
+    for (x = 0; x + SPAN <= tile_width; x += SPAN) {
+      const __m128i in0 = _mm_loadu_si128((__m128i*)&src[x +        0]);
+      const __m128i in1 = _mm_loadu_si128((__m128i*)&src[x + SPAN / 2]);
+      const __m128i A0 = _mm_and_si128(in0, mask_g);    // 0 0  | g 0
+      const __m128i A1 = _mm_and_si128(in1, mask_g);
+      const __m128i B0 = _mm_srli_epi32(in0, 16);       // 0 0  | x r
+      const __m128i B1 = _mm_srli_epi32(in1, 16);
+      for (k = 0; k < num_multipliers; ++k) {
+        uint16_t values[SPAN];
+        int* const histo = histos[k];
+        const __m128i C0 = _mm_mulhi_epi16(A0, mults_g[k]);  // 0 0  | x dr
+        const __m128i C1 = _mm_mulhi_epi16(A1, mults_g[k]);
+        const __m128i E0 = _mm_sub_epi8(B0, C0);             // x x  | x r'
+        const __m128i E1 = _mm_sub_epi8(B1, C1);
+        const __m128i F0 = _mm_and_si128(E0, mask);          // 0 0  | 0 r'
+        const __m128i F1 = _mm_and_si128(E1, mask);
+        const __m128i I = _mm_packs_epi32(F0, F1);
+        _mm_storeu_si128((__m128i*)values, I);
+        for (i = 0; i < SPAN; ++i) ++histo[values[i]];
+      }
+    }
+  }
+  {
+    const int left_over = tile_width & (SPAN - 1);
+    if (left_over > 0) {
+      VP8LCollectColorRedTransformsBatch_C(argb + tile_width - left_over,
+                                           stride, left_over, tile_height,
+                                           green_to_red, num_multipliers,
+                                           histos);
+    }
+  }
+}
 #undef SPAN
 #undef MK_CST_16
 
@@ -654,6 +757,8 @@ WEBP_TSAN_IGNORE_FUNCTION void VP8LEncDspInitSSE2(void) {
   VP8LTransformColor = TransformColor_SSE2;
   VP8LCollectColorBlueTransforms = CollectColorBlueTransforms_SSE2;
   VP8LCollectColorRedTransforms = CollectColorRedTransforms_SSE2;
+  VP8LCollectColorBlueTransformsBatch = CollectColorBlueTransformsBatch_SSE2;
+  VP8LCollectColorRedTransformsBatch = CollectColorRedTransformsBatch_SSE2;
   VP8LAddVector = AddVector_SSE2;
   VP8LAddVectorEq = AddVectorEq_SSE2;
   VP8LCombinedShannonEntropy = CombinedShannonEntropy_SSE2;
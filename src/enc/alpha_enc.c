@@ -18,6 +18,7 @@
 #include "src/dsp/dsp.h"
 #include "src/utils/filters_utils.h"
 #include "src/utils/quant_levels_utils.h"
+#include "src/utils/trace_utils.h"
 #include "src/utils/utils.h"
 #include "src/webp/format_constants.h"
 
@@ -49,7 +50,8 @@
 static int EncodeLossless(const uint8_t* const data, int width, int height,
                           int effort_level,  // in [0..6] range
                           int use_quality_100, VP8LBitWriter* const bw,
-                          WebPAuxStats* const stats) {
+                          WebPAuxStats* const stats,
+                          WebPCancelToken* const cancel_token) {
   int ok = 0;
   WebPConfig config;
   WebPPicture picture;
@@ -59,6 +61,7 @@ static int EncodeLossless(const uint8_t* const data, int width, int height,
   picture.height = height;
   picture.use_argb = 1;
   picture.stats = stats;
+  picture.cancel_token = cancel_token;
   if (!WebPPictureAlloc(&picture)) return 0;
 
   // Transfer the alpha values to the green channel.
@@ -110,7 +113,8 @@ static int EncodeAlphaInternal(const uint8_t* const data, int width, int height,
                                int method, int filter, int reduce_levels,
                                int effort_level,  // in [0..6] range
                                uint8_t* const tmp_alpha,
-                               FilterTrial* result) {
+                               FilterTrial* result,
+                               WebPCancelToken* const cancel_token) {
   int ok = 0;
   const uint8_t* alpha_src;
   WebPFilterFunc filter_func;
@@ -137,7 +141,8 @@ static int EncodeAlphaInternal(const uint8_t* const data, int width, int height,
   if (method != ALPHA_NO_COMPRESSION) {
     ok = VP8LBitWriterInit(&tmp_bw, data_size >> 3);
     ok = ok && EncodeLossless(alpha_src, width, height, effort_level,
-                              !reduce_levels, &tmp_bw, &result->stats);
+                              !reduce_levels, &tmp_bw, &result->stats,
+                              cancel_token);
     if (ok) {
       output = VP8LBitWriterFinish(&tmp_bw);
       output_size = VP8LBitWriterNumBytes(&tmp_bw);
@@ -236,7 +241,8 @@ static int ApplyFiltersAndEncode(const uint8_t* alpha, int width, int height,
                                  int reduce_levels, int effort_level,
                                  uint8_t** const output,
                                  size_t* const output_size,
-                                 WebPAuxStats* const stats) {
+                                 WebPAuxStats* const stats,
+                                 WebPCancelToken* const cancel_token) {
   int ok = 1;
   FilterTrial best;
   uint32_t try_map =
@@ -252,7 +258,7 @@ static int ApplyFiltersAndEncode(const uint8_t* alpha, int width, int height,
         FilterTrial trial;
         ok = EncodeAlphaInternal(alpha, width, height, method, filter,
                                  reduce_levels, effort_level, filtered_alpha,
-                                 &trial);
+                                 &trial, cancel_token);
         if (ok && trial.score < best.score) {
           VP8BitWriterWipeOut(&best.bw);
           best = trial;
@@ -264,7 +270,8 @@ static int ApplyFiltersAndEncode(const uint8_t* alpha, int width, int height,
     WebPSafeFree(filtered_alpha);
   } else {
     ok = EncodeAlphaInternal(alpha, width, height, method, WEBP_FILTER_NONE,
-                             reduce_levels, effort_level, NULL, &best);
+                             reduce_levels, effort_level, NULL, &best,
+                             cancel_token);
   }
   if (ok) {
 #if !defined(WEBP_DISABLE_STATS)
@@ -305,10 +312,11 @@ static int EncodeAlpha(VP8Encoder* const enc,
 
   // quick sanity checks
   assert((uint64_t)data_size == (uint64_t)width * height);  // as per spec
-  assert(enc != NULL && pic != NULL && pic->a != NULL);
+  assert(enc != NULL && pic != NULL);
+  assert(pic->a != NULL || enc->rows_ != NULL);
   assert(output != NULL && output_size != NULL);
   assert(width > 0 && height > 0);
-  assert(pic->a_stride >= width);
+  assert(enc->rows_ != NULL || pic->a_stride >= width);
   assert(filter >= WEBP_FILTER_NONE && filter <= WEBP_FILTER_FAST);
 
   if (quality < 0 || quality > 100) {
@@ -330,7 +338,16 @@ static int EncodeAlpha(VP8Encoder* const enc,
   }
 
   // Extract alpha data (width x height) from raw_data (stride x height).
-  WebPCopyPlane(pic->a, pic->a_stride, quant_alpha, width, width, height);
+  if (enc->rows_ != NULL) {   // no alpha plane, samples are still in ARGB
+    int x, y;
+    for (y = 0; y < height; ++y) {
+      const uint32_t* const argb = pic->argb + y * pic->argb_stride;
+      uint8_t* const dst = quant_alpha + y * width;
+      for (x = 0; x < width; ++x) dst[x] = argb[x] >> 24;
+    }
+  } else {
+    WebPCopyPlane(pic->a, pic->a_stride, quant_alpha, width, width, height);
+  }
 
   if (reduce_levels) {  // No Quantization required for 'quality = 100'.
     // 16 alpha levels gives quite a low MSE w.r.t original alpha plane hence
@@ -345,7 +362,7 @@ static int EncodeAlpha(VP8Encoder* const enc,
     VP8FiltersInit();
     ok = ApplyFiltersAndEncode(quant_alpha, width, height, data_size, method,
                                filter, reduce_levels, effort_level, output,
-                               output_size, pic->stats);
+                               output_size, pic->stats, pic->cancel_token);
 #if !defined(WEBP_DISABLE_STATS)
     if (pic->stats != NULL) {  // need stats?
       pic->stats->coded_size += (int)(*output_size);
@@ -371,10 +388,12 @@ static int CompressAlphaJob(void* arg1, void* dummy) {
       (config->alpha_filtering == 0) ? WEBP_FILTER_NONE :
       (config->alpha_filtering == 1) ? WEBP_FILTER_FAST :
                                        WEBP_FILTER_BEST;
-  if (!EncodeAlpha(enc, config->alpha_quality, config->alpha_compression,
-                   filter, effort_level, &alpha_data, &alpha_size)) {
-    return 0;
-  }
+  int ok;
+  WEBP_TRACE_BEGIN("EncodeAlpha");
+  ok = EncodeAlpha(enc, config->alpha_quality, config->alpha_compression,
+                   filter, effort_level, &alpha_data, &alpha_size);
+  WEBP_TRACE_END("EncodeAlpha");
+  if (!ok) return 0;
   if (alpha_size != (uint32_t)alpha_size) {  // Sanity check.
     WebPSafeFree(alpha_data);
     return 0;
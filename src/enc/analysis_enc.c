@@ -430,6 +430,7 @@ typedef struct {
   int alphas[MAX_ALPHA + 1];
   int alpha, uv_alpha;
   VP8EncIterator it;
+  VP8RowWindow rows;   // private row window, if the encoder uses one
   int delta_progress;
 } SegmentJob;
 
@@ -503,6 +504,14 @@ int VP8EncAnalyze(VP8Encoder* const enc) {
       // no matter what.
       InitSegmentJob(enc, &main_job, 0, split_row);
       InitSegmentJob(enc, &side_job, split_row, last_row);
+      if (enc->rows_ != NULL) {
+        // the side job can't share the encoder's row window
+        if (!VP8RowWindowInit(&side_job.rows, enc->pic_, enc->has_alpha_,
+                              enc->config_->exact)) {
+          ok = WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+        }
+        side_job.it.rows_ = &side_job.rows;
+      }
       // we don't need to call Reset() on main_job.worker, since we're calling
       // WebPWorkerExecute() on it
       ok &= worker_interface->Reset(&side_job.worker);
@@ -514,6 +523,7 @@ int VP8EncAnalyze(VP8Encoder* const enc) {
         ok &= worker_interface->Sync(&main_job.worker);
       }
       worker_interface->End(&side_job.worker);
+      if (enc->rows_ != NULL) VP8RowWindowClear(&side_job.rows);
       if (ok) MergeJobs(&side_job, &main_job);  // merge results together
     } else {
       // Even for single-thread case, we use the generic Worker tools.
@@ -18,6 +18,7 @@
 
 #include "src/enc/backward_references_enc.h"
 #include "src/enc/histogram_enc.h"
+#include "src/enc/vp8i_enc.h"
 #include "src/dsp/lossless_common.h"
 #include "src/utils/color_cache_utils.h"
 #include "src/utils/utils.h"
@@ -563,8 +564,9 @@ static WEBP_INLINE void PushInterval(CostManager* const manager,
 static int BackwardReferencesHashChainDistanceOnly(
     int xsize, int ysize, const uint32_t* const argb, int cache_bits,
     const VP8LHashChain* const hash_chain, const VP8LBackwardRefs* const refs,
-    uint16_t* const dist_array) {
+    uint16_t* const dist_array, const WebPPicture* const pic) {
   int i;
+  uint32_t num_iters = 0;
   int ok = 0;
   int cc_init = 0;
   const int pix_count = xsize * ysize;
@@ -609,6 +611,10 @@ static int BackwardReferencesHashChainDistanceOnly(
   for (i = 1; i < pix_count; ++i) {
     const float prev_cost = cost_manager->costs_[i - 1];
     int offset, len;
+    if ((++num_iters & VP8L_CANCEL_POLL_MASK) == 0 &&
+        WebPEncodingIsCancelled(pic)) {
+      goto Error;
+    }
     VP8LHashChainFindCopy(hash_chain, i, &offset, &len);
 
     // Try adding the pixel as a literal.
@@ -757,13 +763,15 @@ static int BackwardReferencesHashChainFollowChosenPath(
 extern int VP8LBackwardReferencesTraceBackwards(
     int xsize, int ysize, const uint32_t* const argb, int cache_bits,
     const VP8LHashChain* const hash_chain,
-    const VP8LBackwardRefs* const refs_src, VP8LBackwardRefs* const refs_dst);
+    const VP8LBackwardRefs* const refs_src, VP8LBackwardRefs* const refs_dst,
+    const WebPPicture* const pic);
 int VP8LBackwardReferencesTraceBackwards(int xsize, int ysize,
                                          const uint32_t* const argb,
                                          int cache_bits,
                                          const VP8LHashChain* const hash_chain,
                                          const VP8LBackwardRefs* const refs_src,
-                                         VP8LBackwardRefs* const refs_dst) {
+                                         VP8LBackwardRefs* const refs_dst,
+                                         const WebPPicture* const pic) {
   int ok = 0;
   const int dist_array_size = xsize * ysize;
   uint16_t* chosen_path = NULL;
@@ -774,7 +782,8 @@ int VP8LBackwardReferencesTraceBackwards(int xsize, int ysize,
   if (dist_array == NULL) goto Error;
 
   if (!BackwardReferencesHashChainDistanceOnly(
-          xsize, ysize, argb, cache_bits, hash_chain, refs_src, dist_array)) {
+          xsize, ysize, argb, cache_bits, hash_chain, refs_src, dist_array,
+          pic)) {
     goto Error;
   }
   TraceBackwards(dist_array, dist_array_size, &chosen_path, &chosen_path_size);
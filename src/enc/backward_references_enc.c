@@ -15,6 +15,7 @@
 
 #include "src/enc/backward_references_enc.h"
 #include "src/enc/histogram_enc.h"
+#include "src/enc/vp8i_enc.h"
 #include "src/dsp/lossless.h"
 #include "src/dsp/lossless_common.h"
 #include "src/dsp/dsp.h"
@@ -224,13 +225,14 @@ static WEBP_INLINE int MaxFindCopyLength(int len) {
 
 int VP8LHashChainFill(VP8LHashChain* const p, int quality,
                       const uint32_t* const argb, int xsize, int ysize,
-                      int low_effort) {
+                      int low_effort, const WebPPicture* const pic) {
   const int size = xsize * ysize;
   const int iter_max = GetMaxItersForQuality(quality);
   const uint32_t window_size = GetWindowSizeForHashChain(quality, xsize);
   int pos;
   int argb_comp;
   uint32_t base_position;
+  uint32_t num_iters = 0;
   int32_t* hash_to_first_index;
   // Temporarily use the p->offset_length_ as a hash chain.
   int32_t* chain = (int32_t*)p->offset_length_;
@@ -316,6 +318,10 @@ int VP8LHashChainFill(VP8LHashChain* const p, int quality,
     const int length_max = (max_len < 256) ? max_len : 256;
     uint32_t max_base_position;
 
+    if ((++num_iters & VP8L_CANCEL_POLL_MASK) == 0 &&
+        WebPEncodingIsCancelled(pic)) {
+      return 0;
+    }
     pos = chain[base_position];
     if (!low_effort) {
       int curr_length;
@@ -390,6 +396,40 @@ int VP8LHashChainFill(VP8LHashChain* const p, int quality,
   return 1;
 }
 
+int VP8LHashChainFillRows(VP8LHashChain* const p, int quality,
+                          const uint32_t* const argb, int xsize,
+                          int first_row, int last_row, int overlap_rows,
+                          int low_effort, const WebPPicture* const pic) {
+  const int start_row =
+      (first_row > overlap_rows) ? first_row - overlap_rows : 0;
+  const int skip = (first_row - start_row) * xsize;
+  VP8LHashChain band;
+  int ok;
+  assert(first_row < last_row);
+  assert(p->size_ >= last_row * xsize);
+
+  if (skip == 0) {
+    // Fill the rows in place.
+    band.offset_length_ = p->offset_length_ + first_row * xsize;
+    band.size_ = (last_row - first_row) * xsize;
+    return VP8LHashChainFill(&band, quality, argb + first_row * xsize, xsize,
+                             last_row - first_row, low_effort, pic);
+  }
+  // The chain is temporarily stored in the entries of the overlapping rows,
+  // which belong to another band: use a private one.
+  band.offset_length_ = NULL;
+  band.size_ = 0;
+  if (!VP8LHashChainInit(&band, (last_row - start_row) * xsize)) return 0;
+  ok = VP8LHashChainFill(&band, quality, argb + start_row * xsize, xsize,
+                         last_row - start_row, low_effort, pic);
+  if (ok) {
+    memcpy(p->offset_length_ + first_row * xsize, band.offset_length_ + skip,
+           (band.size_ - skip) * sizeof(*p->offset_length_));
+  }
+  VP8LHashChainClear(&band);
+  return ok;
+}
+
 static WEBP_INLINE void AddSingleLiteral(uint32_t pixel, int use_color_cache,
                                          VP8LColorCache* const hashers,
                                          VP8LBackwardRefs* const refs) {
@@ -841,12 +881,13 @@ static VP8LBackwardRefs* GetBackwardReferencesLowEffort(
 extern int VP8LBackwardReferencesTraceBackwards(
     int xsize, int ysize, const uint32_t* const argb, int cache_bits,
     const VP8LHashChain* const hash_chain,
-    const VP8LBackwardRefs* const refs_src, VP8LBackwardRefs* const refs_dst);
+    const VP8LBackwardRefs* const refs_src, VP8LBackwardRefs* const refs_dst,
+    const WebPPicture* const pic);
 static VP8LBackwardRefs* GetBackwardReferences(
     int width, int height, const uint32_t* const argb, int quality,
     int lz77_types_to_try, int* const cache_bits,
     const VP8LHashChain* const hash_chain, VP8LBackwardRefs* best,
-    VP8LBackwardRefs* worst) {
+    VP8LBackwardRefs* worst, const WebPPicture* const pic) {
   const int cache_bits_initial = *cache_bits;
   double bit_cost_best = -1;
   VP8LHistogram* histo = NULL;
@@ -913,11 +954,15 @@ static VP8LBackwardRefs* GetBackwardReferences(
     const VP8LHashChain* const hash_chain_tmp =
         (lz77_type_best == kLZ77Standard) ? hash_chain : &hash_chain_box;
     if (VP8LBackwardReferencesTraceBackwards(width, height, argb, *cache_bits,
-                                             hash_chain_tmp, best, worst)) {
+                                             hash_chain_tmp, best, worst,
+                                             pic)) {
       double bit_cost_trace;
       VP8LHistogramCreate(histo, worst, *cache_bits);
       bit_cost_trace = VP8LHistogramEstimateBits(histo);
       if (bit_cost_trace < bit_cost_best) best = worst;
+    } else if (WebPEncodingIsCancelled(pic)) {
+      best = NULL;
+      goto Error;
     }
   }
 
@@ -933,13 +978,13 @@ VP8LBackwardRefs* VP8LGetBackwardReferences(
     int width, int height, const uint32_t* const argb, int quality,
     int low_effort, int lz77_types_to_try, int* const cache_bits,
     const VP8LHashChain* const hash_chain, VP8LBackwardRefs* const refs_tmp1,
-    VP8LBackwardRefs* const refs_tmp2) {
+    VP8LBackwardRefs* const refs_tmp2, const WebPPicture* const pic) {
   if (low_effort) {
     return GetBackwardReferencesLowEffort(width, height, argb, cache_bits,
                                           hash_chain, refs_tmp1);
   } else {
     return GetBackwardReferences(width, height, argb, quality,
                                  lz77_types_to_try, cache_bits, hash_chain,
-                                 refs_tmp1, refs_tmp2);
+                                 refs_tmp1, refs_tmp2, pic);
   }
 }
@@ -16,6 +16,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include "src/webp/types.h"
+#include "src/webp/encode.h"
 #include "src/webp/format_constants.h"
 
 #ifdef __cplusplus
@@ -25,6 +26,10 @@ extern "C" {
 // The maximum allowed limit is 11.
 #define MAX_COLOR_CACHE_BITS 10
 
+// The per-pixel loops poll the picture's cancellation once every
+// (VP8L_CANCEL_POLL_MASK + 1) iterations.
+#define VP8L_CANCEL_POLL_MASK 0xfff
+
 // -----------------------------------------------------------------------------
 // PixOrCopy
 
@@ -134,9 +139,19 @@ struct VP8LHashChain {
 // Must be called first, to set size.
 int VP8LHashChainInit(VP8LHashChain* const p, int size);
 // Pre-compute the best matches for argb.
+// Returns false in case of memory error or if the encoding of 'pic' has been
+// cancelled.
 int VP8LHashChainFill(VP8LHashChain* const p, int quality,
                       const uint32_t* const argb, int xsize, int ysize,
-                      int low_effort);
+                      int low_effort, const WebPPicture* const pic);
+// Same as VP8LHashChainFill() for the rows [first_row, last_row) of the image
+// only, which must have been fully allocated in 'p'. The matches are searched
+// in these rows and the 'overlap_rows' rows above them, and no other entry of
+// 'p' is accessed, so that disjoint bands can be filled concurrently.
+int VP8LHashChainFillRows(VP8LHashChain* const p, int quality,
+                          const uint32_t* const argb, int xsize,
+                          int first_row, int last_row, int overlap_rows,
+                          int low_effort, const WebPPicture* const pic);
 void VP8LHashChainClear(VP8LHashChain* const p);  // release memory
 
 static WEBP_INLINE int VP8LHashChainFindOffset(const VP8LHashChain* const p,
@@ -220,12 +235,12 @@ enum VP8LLZ77Type {
 // bits to use (passing 0 implies disabling the local color cache).
 // The optimal cache bits is evaluated and set for the *cache_bits parameter.
 // The return value is the pointer to the best of the two backward refs viz,
-// refs[0] or refs[1].
+// refs[0] or refs[1], or NULL in case of error or cancellation of 'pic'.
 VP8LBackwardRefs* VP8LGetBackwardReferences(
     int width, int height, const uint32_t* const argb, int quality,
     int low_effort, int lz77_types_to_try, int* const cache_bits,
     const VP8LHashChain* const hash_chain, VP8LBackwardRefs* const refs_tmp1,
-    VP8LBackwardRefs* const refs_tmp2);
+    VP8LBackwardRefs* const refs_tmp2, const WebPPicture* const pic);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,364 @@
+// Copyright 2019 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// WebP encoder: cache of previously produced bitstreams, keyed by a hash
+// of the input samples and of the encoding parameters.
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "src/enc/vp8i_enc.h"
+#include "src/utils/utils.h"
+#include "src/webp/encode.h"
+
+//------------------------------------------------------------------------------
+// Hashing
+
+// Two independent 64-bit lanes, giving WEBP_ENCODE_CACHE_KEY_SIZE bytes.
+typedef struct {
+  uint64_t h0_, h1_;
+} CacheHasher;
+
+#define CACHE_MUL0 (((uint64_t)0x9e3779b9u << 32) | 0x7f4a7c15u)
+#define CACHE_MUL1 (((uint64_t)0xc2b2ae3du << 32) | 0x27d4eb4fu)
+#define CACHE_MIX  (((uint64_t)0xff51afd7u << 32) | 0xed558ccdu)
+
+static void HasherInit(CacheHasher* const h) {
+  h->h0_ = CACHE_MUL1;
+  h->h1_ = CACHE_MUL0;
+}
+
+static WEBP_INLINE void HashWord(CacheHasher* const h, uint64_t w) {
+  h->h0_ = (h->h0_ ^ w) * CACHE_MUL0;
+  h->h0_ = (h->h0_ << 31) | (h->h0_ >> 33);
+  h->h1_ = (h->h1_ + w) * CACHE_MUL1;
+  h->h1_ ^= h->h1_ >> 29;
+}
+
+static void HashBytes(CacheHasher* const h, const uint8_t* data, size_t size) {
+  uint64_t w;
+  while (size >= sizeof(w)) {
+    memcpy(&w, data, sizeof(w));
+    HashWord(h, w);
+    data += sizeof(w);
+    size -= sizeof(w);
+  }
+  if (size > 0) {
+    w = 0;
+    memcpy(&w, data, size);
+    HashWord(h, w ^ ((uint64_t)size << 56));
+  }
+}
+
+static void HashPlane(CacheHasher* const h, const uint8_t* plane, int stride,
+                      size_t row_size, int num_rows) {
+  int y;
+  for (y = 0; y < num_rows; ++y) {
+    HashBytes(h, plane, row_size);
+    plane += stride;
+  }
+}
+
+static uint64_t Finalize(uint64_t h) {
+  h ^= h >> 33;
+  h *= CACHE_MIX;
+  h ^= h >> 33;
+  return h;
+}
+
+// Returns true if the encoder will read its samples from the ARGB plane
+// (mirrors the conversion logic of WebPEncode()).
+static int UsesARGBSamples(const WebPConfig* const config,
+                           const WebPPicture* const pic) {
+  if (config->lossless) return (pic->argb != NULL);
+  return (pic->use_argb || pic->y == NULL || pic->u == NULL || pic->v == NULL);
+}
+
+// Computes the cache key for encoding 'pic' with 'config'. Returns false if
+// the picture has no usable samples (the encoder will report the error).
+static int GetCacheKey(const WebPConfig* const config,
+                       const WebPPicture* const pic, uint8_t* const key) {
+  const int use_argb = UsesARGBSamples(config, pic);
+  const int width = pic->width, height = pic->height;
+  CacheHasher h;
+  int i;
+
+  if (width <= 0 || height <= 0) return 0;
+  HasherInit(&h);
+  HashWord(&h, (uint64_t)WebPGetEncoderVersion());
+  HashWord(&h, ((uint64_t)width << 32) | (uint64_t)height);
+  HashBytes(&h, (const uint8_t*)config, offsetof(WebPConfig, pad));
+  if (use_argb) {
+    if (pic->argb == NULL) return 0;
+    HashWord(&h, 1);
+    HashPlane(&h, (const uint8_t*)pic->argb,
+              pic->argb_stride * (int)sizeof(*pic->argb),
+              (size_t)width * sizeof(*pic->argb), height);
+  } else {
+    const int uv_width = (width + 1) >> 1;
+    const int uv_height = (height + 1) >> 1;
+    const int has_alpha = (pic->colorspace & WEBP_CSP_ALPHA_BIT) &&
+                          (pic->a != NULL);
+    HashWord(&h, ((uint64_t)pic->colorspace << 8) | (uint64_t)has_alpha << 1);
+    HashPlane(&h, pic->y, pic->y_stride, width, height);
+    HashPlane(&h, pic->u, pic->uv_stride, uv_width, uv_height);
+    HashPlane(&h, pic->v, pic->uv_stride, uv_width, uv_height);
+    if (has_alpha) HashPlane(&h, pic->a, pic->a_stride, width, height);
+  }
+  h.h0_ = Finalize(h.h0_);
+  h.h1_ = Finalize(h.h1_);
+  for (i = 0; i < 8; ++i) {
+    key[i] = (uint8_t)(h.h0_ >> (8 * i));
+    key[8 + i] = (uint8_t)(h.h1_ >> (8 * i));
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Default in-memory storage, with least-recently-used eviction.
+
+#define CACHE_NUM_BUCKETS_BITS 10
+#define CACHE_NUM_BUCKETS (1 << CACHE_NUM_BUCKETS_BITS)
+
+typedef struct CacheEntry CacheEntry;
+struct CacheEntry {
+  uint8_t key_[WEBP_ENCODE_CACHE_KEY_SIZE];
+  uint8_t* data_;
+  size_t size_;
+  CacheEntry* prev_;    // more recently used entry
+  CacheEntry* next_;    // less recently used entry
+  CacheEntry* chain_;   // next entry in the same bucket
+};
+
+typedef struct {
+  CacheEntry* buckets_[CACHE_NUM_BUCKETS];
+  CacheEntry* head_;    // most recently used
+  CacheEntry* tail_;    // least recently used
+  size_t size_;         // total size of the stored bitstreams
+  size_t max_size_;
+} MemoryStorage;
+
+static CacheEntry** GetBucket(MemoryStorage* const s, const uint8_t* key) {
+  const uint32_t idx = (uint32_t)key[0] | ((uint32_t)key[1] << 8);
+  return &s->buckets_[idx & (CACHE_NUM_BUCKETS - 1)];
+}
+
+static void ListUnlink(MemoryStorage* const s, CacheEntry* const e) {
+  if (e->prev_ != NULL) e->prev_->next_ = e->next_; else s->head_ = e->next_;
+  if (e->next_ != NULL) e->next_->prev_ = e->prev_; else s->tail_ = e->prev_;
+  e->prev_ = e->next_ = NULL;
+}
+
+static void ListPushFront(MemoryStorage* const s, CacheEntry* const e) {
+  e->prev_ = NULL;
+  e->next_ = s->head_;
+  if (s->head_ != NULL) s->head_->prev_ = e; else s->tail_ = e;
+  s->head_ = e;
+}
+
+static void RemoveEntry(MemoryStorage* const s, CacheEntry* const e) {
+  CacheEntry** link = GetBucket(s, e->key_);
+  while (*link != e) link = &(*link)->chain_;
+  *link = e->chain_;
+  ListUnlink(s, e);
+  assert(s->size_ >= e->size_);
+  s->size_ -= e->size_;
+  WebPSafeFree(e->data_);
+  WebPSafeFree(e);
+}
+
+static CacheEntry* FindEntry(MemoryStorage* const s, const uint8_t* key) {
+  CacheEntry* e = *GetBucket(s, key);
+  while (e != NULL && memcmp(e->key_, key, WEBP_ENCODE_CACHE_KEY_SIZE)) {
+    e = e->chain_;
+  }
+  return e;
+}
+
+static const uint8_t* MemoryLookup(void* opaque, const uint8_t* key,
+                                   size_t* data_size) {
+  MemoryStorage* const s = (MemoryStorage*)opaque;
+  CacheEntry* const e = FindEntry(s, key);
+  if (e == NULL) return NULL;
+  ListUnlink(s, e);
+  ListPushFront(s, e);
+  *data_size = e->size_;
+  return e->data_;
+}
+
+static int MemoryStore(void* opaque, const uint8_t* key,
+                       const uint8_t* data, size_t data_size) {
+  MemoryStorage* const s = (MemoryStorage*)opaque;
+  CacheEntry* e = FindEntry(s, key);
+  CacheEntry** bucket;
+  if (e != NULL) RemoveEntry(s, e);
+  if (data_size > s->max_size_) return 1;   // too big to be kept, not an error
+  while (s->size_ + data_size > s->max_size_) RemoveEntry(s, s->tail_);
+
+  e = (CacheEntry*)WebPSafeCalloc(1ULL, sizeof(*e));
+  if (e == NULL) return 0;
+  e->data_ = (uint8_t*)WebPSafeMalloc(1ULL, data_size);
+  if (e->data_ == NULL) {
+    WebPSafeFree(e);
+    return 0;
+  }
+  memcpy(e->data_, data, data_size);
+  memcpy(e->key_, key, WEBP_ENCODE_CACHE_KEY_SIZE);
+  e->size_ = data_size;
+  bucket = GetBucket(s, key);
+  e->chain_ = *bucket;
+  *bucket = e;
+  ListPushFront(s, e);
+  s->size_ += data_size;
+  return 1;
+}
+
+static void MemoryRelease(void* opaque) {
+  MemoryStorage* const s = (MemoryStorage*)opaque;
+  if (s == NULL) return;
+  while (s->tail_ != NULL) RemoveEntry(s, s->tail_);
+  WebPSafeFree(s);
+}
+
+//------------------------------------------------------------------------------
+// Cache object
+
+struct WebPEncodeCache {
+  WebPEncodeCacheStorage storage_;
+  WebPEncodeCacheStats stats_;
+};
+
+WebPEncodeCache* WebPEncodeCacheNew(size_t max_bytes) {
+  WebPEncodeCacheStorage storage;
+  WebPEncodeCache* cache;
+  MemoryStorage* const s = (MemoryStorage*)WebPSafeCalloc(1ULL, sizeof(*s));
+  if (s == NULL) return NULL;
+  s->max_size_ = max_bytes;
+  storage.lookup = MemoryLookup;
+  storage.store = MemoryStore;
+  storage.release = MemoryRelease;
+  storage.opaque = s;
+  cache = WebPEncodeCacheNewWithStorage(&storage);
+  if (cache == NULL) MemoryRelease(s);
+  return cache;
+}
+
+WebPEncodeCache* WebPEncodeCacheNewWithStorage(
+    const WebPEncodeCacheStorage* storage) {
+  WebPEncodeCache* cache;
+  if (storage == NULL || storage->lookup == NULL || storage->store == NULL) {
+    return NULL;
+  }
+  cache = (WebPEncodeCache*)WebPSafeCalloc(1ULL, sizeof(*cache));
+  if (cache == NULL) return NULL;
+  cache->storage_ = *storage;
+  return cache;
+}
+
+void WebPEncodeCacheDelete(WebPEncodeCache* cache) {
+  if (cache == NULL) return;
+  if (cache->storage_.release != NULL) {
+    cache->storage_.release(cache->storage_.opaque);
+  }
+  WebPSafeFree(cache);
+}
+
+void WebPEncodeCacheGetStats(const WebPEncodeCache* cache,
+                             WebPEncodeCacheStats* stats) {
+  if (stats == NULL) return;
+  if (cache == NULL) {
+    memset(stats, 0, sizeof(*stats));
+  } else {
+    *stats = cache->stats_;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Encoding
+
+// Writer forwarding the bitstream to the user's writer while keeping a copy.
+typedef struct {
+  WebPWriterFunction writer_;   // user's writer (can be NULL)
+  void* custom_ptr_;            // user's custom_ptr
+  WebPMemoryWriter copy_;
+  int copy_error_;              // true if 'copy_' could not be grown
+} CacheWriter;
+
+static int CacheWriterWrite(const uint8_t* data, size_t data_size,
+                            const WebPPicture* picture) {
+  WebPPicture* const pic = (WebPPicture*)picture;
+  CacheWriter* const cw = (CacheWriter*)pic->custom_ptr;
+  int ok = 1;
+  pic->writer = cw->writer_;
+  pic->custom_ptr = cw->custom_ptr_;
+  if (cw->writer_ != NULL) ok = cw->writer_(data, data_size, pic);
+  if (ok && !cw->copy_error_) {
+    pic->custom_ptr = &cw->copy_;
+    cw->copy_error_ = !WebPMemoryWrite(data, data_size, pic);
+  }
+  pic->writer = CacheWriterWrite;
+  pic->custom_ptr = cw;
+  return ok;
+}
+
+int WebPEncodeCached(const WebPConfig* config, WebPPicture* pic,
+                     WebPEncodeCache* cache) {
+  uint8_t key[WEBP_ENCODE_CACHE_KEY_SIZE];
+  CacheWriter cw;
+  int ok;
+
+  if (cache == NULL) return WebPEncode(config, pic);
+  if (pic == NULL || config == NULL || !WebPValidateConfig(config) ||
+      pic->extra_info != NULL || !GetCacheKey(config, pic, key)) {
+    ++cache->stats_.bypassed;
+    return WebPEncode(config, pic);
+  }
+
+  {
+    WebPEncodeCacheStorage* const storage = &cache->storage_;
+    size_t data_size = 0;
+    const uint8_t* const data = storage->lookup(storage->opaque, key,
+                                                &data_size);
+    if (data != NULL) {
+      int percent = 0;
+      ++cache->stats_.hits;
+      cache->stats_.bytes_served += data_size;
+      WebPEncodingSetError(pic, VP8_ENC_OK);
+      if (pic->stats != NULL) {
+        memset(pic->stats, 0, sizeof(*pic->stats));
+        pic->stats->coded_size = (int)data_size;
+      }
+      if (pic->writer != NULL && !pic->writer(data, data_size, pic)) {
+        return WebPEncodingSetError(pic, VP8_ENC_ERROR_BAD_WRITE);
+      }
+      return WebPReportProgress(pic, 100, &percent);
+    }
+  }
+
+  ++cache->stats_.misses;
+  cw.writer_ = pic->writer;
+  cw.custom_ptr_ = pic->custom_ptr;
+  cw.copy_error_ = 0;
+  WebPMemoryWriterInit(&cw.copy_);
+  pic->writer = CacheWriterWrite;
+  pic->custom_ptr = &cw;
+  ok = WebPEncode(config, pic);
+  pic->writer = cw.writer_;
+  pic->custom_ptr = cw.custom_ptr_;
+  if (ok) {
+    if (cw.copy_error_ ||
+        !cache->storage_.store(cache->storage_.opaque, key,
+                               cw.copy_.mem, cw.copy_.size)) {
+      ++cache->stats_.store_errors;
+    }
+  }
+  WebPMemoryWriterClear(&cw.copy_);
+  return ok;
+}
@@ -0,0 +1,121 @@
+// Copyright 2019 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// WebP encoder: cancellation tokens, polled during the encoding.
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <time.h>
+#endif
+
+#include "src/enc/vp8i_enc.h"
+#include "src/utils/utils.h"
+#include "src/webp/encode.h"
+
+struct WebPCancelToken {
+  volatile int cancelled_;   // set by WebPCancelTokenCancel() or on deadline
+  double deadline_;          // in milliseconds, 0 if there is no deadline
+  WebPCancelToken* parent_;  // if not NULL, cancels this token too
+  volatile size_t size_limit_;   // see WebPEncodingCheckSize(), 0 if none
+};
+
+//------------------------------------------------------------------------------
+// Clock
+
+// Returns a monotonic time in milliseconds, with an arbitrary origin.
+static double GetTimeMs(void) {
+#if defined(_WIN32)
+  LARGE_INTEGER freq, now;
+  if (QueryPerformanceFrequency(&freq) && QueryPerformanceCounter(&now)) {
+    return 1000. * (double)now.QuadPart / (double)freq.QuadPart;
+  }
+  return (double)GetTickCount();
+#elif defined(CLOCK_MONOTONIC)
+  struct timespec now;
+  if (clock_gettime(CLOCK_MONOTONIC, &now) == 0) {
+    return 1000. * now.tv_sec + now.tv_nsec / 1000000.;
+  }
+  return 0.;
+#else
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return 1000. * now.tv_sec + now.tv_usec / 1000.;
+#endif
+}
+
+//------------------------------------------------------------------------------
+
+WebPCancelToken* WebPCancelTokenNew(void) {
+  return (WebPCancelToken*)WebPSafeCalloc(1ULL, sizeof(WebPCancelToken));
+}
+
+void WebPCancelTokenDelete(WebPCancelToken* token) {
+  WebPSafeFree(token);
+}
+
+void WebPCancelTokenCancel(WebPCancelToken* token) {
+  if (token != NULL) token->cancelled_ = 1;
+}
+
+void WebPCancelTokenSetTimeout(WebPCancelToken* token, int timeout_ms) {
+  if (token == NULL) return;
+  token->deadline_ = (timeout_ms > 0) ? GetTimeMs() + timeout_ms : 0.;
+}
+
+int WebPCancelTokenIsCancelled(WebPCancelToken* token) {
+  if (token == NULL) return 0;
+  if (token->cancelled_) return 1;
+  if (WebPCancelTokenIsCancelled(token->parent_)) return 1;
+  if (token->deadline_ > 0. && GetTimeMs() >= token->deadline_) {
+    token->cancelled_ = 1;   // no need to query the clock anymore
+    return 1;
+  }
+  return 0;
+}
+
+void WebPCancelTokenReset(WebPCancelToken* token) {
+  if (token == NULL) return;
+  token->cancelled_ = 0;
+  token->deadline_ = 0.;
+  token->size_limit_ = 0;
+}
+
+WebPCancelToken* WebPCancelTokenNewChild(WebPCancelToken* const parent) {
+  WebPCancelToken* const token = WebPCancelTokenNew();
+  if (token != NULL) token->parent_ = parent;
+  return token;
+}
+
+void WebPCancelTokenSetSizeLimit(WebPCancelToken* const token, size_t size) {
+  if (token != NULL) token->size_limit_ = size;
+}
+
+//------------------------------------------------------------------------------
+
+int WebPEncodingIsCancelled(const WebPPicture* const pic) {
+  return (pic->cancel_token != NULL &&
+          WebPCancelTokenIsCancelled(pic->cancel_token));
+}
+
+size_t WebPEncodingSizeLimit(const WebPPicture* const pic) {
+  return (pic->cancel_token != NULL) ? pic->cancel_token->size_limit_ : 0;
+}
+
+int WebPEncodingCheckSize(const WebPPicture* const pic, size_t size) {
+  const size_t limit = WebPEncodingSizeLimit(pic);
+  if (limit > 0 && size > limit) {
+    WebPCancelTokenCancel(pic->cancel_token);
+    return 0;
+  }
+  return 1;
+}
@@ -55,6 +55,7 @@ int WebPConfigInitInternal(WebPConfig* config,
   config->near_lossless = 100;
   config->use_delta_palette = 0;
   config->use_sharp_yuv = 0;
+  config->keep_smaller = 0;
 
   // TODO(skal): tune.
   switch (preset) {
@@ -117,13 +118,15 @@ int WebPValidateConfig(const WebPConfig* config) {
   if (config->near_lossless < 0 || config->near_lossless > 100) return 0;
   if (config->image_hint >= WEBP_HINT_LAST) return 0;
   if (config->emulate_jpeg_size < 0 || config->emulate_jpeg_size > 1) return 0;
-  if (config->thread_level < 0 || config->thread_level > 1) return 0;
+  // Lossless encoding uses up to 32 bands (MAX_LOSSLESS_BANDS).
+  if (config->thread_level < 0 || config->thread_level > 32) return 0;
   if (config->low_memory < 0 || config->low_memory > 1) return 0;
   if (config->exact < 0 || config->exact > 1) return 0;
   if (config->use_delta_palette < 0 || config->use_delta_palette > 1) {
     return 0;
   }
   if (config->use_sharp_yuv < 0 || config->use_sharp_yuv > 1) return 0;
+  if (config->keep_smaller < 0 || config->keep_smaller > 2) return 0;
 
   return 1;
 }
@@ -590,7 +590,7 @@ static uint64_t OneStatPass(VP8Encoder* const enc, VP8RDLevel rd_opt,
     size += info.R + info.H;
     size_p0 += info.H;
     distortion += info.D;
-    if (percent_delta && !VP8IteratorProgress(&it, percent_delta)) {
+    if (!VP8IteratorProgress(&it, percent_delta)) {
       return 0;
     }
     VP8IteratorSaveBoundary(&it);
@@ -732,6 +732,16 @@ static void ResetAfterSkip(VP8EncIterator* const it) {
   }
 }
 
+// Size of the token partitions coded so far, a lower bound of the final size.
+static size_t GetPartitionsSize(const VP8Encoder* const enc) {
+  size_t size = 0;
+  int p;
+  for (p = 0; p < enc->num_parts_; ++p) {
+    size += VP8BitWriterSize(&enc->parts_[p]);
+  }
+  return size;
+}
+
 int VP8EncLoop(VP8Encoder* const enc) {
   VP8EncIterator it;
   int ok = PreLoopInitialize(enc);
@@ -758,6 +768,9 @@ int VP8EncLoop(VP8Encoder* const enc) {
     VP8StoreFilterStats(&it);
     VP8IteratorExport(&it);
     ok = VP8IteratorProgress(&it, 20);
+    if (ok && it.x_ == enc->mb_w_ - 1) {
+      ok = WebPEncodingCheckSize(enc->pic_, GetPartitionsSize(enc));
+    }
     VP8IteratorSaveBoundary(&it);
   } while (ok && VP8IteratorNext(&it));
 
@@ -816,6 +829,14 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
         FinalizeTokenProbas(proba);
         VP8CalculateLevelCosts(proba);  // refresh cost tables for rd-opt
         cnt = max_count;
+        if (is_last_pass && WebPEncodingSizeLimit(enc->pic_) > 0) {
+          // Only an estimate: the final probabilities will be better.
+          const uint64_t size =
+              VP8EstimateTokenSize(&enc->tokens_,
+                                   (const uint8_t*)proba->coeffs_) + size_p0;
+          ok = WebPEncodingCheckSize(enc->pic_, (size_t)((size + 1024) >> 11));
+          if (!ok) break;
+        }
       }
       VP8Decimate(&it, &info, rd_opt);
       ok = RecordTokens(&it, &info, &enc->tokens_);
@@ -830,6 +851,8 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
         VP8StoreFilterStats(&it);
         VP8IteratorExport(&it);
         ok = VP8IteratorProgress(&it, 20);
+      } else {
+        ok = VP8IteratorProgress(&it, 0);   // only polls the cancellation
       }
       VP8IteratorSaveBoundary(&it);
     } while (ok && VP8IteratorNext(&it));
@@ -17,11 +17,12 @@
 
 #include "src/enc/backward_references_enc.h"
 #include "src/enc/histogram_enc.h"
+#include "src/enc/vp8i_enc.h"
 #include "src/dsp/lossless.h"
 #include "src/dsp/lossless_common.h"
 #include "src/utils/utils.h"
 
-#define MAX_COST 1.e38
+#define MAX_BIT_COST 1.e38
 
 // Number of partitions for the three dominant (literal, red and blue) symbol
 // costs.
@@ -485,11 +486,11 @@ typedef struct {
 
 static void DominantCostRangeInit(DominantCostRange* const c) {
   c->literal_max_ = 0.;
-  c->literal_min_ = MAX_COST;
+  c->literal_min_ = MAX_BIT_COST;
   c->red_max_ = 0.;
-  c->red_min_ = MAX_COST;
+  c->red_min_ = MAX_BIT_COST;
   c->blue_max_ = 0.;
-  c->blue_min_ = MAX_COST;
+  c->blue_min_ = MAX_BIT_COST;
 }
 
 static void UpdateDominantCostRange(
@@ -834,7 +835,8 @@ static double HistoQueuePush(HistoQueue* const histo_queue,
 // Combines histograms by continuously choosing the one with the highest cost
 // reduction.
 static int HistogramCombineGreedy(VP8LHistogramSet* const image_histo,
-                                  int* const num_used) {
+                                  int* const num_used,
+                                  const WebPPicture* const pic) {
   int ok = 0;
   const int image_histo_size = image_histo->size;
   int i, j;
@@ -865,6 +867,7 @@ static int HistogramCombineGreedy(VP8LHistogramSet* const image_histo,
   while (histo_queue.size > 0) {
     const int idx1 = histo_queue.queue[0].idx1;
     const int idx2 = histo_queue.queue[0].idx2;
+    if (WebPEncodingIsCancelled(pic)) goto End;
     HistogramAdd(histograms[idx2], histograms[idx1], histograms[idx1]);
     histograms[idx1]->bit_cost_ = histo_queue.queue[0].cost_combo;
 
@@ -906,7 +909,8 @@ static int PairComparison(const void* idx1, const void* idx2) {
 }
 static int HistogramCombineStochastic(VP8LHistogramSet* const image_histo,
                                       int* const num_used, int min_cluster_size,
-                                      int* const do_greedy) {
+                                      int* const do_greedy,
+                                      const WebPPicture* const pic) {
   int j, iter;
   uint32_t seed = 1;
   int tries_with_no_success = 0;
@@ -952,6 +956,8 @@ static int HistogramCombineStochastic(VP8LHistogramSet* const image_histo,
     // compression.
     const int num_tries = (*num_used) / 2;
 
+    if (WebPEncodingIsCancelled(pic)) goto End;
+
     // Pick random samples.
     for (j = 0; *num_used >= 2 && j < num_tries; ++j) {
       double curr_cost;
@@ -1056,7 +1062,7 @@ static void HistogramRemap(const VP8LHistogramSet* const in,
   if (out_size > 1) {
     for (i = 0; i < in_size; ++i) {
       int best_out = 0;
-      double best_bits = MAX_COST;
+      double best_bits = MAX_BIT_COST;
       int k;
       if (in_histo[i] == NULL) {
         // Arbitrarily set to the previous value if unused to help future LZ77.
@@ -1173,7 +1179,8 @@ int VP8LGetHistoImageSymbols(int xsize, int ysize,
                              int histo_bits, int cache_bits,
                              VP8LHistogramSet* const image_histo,
                              VP8LHistogram* const tmp_histo,
-                             uint16_t* const histogram_symbols) {
+                             uint16_t* const histogram_symbols,
+                             const WebPPicture* const pic) {
   int ok = 0;
   const int histo_xsize = histo_bits ? VP8LSubSampleSize(xsize, histo_bits) : 1;
   const int histo_ysize = histo_bits ? VP8LSubSampleSize(ysize, histo_bits) : 1;
@@ -1225,12 +1232,12 @@ int VP8LGetHistoImageSymbols(int xsize, int ysize,
     const int threshold_size = (int)(1 + (x * x * x) * (MAX_HISTO_GREEDY - 1));
     int do_greedy;
     if (!HistogramCombineStochastic(image_histo, &num_used, threshold_size,
-                                    &do_greedy)) {
+                                    &do_greedy, pic)) {
       goto Error;
     }
     if (do_greedy) {
       RemoveEmptyHistograms(image_histo);
-      if (!HistogramCombineGreedy(image_histo, &num_used)) {
+      if (!HistogramCombineGreedy(image_histo, &num_used, pic)) {
         goto Error;
       }
     }
@@ -83,11 +83,14 @@ void VP8IteratorInit(VP8Encoder* const enc, VP8EncIterator* const it) {
   it->u_left_ = it->y_left_ + 16 + 16;
   it->v_left_ = it->u_left_ + 16;
   it->top_derr_ = enc->top_derr_;
+  it->rows_ = enc->rows_;
   VP8IteratorReset(it);
 }
 
 int VP8IteratorProgress(const VP8EncIterator* const it, int delta) {
   VP8Encoder* const enc = it->enc_;
+  // Poll the cancellation once per macroblock row.
+  if (it->x_ == 0 && WebPEncodingIsCancelled(enc->pic_)) return 0;
   if (delta && enc->pic_->progress_hook != NULL) {
     const int done = it->count_down0_ - it->count_down_;
     const int percent = (it->count_down0_ <= 0)
@@ -131,12 +134,15 @@ static void ImportLine(const uint8_t* src, int src_stride,
 void VP8IteratorImport(VP8EncIterator* const it, uint8_t* const tmp_32) {
   const VP8Encoder* const enc = it->enc_;
   const int x = it->x_, y = it->y_;
-  const WebPPicture* const pic = enc->pic_;
-  const uint8_t* const ysrc = pic->y + (y * pic->y_stride  + x) * 16;
-  const uint8_t* const usrc = pic->u + (y * pic->uv_stride + x) * 8;
-  const uint8_t* const vsrc = pic->v + (y * pic->uv_stride + x) * 8;
+  // With a row window, the samples of row 'y' start at the window's row 0.
+  const WebPPicture* const pic =
+      (it->rows_ != NULL) ? VP8RowWindowGet(it->rows_, y) : enc->pic_;
+  const int row = (it->rows_ != NULL) ? 0 : y;
+  const uint8_t* const ysrc = pic->y + (row * pic->y_stride  + x) * 16;
+  const uint8_t* const usrc = pic->u + (row * pic->uv_stride + x) * 8;
+  const uint8_t* const vsrc = pic->v + (row * pic->uv_stride + x) * 8;
   const int w = MinSize(pic->width - x * 16, 16);
-  const int h = MinSize(pic->height - y * 16, 16);
+  const int h = MinSize(pic->height - row * 16, 16);
   const int uv_w = (w + 1) >> 1;
   const int uv_h = (h + 1) >> 1;
 
@@ -252,6 +252,11 @@ static WEBP_INLINE uint32_t LinearToGammaS(uint32_t value) {
 
 #endif    // USE_GAMMA_COMPRESSION
 
+void WebPInitGammaTables(void) {
+  InitGammaTables();
+  InitGammaTablesS();
+}
+
 //------------------------------------------------------------------------------
 
 static uint8_t clip_8b(fixed_t v) {
@@ -839,6 +844,106 @@ static WEBP_INLINE void ConvertRowsToUV(const uint16_t* rgb,
   }
 }
 
+// Converts all the rows of 'picture' from the RGB(A) samples, two rows at a
+// time. 'tmp_rgb' is a scratch buffer of 4 * ((width + 1) / 2) elements.
+static void ConvertRowsToYUVA(const uint8_t* r_ptr,
+                              const uint8_t* g_ptr,
+                              const uint8_t* b_ptr,
+                              const uint8_t* a_ptr,
+                              int step,         // bytes per pixel
+                              int rgb_stride,   // bytes per scanline
+                              int has_alpha,
+                              VP8Random* const rg,
+                              uint16_t* const tmp_rgb,
+                              const WebPPicture* const picture) {
+  int y;
+  const int width = picture->width;
+  const int height = picture->height;
+  const int uv_width = (width + 1) >> 1;
+  const int is_rgb = (r_ptr < b_ptr);  // otherwise it's bgr
+  // use special function in this case, but can't with dithering
+  const int use_dsp = (step == 3) && (rg == NULL);
+  uint8_t* dst_y = picture->y;
+  uint8_t* dst_u = picture->u;
+  uint8_t* dst_v = picture->v;
+  uint8_t* dst_a = picture->a;
+
+  // Downsample Y/U/V planes, two rows at a time
+  for (y = 0; y < (height >> 1); ++y) {
+    int rows_have_alpha = has_alpha;
+    if (use_dsp) {
+      if (is_rgb) {
+        WebPConvertRGB24ToY(r_ptr, dst_y, width);
+        WebPConvertRGB24ToY(r_ptr + rgb_stride,
+                            dst_y + picture->y_stride, width);
+      } else {
+        WebPConvertBGR24ToY(b_ptr, dst_y, width);
+        WebPConvertBGR24ToY(b_ptr + rgb_stride,
+                            dst_y + picture->y_stride, width);
+      }
+    } else {
+      ConvertRowToY(r_ptr, g_ptr, b_ptr, step, dst_y, width, rg);
+      ConvertRowToY(r_ptr + rgb_stride,
+                    g_ptr + rgb_stride,
+                    b_ptr + rgb_stride, step,
+                    dst_y + picture->y_stride, width, rg);
+    }
+    dst_y += 2 * picture->y_stride;
+    if (has_alpha) {
+      rows_have_alpha &= !WebPExtractAlpha(a_ptr, rgb_stride, width, 2,
+                                           dst_a, picture->a_stride);
+      dst_a += 2 * picture->a_stride;
+    }
+    // Collect averaged R/G/B(/A)
+    if (!rows_have_alpha) {
+      AccumulateRGB(r_ptr, g_ptr, b_ptr, step, rgb_stride, tmp_rgb, width);
+    } else {
+      AccumulateRGBA(r_ptr, g_ptr, b_ptr, a_ptr, rgb_stride, tmp_rgb, width);
+    }
+    // Convert to U/V
+    if (rg == NULL) {
+      WebPConvertRGBA32ToUV(tmp_rgb, dst_u, dst_v, uv_width);
+    } else {
+      ConvertRowsToUV(tmp_rgb, dst_u, dst_v, uv_width, rg);
+    }
+    dst_u += picture->uv_stride;
+    dst_v += picture->uv_stride;
+    r_ptr += 2 * rgb_stride;
+    b_ptr += 2 * rgb_stride;
+    g_ptr += 2 * rgb_stride;
+    if (has_alpha) a_ptr += 2 * rgb_stride;
+  }
+  if (height & 1) {    // extra last row
+    int row_has_alpha = has_alpha;
+    if (use_dsp) {
+      if (r_ptr < b_ptr) {
+        WebPConvertRGB24ToY(r_ptr, dst_y, width);
+      } else {
+        WebPConvertBGR24ToY(b_ptr, dst_y, width);
+      }
+    } else {
+      ConvertRowToY(r_ptr, g_ptr, b_ptr, step, dst_y, width, rg);
+    }
+    if (row_has_alpha) {
+      row_has_alpha &= !WebPExtractAlpha(a_ptr, 0, width, 1, dst_a, 0);
+    }
+    // Collect averaged R/G/B(/A)
+    if (!row_has_alpha) {
+      // Collect averaged R/G/B
+      AccumulateRGB(r_ptr, g_ptr, b_ptr, step, /* rgb_stride = */ 0,
+                    tmp_rgb, width);
+    } else {
+      AccumulateRGBA(r_ptr, g_ptr, b_ptr, a_ptr, /* rgb_stride = */ 0,
+                     tmp_rgb, width);
+    }
+    if (rg == NULL) {
+      WebPConvertRGBA32ToUV(tmp_rgb, dst_u, dst_v, uv_width);
+    } else {
+      ConvertRowsToUV(tmp_rgb, dst_u, dst_v, uv_width, rg);
+    }
+  }
+}
+
 static int ImportYUVAFromRGBA(const uint8_t* r_ptr,
                               const uint8_t* g_ptr,
                               const uint8_t* b_ptr,
@@ -848,11 +953,9 @@ static int ImportYUVAFromRGBA(const uint8_t* r_ptr,
                               float dithering,
                               int use_iterative_conversion,
                               WebPPicture* const picture) {
-  int y;
   const int width = picture->width;
   const int height = picture->height;
   const int has_alpha = CheckNonOpaque(a_ptr, width, height, step, rgb_stride);
-  const int is_rgb = (r_ptr < b_ptr);  // otherwise it's bgr
 
   picture->colorspace = has_alpha ? WEBP_YUV420A : WEBP_YUV420;
   picture->use_argb = 0;
@@ -884,101 +987,23 @@ static int ImportYUVAFromRGBA(const uint8_t* r_ptr,
     }
   } else {
     const int uv_width = (width + 1) >> 1;
-    int use_dsp = (step == 3);  // use special function in this case
     // temporary storage for accumulated R/G/B values during conversion to U/V
     uint16_t* const tmp_rgb =
         (uint16_t*)WebPSafeMalloc(4 * uv_width, sizeof(*tmp_rgb));
-    uint8_t* dst_y = picture->y;
-    uint8_t* dst_u = picture->u;
-    uint8_t* dst_v = picture->v;
-    uint8_t* dst_a = picture->a;
 
     VP8Random base_rg;
     VP8Random* rg = NULL;
     if (dithering > 0.) {
       VP8InitRandom(&base_rg, dithering);
       rg = &base_rg;
-      use_dsp = 0;   // can't use dsp in this case
     }
     WebPInitConvertARGBToYUV();
     InitGammaTables();
 
     if (tmp_rgb == NULL) return 0;  // malloc error
 
-    // Downsample Y/U/V planes, two rows at a time
-    for (y = 0; y < (height >> 1); ++y) {
-      int rows_have_alpha = has_alpha;
-      if (use_dsp) {
-        if (is_rgb) {
-          WebPConvertRGB24ToY(r_ptr, dst_y, width);
-          WebPConvertRGB24ToY(r_ptr + rgb_stride,
-                              dst_y + picture->y_stride, width);
-        } else {
-          WebPConvertBGR24ToY(b_ptr, dst_y, width);
-          WebPConvertBGR24ToY(b_ptr + rgb_stride,
-                              dst_y + picture->y_stride, width);
-        }
-      } else {
-        ConvertRowToY(r_ptr, g_ptr, b_ptr, step, dst_y, width, rg);
-        ConvertRowToY(r_ptr + rgb_stride,
-                      g_ptr + rgb_stride,
-                      b_ptr + rgb_stride, step,
-                      dst_y + picture->y_stride, width, rg);
-      }
-      dst_y += 2 * picture->y_stride;
-      if (has_alpha) {
-        rows_have_alpha &= !WebPExtractAlpha(a_ptr, rgb_stride, width, 2,
-                                             dst_a, picture->a_stride);
-        dst_a += 2 * picture->a_stride;
-      }
-      // Collect averaged R/G/B(/A)
-      if (!rows_have_alpha) {
-        AccumulateRGB(r_ptr, g_ptr, b_ptr, step, rgb_stride, tmp_rgb, width);
-      } else {
-        AccumulateRGBA(r_ptr, g_ptr, b_ptr, a_ptr, rgb_stride, tmp_rgb, width);
-      }
-      // Convert to U/V
-      if (rg == NULL) {
-        WebPConvertRGBA32ToUV(tmp_rgb, dst_u, dst_v, uv_width);
-      } else {
-        ConvertRowsToUV(tmp_rgb, dst_u, dst_v, uv_width, rg);
-      }
-      dst_u += picture->uv_stride;
-      dst_v += picture->uv_stride;
-      r_ptr += 2 * rgb_stride;
-      b_ptr += 2 * rgb_stride;
-      g_ptr += 2 * rgb_stride;
-      if (has_alpha) a_ptr += 2 * rgb_stride;
-    }
-    if (height & 1) {    // extra last row
-      int row_has_alpha = has_alpha;
-      if (use_dsp) {
-        if (r_ptr < b_ptr) {
-          WebPConvertRGB24ToY(r_ptr, dst_y, width);
-        } else {
-          WebPConvertBGR24ToY(b_ptr, dst_y, width);
-        }
-      } else {
-        ConvertRowToY(r_ptr, g_ptr, b_ptr, step, dst_y, width, rg);
-      }
-      if (row_has_alpha) {
-        row_has_alpha &= !WebPExtractAlpha(a_ptr, 0, width, 1, dst_a, 0);
-      }
-      // Collect averaged R/G/B(/A)
-      if (!row_has_alpha) {
-        // Collect averaged R/G/B
-        AccumulateRGB(r_ptr, g_ptr, b_ptr, step, /* rgb_stride = */ 0,
-                      tmp_rgb, width);
-      } else {
-        AccumulateRGBA(r_ptr, g_ptr, b_ptr, a_ptr, /* rgb_stride = */ 0,
-                       tmp_rgb, width);
-      }
-      if (rg == NULL) {
-        WebPConvertRGBA32ToUV(tmp_rgb, dst_u, dst_v, uv_width);
-      } else {
-        ConvertRowsToUV(tmp_rgb, dst_u, dst_v, uv_width, rg);
-      }
-    }
+    ConvertRowsToYUVA(r_ptr, g_ptr, b_ptr, a_ptr, step, rgb_stride,
+                      has_alpha, rg, tmp_rgb, picture);
     WebPSafeFree(tmp_rgb);
   }
   return 1;
@@ -1029,6 +1054,96 @@ int WebPPictureSmartARGBToYUVA(WebPPicture* picture) {
   return WebPPictureSharpARGBToYUVA(picture);
 }
 
+//------------------------------------------------------------------------------
+// Macroblock-row window, for on-demand ARGB->YUVA conversion
+
+int VP8RowWindowInit(VP8RowWindow* const win, const WebPPicture* const src,
+                     int has_alpha, int exact) {
+  const int width = src->width;
+  const int uv_width = (width + 1) >> 1;
+  // one extra line on top of the Y/U/V rows, for the top boundary samples
+  const uint64_t y_size = (uint64_t)width * (16 + 1);
+  const uint64_t uv_size = (uint64_t)uv_width * (8 + 1);
+  const uint64_t a_size = has_alpha ? (uint64_t)width * 16 : 0;
+  const uint64_t tmp_size = 4 * uv_width * sizeof(*win->tmp_rgb_);
+  WebPPicture* const rows = &win->rows_;
+  uint8_t* mem;
+
+  assert(src->use_argb && src->argb != NULL);
+  memset(win, 0, sizeof(*win));
+  mem = (uint8_t*)WebPSafeMalloc(tmp_size + y_size + 2 * uv_size + a_size,
+                                 sizeof(*mem));
+  if (mem == NULL) return 0;
+  win->mem_ = mem;
+  win->tmp_rgb_ = (uint16_t*)mem;
+  mem += tmp_size;
+
+  rows->use_argb = 0;
+  rows->colorspace = has_alpha ? WEBP_YUV420A : WEBP_YUV420;
+  rows->width = width;
+  rows->y_stride = width;
+  rows->uv_stride = uv_width;
+  rows->y = mem + rows->y_stride;
+  mem += y_size;
+  rows->u = mem + rows->uv_stride;
+  mem += uv_size;
+  rows->v = mem + rows->uv_stride;
+  mem += uv_size;
+  if (has_alpha) {
+    rows->a = mem;
+    rows->a_stride = width;
+  }
+  win->src_ = src;
+  win->exact_ = exact;
+  win->mb_y_ = -1;
+
+  WebPInitConvertARGBToYUV();
+  InitGammaTables();
+  return 1;
+}
+
+void VP8RowWindowClear(VP8RowWindow* const win) {
+  if (win != NULL) {
+    WebPSafeFree(win->mem_);
+    memset(win, 0, sizeof(*win));
+  }
+}
+
+static void LoadWindowRow(VP8RowWindow* const win, int mb_y) {
+  const WebPPicture* const src = win->src_;
+  WebPPicture* const rows = &win->rows_;
+  const int y = mb_y * 16;
+  const uint8_t* const argb =
+      (const uint8_t*)(src->argb + (size_t)y * src->argb_stride);
+  rows->height = (src->height - y < 16) ? src->height - y : 16;
+  ConvertRowsToYUVA(argb + CHANNEL_OFFSET(1), argb + CHANNEL_OFFSET(2),
+                    argb + CHANNEL_OFFSET(3), argb + CHANNEL_OFFSET(0),
+                    4, 4 * src->argb_stride, (rows->a != NULL), NULL,
+                    win->tmp_rgb_, rows);
+  // Rows are 16-aligned, so this gives the same result as the full-picture
+  // cleanup done by WebPEncode().
+  if (!win->exact_) WebPCleanupTransparentArea(rows);
+  win->mb_y_ = mb_y;
+}
+
+const WebPPicture* VP8RowWindowGet(VP8RowWindow* const win, int mb_y) {
+  WebPPicture* const rows = &win->rows_;
+  if (mb_y != win->mb_y_) {
+    if (mb_y > 0) {
+      if (mb_y != win->mb_y_ + 1) LoadWindowRow(win, mb_y - 1);
+      // Save the last line of the previous macroblock row above the window.
+      memcpy(rows->y - rows->y_stride, rows->y + 15 * rows->y_stride,
+             rows->width);
+      memcpy(rows->u - rows->uv_stride, rows->u + 7 * rows->uv_stride,
+             rows->uv_stride);
+      memcpy(rows->v - rows->uv_stride, rows->v + 7 * rows->uv_stride,
+             rows->uv_stride);
+    }
+    LoadWindowRow(win, mb_y);
+  }
+  return rows;
+}
+
 //------------------------------------------------------------------------------
 // call for YUVA -> ARGB conversion
 
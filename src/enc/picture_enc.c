@@ -183,18 +183,13 @@ void WebPMemoryWriterInit(WebPMemoryWriter* writer) {
   writer->max_size = 0;
 }
 
-int WebPMemoryWrite(const uint8_t* data, size_t data_size,
-                    const WebPPicture* picture) {
-  WebPMemoryWriter* const w = (WebPMemoryWriter*)picture->custom_ptr;
-  uint64_t next_size;
-  if (w == NULL) {
-    return 1;
-  }
-  next_size = (uint64_t)w->size + data_size;
+// Makes room for at least 'next_size' bytes. 'extra' is the extra capacity
+// to reserve when growing, for the writes to come.
+static int GrowMemoryWriter(WebPMemoryWriter* const w, uint64_t next_size,
+                            uint64_t extra) {
   if (next_size > w->max_size) {
     uint8_t* new_mem;
-    uint64_t next_max_size = 2ULL * w->max_size;
-    if (next_max_size < next_size) next_max_size = next_size;
+    uint64_t next_max_size = next_size + extra;
     if (next_max_size < 8192ULL) next_max_size = 8192ULL;
     new_mem = (uint8_t*)WebPSafeMalloc(next_max_size, 1);
     if (new_mem == NULL) {
@@ -208,6 +203,23 @@ int WebPMemoryWrite(const uint8_t* data, size_t data_size,
     // down-cast is ok, thanks to WebPSafeMalloc
     w->max_size = (size_t)next_max_size;
   }
+  return 1;
+}
+
+int WebPMemoryWrite(const uint8_t* data, size_t data_size,
+                    const WebPPicture* picture) {
+  WebPMemoryWriter* const w = (WebPMemoryWriter*)picture->custom_ptr;
+  uint64_t next_size;
+  if (w == NULL) {
+    return 1;
+  }
+  next_size = (uint64_t)w->size + data_size;
+  if (next_size > w->max_size) {
+    // grow geometrically: at least twice the previous capacity
+    const uint64_t extra =
+        (2ULL * w->max_size > next_size) ? 2ULL * w->max_size - next_size : 0;
+    if (!GrowMemoryWriter(w, next_size, extra)) return 0;
+  }
   if (data_size > 0) {
     memcpy(w->mem + w->size, data, data_size);
     w->size += data_size;
@@ -215,6 +227,31 @@ int WebPMemoryWrite(const uint8_t* data, size_t data_size,
   return 1;
 }
 
+static WebPMemoryWriter* GetMemoryWriter(const WebPPicture* const picture) {
+  return (picture->writer == WebPMemoryWrite)
+       ? (WebPMemoryWriter*)picture->custom_ptr : NULL;
+}
+
+void WebPMemoryWriterReserve(const WebPPicture* const picture, size_t size) {
+  WebPMemoryWriter* const w = GetMemoryWriter(picture);
+  if (w != NULL) {
+    // Failure is not fatal: WebPMemoryWrite() will try again.
+    (void)GrowMemoryWriter(w, (uint64_t)w->size + size, 0);
+  }
+}
+
+int WebPMemoryWriterAdopt(const WebPPicture* const picture,
+                          uint8_t* const data, size_t data_size) {
+  WebPMemoryWriter* const w = GetMemoryWriter(picture);
+  if (w == NULL || w->size > 0 || data_size == 0) return 0;
+  WebPSafeFree(w->mem);
+  // Trim the encoder's slack, usually in place.
+  w->mem = (uint8_t*)WebPSafeShrink(data, data_size);
+  w->size = data_size;
+  w->max_size = data_size;
+  return 1;
+}
+
 void WebPMemoryWriterClear(WebPMemoryWriter* writer) {
   if (writer != NULL) {
     WebPSafeFree(writer->mem);
@@ -17,6 +17,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "src/enc/vp8i_enc.h"
 #include "src/utils/rescaler_utils.h"
@@ -164,20 +165,35 @@ int WebPPictureCrop(WebPPicture* pic,
 //------------------------------------------------------------------------------
 // Simple picture rescaler
 
+// If 'tmp_row' is not NULL, the rows of 'src' are premultiplied by their alpha
+// ('alpha' plane for single-channel 'src', embedded for ARGB) in 'tmp_row'
+// before being imported, leaving 'src' untouched.
 static void RescalePlane(const uint8_t* src,
                          int src_width, int src_height, int src_stride,
                          uint8_t* dst,
                          int dst_width, int dst_height, int dst_stride,
                          rescaler_t* const work,
-                         int num_channels) {
+                         int num_channels,
+                         const uint8_t* alpha, int alpha_stride,
+                         uint8_t* const tmp_row) {
   WebPRescaler rescaler;
   int y = 0;
   WebPRescalerInit(&rescaler, src_width, src_height,
                    dst, dst_width, dst_height, dst_stride,
                    num_channels, work);
   while (y < src_height) {
-    y += WebPRescalerImport(&rescaler, src_height - y,
-                            src + y * src_stride, src_stride);
+    if (tmp_row != NULL) {
+      memcpy(tmp_row, src + y * src_stride, src_width * num_channels);
+      if (num_channels == 4) {
+        WebPMultARGBRow((uint32_t*)tmp_row, src_width, 0);
+      } else {
+        WebPMultRow(tmp_row, alpha + y * alpha_stride, src_width, 0);
+      }
+      y += WebPRescalerImport(&rescaler, 1, tmp_row, src_stride);
+    } else {
+      y += WebPRescalerImport(&rescaler, src_height - y,
+                              src + y * src_stride, src_stride);
+    }
     WebPRescalerExport(&rescaler);
   }
 }
@@ -195,72 +211,80 @@ static void AlphaMultiplyY(WebPPicture* const pic, int inverse) {
   }
 }
 
-int WebPPictureRescale(WebPPicture* pic, int width, int height) {
-  WebPPicture tmp;
-  int prev_width, prev_height;
+int WebPPictureRescaleTo(const WebPPicture* const src, int width, int height,
+                         WebPPicture* const dst) {
+  const int prev_width = src->width;
+  const int prev_height = src->height;
   rescaler_t* work;
+  uint8_t* tmp_row;
 
-  if (pic == NULL) return 0;
-  prev_width = pic->width;
-  prev_height = pic->height;
-  if (!WebPRescalerGetScaledDimensions(
-          prev_width, prev_height, &width, &height)) {
+  PictureGrabSpecs(src, dst);
+  dst->width = width;
+  dst->height = height;
+  if (!WebPPictureAlloc(dst)) return 0;
+
+  // Room for the rescaler's work area, then for the premultiplied input row.
+  work = (rescaler_t*)WebPSafeMalloc(
+      2ULL * width * 4 + (prev_width * sizeof(uint32_t) + sizeof(*work) - 1) /
+                             sizeof(*work),
+      sizeof(*work));
+  if (work == NULL) {
+    WebPPictureFree(dst);
     return 0;
   }
+  tmp_row = (uint8_t*)(work + 2 * width * 4);
 
-  PictureGrabSpecs(pic, &tmp);
-  tmp.width = width;
-  tmp.height = height;
-  if (!WebPPictureAlloc(&tmp)) return 0;
-
-  if (!pic->use_argb) {
-    work = (rescaler_t*)WebPSafeMalloc(2ULL * width, sizeof(*work));
-    if (work == NULL) {
-      WebPPictureFree(&tmp);
-      return 0;
-    }
+  WebPInitAlphaProcessing();
+  if (!src->use_argb) {
     // If present, we need to rescale alpha first (for AlphaMultiplyY).
-    if (pic->a != NULL) {
-      WebPInitAlphaProcessing();
-      RescalePlane(pic->a, prev_width, prev_height, pic->a_stride,
-                   tmp.a, width, height, tmp.a_stride, work, 1);
+    if (src->a != NULL) {
+      RescalePlane(src->a, prev_width, prev_height, src->a_stride,
+                   dst->a, width, height, dst->a_stride, work, 1,
+                   NULL, 0, NULL);
     }
 
     // We take transparency into account on the luma plane only. That's not
     // totally exact blending, but still is a good approximation.
-    AlphaMultiplyY(pic, 0);
-    RescalePlane(pic->y, prev_width, prev_height, pic->y_stride,
-                 tmp.y, width, height, tmp.y_stride, work, 1);
-    AlphaMultiplyY(&tmp, 1);
-
-    RescalePlane(pic->u,
-                 HALVE(prev_width), HALVE(prev_height), pic->uv_stride,
-                 tmp.u,
-                 HALVE(width), HALVE(height), tmp.uv_stride, work, 1);
-    RescalePlane(pic->v,
-                 HALVE(prev_width), HALVE(prev_height), pic->uv_stride,
-                 tmp.v,
-                 HALVE(width), HALVE(height), tmp.uv_stride, work, 1);
+    RescalePlane(src->y, prev_width, prev_height, src->y_stride,
+                 dst->y, width, height, dst->y_stride, work, 1,
+                 src->a, src->a_stride, (src->a != NULL) ? tmp_row : NULL);
+    AlphaMultiplyY(dst, 1);
+
+    RescalePlane(src->u,
+                 HALVE(prev_width), HALVE(prev_height), src->uv_stride,
+                 dst->u,
+                 HALVE(width), HALVE(height), dst->uv_stride, work, 1,
+                 NULL, 0, NULL);
+    RescalePlane(src->v,
+                 HALVE(prev_width), HALVE(prev_height), src->uv_stride,
+                 dst->v,
+                 HALVE(width), HALVE(height), dst->uv_stride, work, 1,
+                 NULL, 0, NULL);
   } else {
-    work = (rescaler_t*)WebPSafeMalloc(2ULL * width * 4, sizeof(*work));
-    if (work == NULL) {
-      WebPPictureFree(&tmp);
-      return 0;
-    }
     // In order to correctly interpolate colors, we need to apply the alpha
     // weighting first (black-matting), scale the RGB values, and remove
     // the premultiplication afterward (while preserving the alpha channel).
-    WebPInitAlphaProcessing();
-    AlphaMultiplyARGB(pic, 0);
-    RescalePlane((const uint8_t*)pic->argb, prev_width, prev_height,
-                 pic->argb_stride * 4,
-                 (uint8_t*)tmp.argb, width, height,
-                 tmp.argb_stride * 4,
-                 work, 4);
-    AlphaMultiplyARGB(&tmp, 1);
+    RescalePlane((const uint8_t*)src->argb, prev_width, prev_height,
+                 src->argb_stride * 4,
+                 (uint8_t*)dst->argb, width, height,
+                 dst->argb_stride * 4,
+                 work, 4, NULL, 0, tmp_row);
+    AlphaMultiplyARGB(dst, 1);
   }
-  WebPPictureFree(pic);
   WebPSafeFree(work);
+  return 1;
+}
+
+int WebPPictureRescale(WebPPicture* pic, int width, int height) {
+  WebPPicture tmp;
+
+  if (pic == NULL) return 0;
+  if (!WebPRescalerGetScaledDimensions(
+          pic->width, pic->height, &width, &height)) {
+    return 0;
+  }
+  if (!WebPPictureRescaleTo(pic, width, height, &tmp)) return 0;
+  WebPPictureFree(pic);
   *pic = tmp;
   return 1;
 }
@@ -300,6 +324,15 @@ int WebPPictureCrop(WebPPicture* pic,
   return 0;
 }
 
+int WebPPictureRescaleTo(const WebPPicture* const src, int width, int height,
+                         WebPPicture* const dst) {
+  (void)src;
+  (void)width;
+  (void)height;
+  (void)dst;
+  return 0;
+}
+
 int WebPPictureRescale(WebPPicture* pic, int width, int height) {
   (void)pic;
   (void)width;
@@ -17,6 +17,7 @@
 #include "src/dsp/lossless.h"
 #include "src/dsp/lossless_common.h"
 #include "src/enc/vp8li_enc.h"
+#include "src/utils/utils.h"
 
 #define MAX_DIFF_COST (1e30f)
 
@@ -290,6 +291,63 @@ static WEBP_INLINE void GetResidual(
   }
 }
 
+// Adds 'residual', which does not depend on the predictor, to all the
+// histograms.
+static void UpdateAllHistos(int histos[VP8L_NUM_PREDICTOR_MODES][4][256],
+                            uint32_t residual) {
+  int mode;
+  for (mode = 0; mode < VP8L_NUM_PREDICTOR_MODES; ++mode) {
+    UpdateHisto(histos[mode], residual);
+  }
+}
+
+// Returns true if some pixels of the tile are fully transparent. Their RGB is
+// then cleaned up depending on the predictor, which changes the prediction of
+// the following pixels.
+static int HasTransparentPixels(const uint32_t* argb, int width,
+                                int max_x, int max_y) {
+  int x, y;
+  for (y = 0; y < max_y; ++y) {
+    for (x = 0; x < max_x; ++x) {
+      if ((argb[x] & kMaskAlpha) == 0) return 1;
+    }
+    argb += width;
+  }
+  return 0;
+}
+
+// Computes the residual histograms of the tile for all the predictors at once,
+// straight from 'argb'. Only valid if no predictor modifies the source.
+static void CollectAllModesHistograms(
+    int width, int start_x, int start_y, int max_x, int max_y,
+    const uint32_t* const argb,
+    int histos[VP8L_NUM_PREDICTOR_MODES][4][256]) {
+  const uint32_t* row = argb + start_y * width + start_x;
+  const int skip_x = (start_x == 0);   // first column is predicted from top
+  int y = start_y;
+  memset(histos, 0, VP8L_NUM_PREDICTOR_MODES * sizeof(*histos));
+  if (y == 0) {   // first row is predicted from left, or black
+    int x;
+    UpdateAllHistos(histos, VP8LSubPixels(row[0],
+                                          skip_x ? ARGB_BLACK : row[-1]));
+    for (x = 1; x < max_x; ++x) {
+      UpdateAllHistos(histos, VP8LSubPixels(row[x], row[x - 1]));
+    }
+    row += width;
+    ++y;
+  }
+  if (y == start_y + max_y) return;
+  if (skip_x) {
+    int j;
+    for (j = y; j < start_y + max_y; ++j) {
+      const uint32_t* const pix = argb + j * width;
+      UpdateAllHistos(histos, VP8LSubPixels(pix[0], pix[-width]));
+    }
+  }
+  VP8LCollectPredictorHistograms(row + skip_x, width, max_x - skip_x,
+                                 start_y + max_y - y, histos);
+}
+
 // Returns best predictor and updates the accumulated histogram.
 // If max_quantization > 1, assumes that near lossless processing will be
 // applied, quantizing residuals to multiples of quantization levels up to
@@ -302,8 +360,10 @@ static int GetBestPredictorForTile(int width, int height,
                                    const uint32_t* const argb,
                                    int max_quantization,
                                    int exact, int used_subtract_green,
-                                   const uint32_t* const modes) {
-  const int kNumPredModes = 14;
+                                   const uint32_t* const modes,
+                                   int tile_y_start,
+                                   int (*const mode_histos)[4][256]) {
+  const int kNumPredModes = VP8L_NUM_PREDICTOR_MODES;
   const int start_x = tile_x << bits;
   const int start_y = tile_y << bits;
   const int tile_size = 1 << bits;
@@ -321,7 +381,7 @@ static int GetBestPredictorForTile(int width, int height,
   // Prediction modes of the left and above neighbor tiles.
   const int left_mode = (tile_x > 0) ?
       (modes[tile_y * tiles_per_row + tile_x - 1] >> 8) & 0xff : 0xff;
-  const int above_mode = (tile_y > 0) ?
+  const int above_mode = (tile_y > tile_y_start) ?
       (modes[(tile_y - 1) * tiles_per_row + tile_x] >> 8) & 0xff : 0xff;
   // The width of upper_row and current_row is one pixel larger than image width
   // to allow the top right pixel to point to the leftmost pixel of the next row
@@ -339,47 +399,63 @@ static int GetBestPredictorForTile(int width, int height,
   int (*best_histo)[256] = histo_stack_2;
   int i, j;
   uint32_t residuals[1 << MAX_TRANSFORM_BITS];
+  // Unless the source is modified while predicting (near lossless or cleanup
+  // of transparent pixels), the histograms of all the predictors are collected
+  // in a single pass over the tile.
+  const int all_modes_at_once =
+      (mode_histos != NULL) && (max_quantization == 1) &&
+      (exact || !HasTransparentPixels(argb + start_y * width + start_x, width,
+                                      max_x, max_y));
   assert(bits <= MAX_TRANSFORM_BITS);
   assert(max_x <= (1 << MAX_TRANSFORM_BITS));
 
+  if (all_modes_at_once) {
+    CollectAllModesHistograms(width, start_x, start_y, max_x, max_y, argb,
+                              mode_histos);
+  }
   for (mode = 0; mode < kNumPredModes; ++mode) {
     float cur_diff;
-    int relative_y;
-    memset(histo_argb, 0, sizeof(histo_stack_1));
-    if (start_y > 0) {
-      // Read the row above the tile which will become the first upper_row.
-      // Include a pixel to the left if it exists; include a pixel to the right
-      // in all cases (wrapping to the leftmost pixel of the next row if it does
-      // not exist).
-      memcpy(current_row + context_start_x,
-             argb + (start_y - 1) * width + context_start_x,
-             sizeof(*argb) * (max_x + have_left + 1));
-    }
-    for (relative_y = 0; relative_y < max_y; ++relative_y) {
-      const int y = start_y + relative_y;
-      int relative_x;
-      uint32_t* tmp = upper_row;
-      upper_row = current_row;
-      current_row = tmp;
-      // Read current_row. Include a pixel to the left if it exists; include a
-      // pixel to the right in all cases except at the bottom right corner of
-      // the image (wrapping to the leftmost pixel of the next row if it does
-      // not exist in the current row).
-      memcpy(current_row + context_start_x,
-             argb + y * width + context_start_x,
-             sizeof(*argb) * (max_x + have_left + (y + 1 < height)));
-#if (WEBP_NEAR_LOSSLESS == 1)
-      if (max_quantization > 1 && y >= 1 && y + 1 < height) {
-        MaxDiffsForRow(context_width, width, argb + y * width + context_start_x,
-                       max_diffs + context_start_x, used_subtract_green);
+    if (all_modes_at_once) {
+      histo_argb = mode_histos[mode];
+    } else {
+      int relative_y;
+      memset(histo_argb, 0, sizeof(histo_stack_1));
+      if (start_y > 0) {
+        // Read the row above the tile which will become the first
+        // upper_row. Include a pixel to the left if it exists; include a pixel
+        // to the right in all cases (wrapping to the leftmost pixel of the next
+        // row if it does not exist).
+        memcpy(current_row + context_start_x,
+               argb + (start_y - 1) * width + context_start_x,
+               sizeof(*argb) * (max_x + have_left + 1));
       }
+      for (relative_y = 0; relative_y < max_y; ++relative_y) {
+        const int y = start_y + relative_y;
+        int relative_x;
+        uint32_t* tmp = upper_row;
+        upper_row = current_row;
+        current_row = tmp;
+        // Read current_row. Include a pixel to the left if it exists; include
+        // a pixel to the right in all cases except at the bottom right corner
+        // of the image (wrapping to the leftmost pixel of the next row if it
+        // does not exist in the current row).
+        memcpy(current_row + context_start_x,
+               argb + y * width + context_start_x,
+               sizeof(*argb) * (max_x + have_left + (y + 1 < height)));
+#if (WEBP_NEAR_LOSSLESS == 1)
+        if (max_quantization > 1 && y >= 1 && y + 1 < height) {
+          MaxDiffsForRow(context_width, width,
+                         argb + y * width + context_start_x,
+                         max_diffs + context_start_x, used_subtract_green);
+        }
 #endif
 
-      GetResidual(width, height, upper_row, current_row, max_diffs, mode,
-                  start_x, start_x + max_x, y, max_quantization, exact,
-                  used_subtract_green, residuals);
-      for (relative_x = 0; relative_x < max_x; ++relative_x) {
-        UpdateHisto(histo_argb, residuals[relative_x]);
+        GetResidual(width, height, upper_row, current_row, max_diffs, mode,
+                    start_x, start_x + max_x, y, max_quantization, exact,
+                    used_subtract_green, residuals);
+        for (relative_x = 0; relative_x < max_x; ++relative_x) {
+          UpdateHisto(histo_argb, residuals[relative_x]);
+        }
       }
     }
     cur_diff = PredictionCostSpatialHistogram(
@@ -468,6 +544,42 @@ static void CopyImageWithPrediction(int width, int height,
   }
 }
 
+void VP8LGetPredictorModes(int width, int height, int bits,
+                           int tile_y_start, int tile_y_end,
+                           const uint32_t* const argb,
+                           uint32_t* const argb_scratch,
+                           uint32_t* const image, int near_lossless_quality,
+                           int exact, int used_subtract_green) {
+  const int tiles_per_row = VP8LSubSampleSize(width, bits);
+  const int max_quantization = 1 << VP8LNearLosslessBits(near_lossless_quality);
+  int tile_y;
+  int histo[4][256];
+  // Residual histograms of all the predictors, if they fit in memory.
+  int (*const mode_histos)[4][256] = (int (*)[4][256])WebPSafeMalloc(
+      VP8L_NUM_PREDICTOR_MODES, sizeof(*mode_histos));
+  memset(histo, 0, sizeof(histo));
+  for (tile_y = tile_y_start; tile_y < tile_y_end; ++tile_y) {
+    int tile_x;
+    for (tile_x = 0; tile_x < tiles_per_row; ++tile_x) {
+      const int pred = GetBestPredictorForTile(width, height, tile_x, tile_y,
+          bits, histo, argb_scratch, argb, max_quantization, exact,
+          used_subtract_green, image, tile_y_start, mode_histos);
+      image[tile_y * tiles_per_row + tile_x] = ARGB_BLACK | (pred << 8);
+    }
+  }
+  WebPSafeFree(mode_histos);
+}
+
+void VP8LApplyPredictors(int width, int height, int bits, int low_effort,
+                         uint32_t* const argb, uint32_t* const argb_scratch,
+                         uint32_t* const image, int near_lossless_quality,
+                         int exact, int used_subtract_green) {
+  const int max_quantization = 1 << VP8LNearLosslessBits(near_lossless_quality);
+  CopyImageWithPrediction(width, height, bits, image, argb_scratch, argb,
+                          low_effort, max_quantization, exact,
+                          used_subtract_green);
+}
+
 // Finds the best predictor for each tile, and converts the image to residuals
 // with respect to predictions. If near_lossless_quality < 100, applies
 // near lossless processing, shaving off more bits of residuals for lower
@@ -476,32 +588,21 @@ void VP8LResidualImage(int width, int height, int bits, int low_effort,
                        uint32_t* const argb, uint32_t* const argb_scratch,
                        uint32_t* const image, int near_lossless_quality,
                        int exact, int used_subtract_green) {
-  const int tiles_per_row = VP8LSubSampleSize(width, bits);
-  const int tiles_per_col = VP8LSubSampleSize(height, bits);
-  int tile_y;
-  int histo[4][256];
-  const int max_quantization = 1 << VP8LNearLosslessBits(near_lossless_quality);
   if (low_effort) {
+    const int tiles_per_row = VP8LSubSampleSize(width, bits);
+    const int tiles_per_col = VP8LSubSampleSize(height, bits);
     int i;
     for (i = 0; i < tiles_per_row * tiles_per_col; ++i) {
       image[i] = ARGB_BLACK | (kPredLowEffort << 8);
     }
   } else {
-    memset(histo, 0, sizeof(histo));
-    for (tile_y = 0; tile_y < tiles_per_col; ++tile_y) {
-      int tile_x;
-      for (tile_x = 0; tile_x < tiles_per_row; ++tile_x) {
-        const int pred = GetBestPredictorForTile(width, height, tile_x, tile_y,
-            bits, histo, argb_scratch, argb, max_quantization, exact,
-            used_subtract_green, image);
-        image[tile_y * tiles_per_row + tile_x] = ARGB_BLACK | (pred << 8);
-      }
-    }
-  }
-
-  CopyImageWithPrediction(width, height, bits, image, argb_scratch, argb,
-                          low_effort, max_quantization, exact,
+    VP8LGetPredictorModes(width, height, bits, 0,
+                          VP8LSubSampleSize(height, bits), argb, argb_scratch,
+                          image, near_lossless_quality, exact,
                           used_subtract_green);
+  }
+  VP8LApplyPredictors(width, height, bits, low_effort, argb, argb_scratch,
+                      image, near_lossless_quality, exact, used_subtract_green);
 }
 
 //------------------------------------------------------------------------------
@@ -538,16 +639,9 @@ static float PredictionCostCrossColor(const int accumulated[256],
 }
 
 static float GetPredictionCostCrossColorRed(
-    const uint32_t* argb, int stride, int tile_width, int tile_height,
-    VP8LMultipliers prev_x, VP8LMultipliers prev_y, int green_to_red,
-    const int accumulated_red_histo[256]) {
-  int histo[256] = { 0 };
-  float cur_diff;
-
-  VP8LCollectColorRedTransforms(argb, stride, tile_width, tile_height,
-                                green_to_red, histo);
-
-  cur_diff = PredictionCostCrossColor(accumulated_red_histo, histo);
+    const int histo[256], VP8LMultipliers prev_x, VP8LMultipliers prev_y,
+    int green_to_red, const int accumulated_red_histo[256]) {
+  float cur_diff = PredictionCostCrossColor(accumulated_red_histo, histo);
   if ((uint8_t)green_to_red == prev_x.green_to_red_) {
     cur_diff -= 3;  // favor keeping the areas locally similar
   }
@@ -560,30 +654,43 @@ static float GetPredictionCostCrossColorRed(
   return cur_diff;
 }
 
+// The candidates of each iteration are evaluated in a single pass over the
+// tile. The search itself, and hence its result, is unchanged.
 static void GetBestGreenToRed(
     const uint32_t* argb, int stride, int tile_width, int tile_height,
     VP8LMultipliers prev_x, VP8LMultipliers prev_y, int quality,
     const int accumulated_red_histo[256], VP8LMultipliers* const best_tx) {
   const int kMaxIters = 4 + ((7 * quality) >> 8);  // in range [4..6]
   int green_to_red_best = 0;
-  int iter, offset;
-  float best_diff = GetPredictionCostCrossColorRed(
-      argb, stride, tile_width, tile_height, prev_x, prev_y,
-      green_to_red_best, accumulated_red_histo);
+  int green_to_red[3];
+  int histos[3][256];
+  int iter, i;
+  float best_diff = 0.f;
   for (iter = 0; iter < kMaxIters; ++iter) {
     // ColorTransformDelta is a 3.5 bit fixed point, so 32 is equal to
     // one in color computation. Having initial delta here as 1 is sufficient
     // to explore the range of (-2, 2).
     const int delta = 32 >> iter;
+    // The initial value at origin is evaluated with the first iteration.
+    const int first = (iter == 0) ? 0 : 1;
+    green_to_red[0] = green_to_red_best;
     // Try a negative and a positive delta from the best known value.
-    for (offset = -delta; offset <= delta; offset += 2 * delta) {
-      const int green_to_red_cur = offset + green_to_red_best;
+    green_to_red[1] = green_to_red_best - delta;
+    green_to_red[2] = green_to_red_best + delta;
+    memset(histos[first], 0, (3 - first) * sizeof(histos[0]));
+    VP8LCollectColorRedTransformsBatch(argb, stride, tile_width, tile_height,
+                                       green_to_red + first, 3 - first,
+                                       histos + first);
+    for (i = first; i < 3; ++i) {
       const float cur_diff = GetPredictionCostCrossColorRed(
-          argb, stride, tile_width, tile_height, prev_x, prev_y,
-          green_to_red_cur, accumulated_red_histo);
-      if (cur_diff < best_diff) {
+          histos[i], prev_x, prev_y, green_to_red[i], accumulated_red_histo);
+      if (i == 0) {
+        best_diff = cur_diff;
+      } else if (cur_diff < best_diff) {
         best_diff = cur_diff;
-        green_to_red_best = green_to_red_cur;
+        green_to_red_best = green_to_red[i];
+        // The positive delta would now be the previous best: no need to try.
+        break;
       }
     }
   }
@@ -591,16 +698,9 @@ static void GetBestGreenToRed(
 }
 
 static float GetPredictionCostCrossColorBlue(
-    const uint32_t* argb, int stride, int tile_width, int tile_height,
-    VP8LMultipliers prev_x, VP8LMultipliers prev_y,
+    const int histo[256], VP8LMultipliers prev_x, VP8LMultipliers prev_y,
     int green_to_blue, int red_to_blue, const int accumulated_blue_histo[256]) {
-  int histo[256] = { 0 };
-  float cur_diff;
-
-  VP8LCollectColorBlueTransforms(argb, stride, tile_width, tile_height,
-                                 green_to_blue, red_to_blue, histo);
-
-  cur_diff = PredictionCostCrossColor(accumulated_blue_histo, histo);
+  float cur_diff = PredictionCostCrossColor(accumulated_blue_histo, histo);
   if ((uint8_t)green_to_blue == prev_x.green_to_blue_) {
     cur_diff -= 3;  // favor keeping the areas locally similar
   }
@@ -624,6 +724,10 @@ static float GetPredictionCostCrossColorBlue(
 
 #define kGreenRedToBlueNumAxis 8
 #define kGreenRedToBlueMaxIters 7
+// The remaining axes of an iteration are evaluated in a single pass over the
+// tile. As each axis is relative to the best value so far, the ones following
+// an improvement are evaluated again from the new best value, so that the
+// result is unchanged.
 static void GetBestGreenRedToBlue(
     const uint32_t* argb, int stride, int tile_width, int tile_height,
     VP8LMultipliers prev_x, VP8LMultipliers prev_y, int quality,
@@ -636,29 +740,51 @@ static void GetBestGreenRedToBlue(
       (quality < 25) ? 1 : (quality > 50) ? kGreenRedToBlueMaxIters : 4;
   int green_to_blue_best = 0;
   int red_to_blue_best = 0;
+  // Candidates: the origin (first batch only), then the axes.
+  int green_to_blue[1 + kGreenRedToBlueNumAxis];
+  int red_to_blue[1 + kGreenRedToBlueNumAxis];
+  int histos[1 + kGreenRedToBlueNumAxis][256];
+  int origin = 1;   // whether the initial value at origin is to be evaluated
   int iter;
-  // Initial value at origin:
-  float best_diff = GetPredictionCostCrossColorBlue(
-      argb, stride, tile_width, tile_height, prev_x, prev_y,
-      green_to_blue_best, red_to_blue_best, accumulated_blue_histo);
+  float best_diff = 0.f;
   for (iter = 0; iter < iters; ++iter) {
     const int delta = delta_lut[iter];
-    int axis;
-    for (axis = 0; axis < kGreenRedToBlueNumAxis; ++axis) {
-      const int green_to_blue_cur =
-          offset[axis][0] * delta + green_to_blue_best;
-      const int red_to_blue_cur = offset[axis][1] * delta + red_to_blue_best;
-      const float cur_diff = GetPredictionCostCrossColorBlue(
-          argb, stride, tile_width, tile_height, prev_x, prev_y,
-          green_to_blue_cur, red_to_blue_cur, accumulated_blue_histo);
-      if (cur_diff < best_diff) {
-        best_diff = cur_diff;
-        green_to_blue_best = green_to_blue_cur;
-        red_to_blue_best = red_to_blue_cur;
+    // Only axis aligned diffs for lower quality.
+    const int num_axis = (quality < 25 && iter == 4) ? 1
+                                                     : kGreenRedToBlueNumAxis;
+    int axis = 0;
+    while (axis < num_axis) {
+      int num = 0, i;
+      if (origin) {
+        green_to_blue[num] = green_to_blue_best;
+        red_to_blue[num] = red_to_blue_best;
+        ++num;
       }
-      if (quality < 25 && iter == 4) {
-        // Only axis aligned diffs for lower quality.
-        break;  // next iter.
+      for (i = axis; i < num_axis; ++i) {
+        green_to_blue[num] = offset[i][0] * delta + green_to_blue_best;
+        red_to_blue[num] = offset[i][1] * delta + red_to_blue_best;
+        ++num;
+      }
+      memset(histos, 0, num * sizeof(histos[0]));
+      VP8LCollectColorBlueTransformsBatch(argb, stride, tile_width,
+                                          tile_height, green_to_blue,
+                                          red_to_blue, num, histos);
+      for (i = 0; i < num; ++i) {
+        const float cur_diff = GetPredictionCostCrossColorBlue(
+            histos[i], prev_x, prev_y, green_to_blue[i], red_to_blue[i],
+            accumulated_blue_histo);
+        if (origin) {
+          origin = 0;
+          best_diff = cur_diff;
+          continue;
+        }
+        ++axis;
+        if (cur_diff < best_diff) {
+          best_diff = cur_diff;
+          green_to_blue_best = green_to_blue[i];
+          red_to_blue_best = red_to_blue[i];
+          break;  // the next axes are relative to the new best value
+        }
       }
     }
     if (delta == 2 && green_to_blue_best == 0 && red_to_blue_best == 0) {
@@ -1192,6 +1192,79 @@ static void PickBestUV(VP8EncIterator* const it, VP8ModeScore* const rd) {
   }
 }
 
+//------------------------------------------------------------------------------
+// Macroblocks predicted exactly. These are common in screenshots and
+// synthetic images, and need no search: there's no residual to code with the
+// matching mode, which is then the cheapest one by far. This is not always the
+// mode the full RD search would pick (e.g. a mode whose small residual is
+// quantized away can have a cheaper header), so the output can differ slightly,
+// photos included.
+
+static int IsSame16xN(const uint8_t* a, const uint8_t* b, int num_rows) {
+  int y;
+  for (y = 0; y < num_rows; ++y) {
+    if (memcmp(a + y * BPS, b + y * BPS, 16)) return 0;
+  }
+  return 1;
+}
+
+// Returns the mode with the lowest header cost amongst the ones whose
+// prediction matches the 16 x 'num_rows' source exactly, or -1 if none.
+static int GetExactMode(const VP8EncIterator* const it, const uint8_t* src,
+                        const uint16_t offsets[NUM_PRED_MODES],
+                        const uint16_t costs[NUM_PRED_MODES], int num_rows) {
+  int best_mode = -1;
+  int mode;
+  for (mode = 0; mode < NUM_PRED_MODES; ++mode) {
+    if ((best_mode < 0 || costs[mode] < costs[best_mode]) &&
+        IsSame16xN(src, it->yuv_p_ + offsets[mode], num_rows)) {
+      best_mode = mode;
+    }
+  }
+  return best_mode;
+}
+
+static void PickExactIntra16(VP8EncIterator* const it, VP8ModeScore* const rd,
+                             int mode) {
+  const VP8SegmentInfo* const dqm = &it->enc_->dqm_[it->mb_->segment_];
+  rd->mode_i16 = mode;
+  rd->nz = ReconstructIntra16(it, rd, it->yuv_out_ + Y_OFF_ENC, mode);
+  assert(rd->nz == 0);
+  rd->D = 0;
+  rd->SD = 0;
+  rd->H = VP8FixedCostsI16[mode];
+  rd->R = VP8GetCostLuma16(it, rd);
+  SetRDScore(dqm->lambda_mode_, rd);
+  VP8SetIntra16Mode(it, mode);
+}
+
+// Same as PickBestUV(), for the given mode only. The residual might not be
+// zero because of the DC error diffusion.
+static void PickExactUV(VP8EncIterator* const it, VP8ModeScore* const rd,
+                        int mode) {
+  const VP8SegmentInfo* const dqm = &it->enc_->dqm_[it->mb_->segment_];
+  const uint8_t* const src = it->yuv_in_ + U_OFF_ENC;
+  uint8_t* const dst = it->yuv_out_ + U_OFF_ENC;
+  VP8ModeScore rd_uv;
+
+  InitScore(&rd_uv);
+  rd_uv.nz = ReconstructUV(it, &rd_uv, dst, mode);
+  rd_uv.D  = VP8SSE16x8(src, dst);
+  rd_uv.H  = VP8FixedCostsUV[mode];
+  rd_uv.R  = VP8GetCostUV(it, &rd_uv);
+  SetRDScore(dqm->lambda_uv_, &rd_uv);
+  rd->mode_uv = mode;
+  memcpy(rd->uv_levels, rd_uv.uv_levels, sizeof(rd->uv_levels));
+  if (it->top_derr_ != NULL) {
+    memcpy(rd->derr, rd_uv.derr, sizeof(rd_uv.derr));
+  }
+  VP8SetIntraUVMode(it, mode);
+  AddScore(rd, &rd_uv);
+  if (it->top_derr_ != NULL) {  // store diffusion errors for next block
+    StoreDiffusionErrors(it, rd);
+  }
+}
+
 //------------------------------------------------------------------------------
 // Final reconstruction and quantization.
 
@@ -1349,12 +1422,27 @@ int VP8Decimate(VP8EncIterator* const it, VP8ModeScore* const rd,
   VP8MakeChroma8Preds(it);
 
   if (rd_opt > RD_OPT_NONE) {
+    const uint8_t* const src_y = it->yuv_in_ + Y_OFF_ENC;
+    const int mode_i16 = GetExactMode(it, src_y, VP8I16ModeOffsets,
+                                      VP8FixedCostsI16, 16);
+    const int mode_uv = GetExactMode(it, it->yuv_in_ + U_OFF_ENC,
+                                     VP8UVModeOffsets, VP8FixedCostsUV, 8);
     it->do_trellis_ = (rd_opt >= RD_OPT_TRELLIS_ALL);
-    PickBestIntra16(it, rd);
-    if (method >= 2) {
-      PickBestIntra4(it, rd);
+    if (mode_i16 >= 0) {
+      PickExactIntra16(it, rd, mode_i16);
+    } else {
+      PickBestIntra16(it, rd);
+      // Intra4 is hardly ever better than intra16 on a flat source. It still
+      // is on a few blocks, which changes the output by ~0.1% at most.
+      if (method >= 2 && !IsFlatSource16(src_y)) {
+        PickBestIntra4(it, rd);
+      }
+    }
+    if (mode_uv >= 0) {
+      PickExactUV(it, rd, mode_uv);
+    } else {
+      PickBestUV(it, rd);
     }
-    PickBestUV(it, rd);
     if (rd_opt == RD_OPT_TRELLIS) {   // finish off with trellis-optim now
       it->do_trellis_ = 1;
       SimpleQuantize(it, rd);
@@ -0,0 +1,208 @@
+// Copyright 2019 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// WebP encoder: renditions of a picture at several sizes, produced by cascaded
+// rescaling and encoded concurrently.
+
+#include "src/enc/vp8i_enc.h"
+#include "src/utils/rescaler_utils.h"
+#include "src/utils/thread_utils.h"
+#include "src/utils/trace_utils.h"
+#include "src/utils/utils.h"
+#include "src/webp/encode.h"
+
+typedef struct {
+  WebPWorker worker_;
+  const WebPConfig* config_;
+  int width_, height_;       // final dimensions of the rendition
+  WebPPicture pic_;          // rescaled picture, or view on the user's one
+  WebPMemoryWriter writer_;
+  int launched_;             // true if running on its own thread
+} RenditionJob;
+
+static int EncodeRenditionJob(void* arg1, void* arg2) {
+  RenditionJob* const job = (RenditionJob*)arg1;
+  (void)arg2;
+  return WebPEncode(job->config_, &job->pic_);
+}
+
+//------------------------------------------------------------------------------
+
+// Sorts the rendition indices by decreasing area (insertion sort, there are
+// only a few of them). Equal areas keep their order.
+static void SortByDecreasingArea(const RenditionJob* const jobs, int num,
+                                 int order[]) {
+  int i, j;
+  for (i = 0; i < num; ++i) {
+    const uint64_t area = (uint64_t)jobs[i].width_ * jobs[i].height_;
+    for (j = i; j > 0; --j) {
+      const RenditionJob* const prev = &jobs[order[j - 1]];
+      if ((uint64_t)prev->width_ * prev->height_ >= area) break;
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+}
+
+// Produces the picture of 'jobs[order[k]]', from the smallest of the
+// previously produced pictures that is large enough, or from 'pic'.
+static int MakeRenditionPicture(const WebPPicture* const pic,
+                                RenditionJob* const jobs, const int order[],
+                                int k, int* const view_taken) {
+  RenditionJob* const job = &jobs[order[k]];
+  const WebPPicture* src = pic;
+  int j;
+  for (j = k - 1; j >= 0; --j) {
+    const WebPPicture* const prev = &jobs[order[j]].pic_;
+    if (prev->width >= job->width_ && prev->height >= job->height_) {
+      src = prev;
+      break;
+    }
+  }
+  if (src->width == job->width_ && src->height == job->height_) {
+    if (src == pic && !*view_taken) {
+      // The samples are used as is, the encoder allocating its own buffers
+      // if needed.
+      job->pic_ = *pic;
+      job->pic_.memory_ = NULL;
+      job->pic_.memory_argb_ = NULL;
+      *view_taken = 1;
+      return 1;
+    }
+    return WebPPictureCopy(src, &job->pic_);
+  }
+  return WebPPictureRescaleTo(src, job->width_, job->height_, &job->pic_);
+}
+
+int WebPEncodeRenditions(WebPPicture* picture,
+                         const WebPRendition renditions[], int num_renditions,
+                         WebPRenditionWriterFunction writer, void* user_data) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  RenditionJob* jobs = NULL;
+  int* order = NULL;
+  WebPCancelToken* token = NULL;
+  int view_taken = 0;
+  int ok = 0;
+  int i;
+  if (picture == NULL) return 0;
+
+  WebPEncodingSetError(picture, VP8_ENC_OK);
+  if (renditions == NULL || writer == NULL) {
+    return WebPEncodingSetError(picture, VP8_ENC_ERROR_NULL_PARAMETER);
+  }
+  if (num_renditions <= 0) {
+    return WebPEncodingSetError(picture, VP8_ENC_ERROR_INVALID_CONFIGURATION);
+  }
+  if (picture->width <= 0 || picture->height <= 0 ||
+      picture->width > WEBP_MAX_DIMENSION ||
+      picture->height > WEBP_MAX_DIMENSION) {
+    return WebPEncodingSetError(picture, VP8_ENC_ERROR_BAD_DIMENSION);
+  }
+
+  jobs = (RenditionJob*)WebPSafeCalloc(num_renditions, sizeof(*jobs));
+  order = (int*)WebPSafeMalloc(num_renditions, sizeof(*order));
+  // Stops the remaining encodings if the output can't be written.
+  token = WebPCancelTokenNewChild(picture->cancel_token);
+  if (jobs == NULL || order == NULL || token == NULL) {
+    WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    goto End;
+  }
+  for (i = 0; i < num_renditions; ++i) {
+    RenditionJob* const job = &jobs[i];
+    const WebPRendition* const rendition = &renditions[i];
+    worker_interface->Init(&job->worker_);
+    if (rendition->config == NULL) {
+      WebPEncodingSetError(picture, VP8_ENC_ERROR_NULL_PARAMETER);
+      goto End;
+    }
+    if (!WebPValidateConfig(rendition->config)) {
+      WebPEncodingSetError(picture, VP8_ENC_ERROR_INVALID_CONFIGURATION);
+      goto End;
+    }
+    job->config_ = rendition->config;
+    job->width_ = rendition->width;
+    job->height_ = rendition->height;
+    if (!WebPRescalerGetScaledDimensions(picture->width, picture->height,
+                                         &job->width_, &job->height_) ||
+        job->width_ > WEBP_MAX_DIMENSION || job->height_ > WEBP_MAX_DIMENSION) {
+      WebPEncodingSetError(picture, VP8_ENC_ERROR_BAD_DIMENSION);
+      goto End;
+    }
+    WebPMemoryWriterInit(&job->writer_);
+  }
+
+  // All the pictures are produced before any encoding starts: the encoder may
+  // modify its input, which is possibly the source of a smaller rendition.
+  WEBP_TRACE_BEGIN("WebPPictureRescale");
+  SortByDecreasingArea(jobs, num_renditions, order);
+  for (i = 0; i < num_renditions; ++i) {
+    if (!MakeRenditionPicture(picture, jobs, order, i, &view_taken)) break;
+  }
+  WEBP_TRACE_END("WebPPictureRescale");
+  if (i < num_renditions) {
+    WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    goto End;
+  }
+
+  for (i = 0; i < num_renditions; ++i) {
+    RenditionJob* const job = &jobs[i];
+    WebPPicture* const pic = &job->pic_;
+    pic->writer = WebPMemoryWrite;
+    pic->custom_ptr = &job->writer_;
+    pic->stats = renditions[i].stats;
+    pic->extra_info = NULL;
+    pic->cancel_token = token;
+    // Only the last rendition, run by the calling thread, reports progress.
+    if (i + 1 < num_renditions) pic->progress_hook = NULL;
+    job->worker_.data1 = job;
+    job->worker_.hook = EncodeRenditionJob;
+    if (i + 1 < num_renditions && job->config_->thread_level > 0 &&
+        worker_interface->Reset(&job->worker_)) {
+      worker_interface->Launch(&job->worker_);
+      job->launched_ = 1;
+    }
+  }
+
+  // The bitstreams are handed over in order, as soon as they are available.
+  ok = 1;
+  for (i = 0; i < num_renditions; ++i) {
+    RenditionJob* const job = &jobs[i];
+    if (!job->launched_) {
+      if (!ok) continue;   // no need to start it
+      worker_interface->Execute(&job->worker_);
+    }
+    if (!worker_interface->Sync(&job->worker_)) {
+      if (ok) {
+        WebPEncodingSetError(picture, WebPEncodingIsCancelled(picture) ?
+                                          VP8_ENC_ERROR_USER_ABORT :
+                                          job->pic_.error_code);
+      }
+      ok = 0;
+    } else if (ok && !writer(i, job->writer_.mem, job->writer_.size,
+                             &job->pic_, user_data)) {
+      WebPEncodingSetError(picture, VP8_ENC_ERROR_BAD_WRITE);
+      ok = 0;
+    }
+    if (!ok) WebPCancelTokenCancel(token);
+    WebPMemoryWriterClear(&job->writer_);
+  }
+
+ End:
+  if (jobs != NULL) {
+    for (i = 0; i < num_renditions; ++i) {
+      worker_interface->End(&jobs[i].worker_);
+      WebPPictureFree(&jobs[i].pic_);
+      WebPMemoryWriterClear(&jobs[i].writer_);
+    }
+  }
+  WebPCancelTokenDelete(token);
+  WebPSafeFree(order);
+  WebPSafeFree(jobs);
+  return ok;
+}
@@ -354,6 +354,9 @@ int VP8EncWrite(VP8Encoder* const enc) {
     return WebPEncodingSetError(pic, VP8_ENC_ERROR_FILE_TOO_BIG);
   }
 
+  // The total size is known: spare the WebPMemoryWriter its re-allocations.
+  WebPMemoryWriterReserve(pic, CHUNK_HEADER_SIZE + riff_size);
+
   // Emit headers and partition #0
   {
     const uint8_t* const part0 = VP8BitWriterBuf(bw);
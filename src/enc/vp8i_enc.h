@@ -206,6 +206,20 @@ typedef struct {
 
 typedef int8_t DError[2 /* u/v */][2 /* top or left */];
 
+// Window of source samples converted on demand from an ARGB picture, one
+// macroblock row at a time (see VP8RowWindowGet()). Used in low-memory mode
+// instead of converting the whole picture to YUVA beforehand.
+typedef struct {
+  WebPPicture rows_;        // Y/U/V(/A) samples of the current macroblock row.
+                            // The line above 'rows_' is addressable too.
+  int mb_y_;                // macroblock row held in 'rows_' (-1 if none)
+  int exact_;               // if false, clean-up transparent area like
+                            // WebPCleanupTransparentArea() does
+  const WebPPicture* src_;  // source ARGB picture
+  uint16_t* tmp_rgb_;       // scratch area for U/V averaging
+  uint8_t* mem_;            // memory for all of the above
+} VP8RowWindow;
+
 // Handy transient struct to accumulate score and info during RD-optimization
 // and mode evaluation.
 typedef struct {
@@ -250,6 +264,7 @@ typedef struct {
 
   DError        left_derr_;        // left error diffusion (u/v)
   DError*       top_derr_;         // top diffusion error - NULL if disabled
+  VP8RowWindow* rows_;             // source window - NULL to use enc_->pic_
 
   uint8_t* y_left_;    // left luma samples (addressable from index -1 to 15).
   uint8_t* u_left_;    // left u samples (addressable from index -1 to 7)
@@ -411,6 +426,7 @@ struct VP8Encoder {
                          // U and V are packed into 16 bytes (8 U + 8 V)
   LFStats*   lf_stats_;  // autofilter stats (if NULL, autofilter is off)
   DError*    top_derr_;  // diffusion error (NULL if disabled)
+  VP8RowWindow* rows_;   // on-demand ARGB conversion (NULL if disabled)
 };
 
 //------------------------------------------------------------------------------
@@ -462,6 +478,22 @@ int WebPEncodingSetError(const WebPPicture* const pic, WebPEncodingError error);
 int WebPReportProgress(const WebPPicture* const pic,
                        int percent, int* const percent_store);
 
+  // in cancel_enc.c
+// Returns true if the picture's cancel_token has been triggered. Cheap enough
+// to be polled regularly from the lengthy loops, including in worker threads.
+int WebPEncodingIsCancelled(const WebPPicture* const pic);
+// Returns a new token, also cancelled when 'parent' (possibly NULL) is.
+WebPCancelToken* WebPCancelTokenNewChild(WebPCancelToken* const parent);
+// Sets the size in bytes beyond which the bitstream being produced for the
+// pictures using 'token' is not wanted anymore (0 for no limit). This function
+// can be called from any thread.
+void WebPCancelTokenSetSizeLimit(WebPCancelToken* const token, size_t size);
+// Returns the size limit set for the picture's cancel_token, or 0.
+size_t WebPEncodingSizeLimit(const WebPPicture* const pic);
+// Returns false, and cancels the picture's token, if 'size' (the size of the
+// bitstream produced so far, or an estimate of it) exceeds its size limit.
+int WebPEncodingCheckSize(const WebPPicture* const pic, size_t size);
+
   // in analysis.c
 // Main analysis loop. Decides the segmentations and complexity.
 // Assigns a first guess for Intra16 and uvmode_ prediction modes.
@@ -505,10 +537,39 @@ int WebPPictureAllocARGB(WebPPicture* const picture, int width, int height);
 // Returns false in case of error (invalid param, out-of-memory).
 int WebPPictureAllocYUVA(WebPPicture* const picture, int width, int height);
 
+// Computes the gamma tables used by the RGB->YUV conversions, if not done yet.
+void WebPInitGammaTables(void);
+
 // Clean-up the RGB samples under fully transparent area, to help lossless
 // compressibility (no guarantee, though). Assumes that pic->use_argb is true.
 void WebPCleanupTransparentAreaLossless(WebPPicture* const pic);
 
+// Same as WebPPictureRescale() but stores the result in 'dst', which gets the
+// specs of 'src' and its own buffer. 'src' is left untouched. 'width' and
+// 'height' must be positive. Returns false in case of memory error.
+int WebPPictureRescaleTo(const WebPPicture* const src, int width, int height,
+                         WebPPicture* const dst);
+
+// If 'picture' outputs through WebPMemoryWrite(), makes room for 'size' more
+// bytes in its WebPMemoryWriter so that the coming writes don't re-allocate.
+void WebPMemoryWriterReserve(const WebPPicture* const picture, size_t size);
+// If 'picture' outputs through WebPMemoryWrite() and nothing was written yet,
+// hands the complete bitstream 'data' over to the WebPMemoryWriter instead of
+// copying it, and returns true. 'data' must come from WebPSafeMalloc() and is
+// owned by the writer afterward. Returns false otherwise ('data' untouched).
+int WebPMemoryWriterAdopt(const WebPPicture* const picture,
+                          uint8_t* const data, size_t data_size);
+
+// Prepares 'win' for converting the rows of the ARGB picture 'src' on demand.
+// 'has_alpha' must be true if 'src' has some transparency. Returns false
+// in case of memory error.
+int VP8RowWindowInit(VP8RowWindow* const win, const WebPPicture* const src,
+                     int has_alpha, int exact);
+void VP8RowWindowClear(VP8RowWindow* const win);
+// Returns the YUVA samples of the macroblock row 'mb_y', converting them if
+// needed. Rows are cheaper to get in increasing order.
+const WebPPicture* VP8RowWindowGet(VP8RowWindow* const win, int mb_y);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus
@@ -23,6 +23,7 @@
 #include "src/dsp/lossless_common.h"
 #include "src/utils/bit_writer_utils.h"
 #include "src/utils/huffman_encode_utils.h"
+#include "src/utils/trace_utils.h"
 #include "src/utils/utils.h"
 #include "src/webp/format_constants.h"
 
@@ -363,6 +364,145 @@ typedef struct {
 
 #define CRUNCH_CONFIGS_MAX kNumEntropyIx
 
+// -----------------------------------------------------------------------------
+// Bands: with config->thread_level > 1, the predictor and cross-color
+// transforms and the search of the LZ77 matches are performed concurrently on
+// horizontal bands of the image. The rest of the encoding (LZ77 parsing,
+// histograms, entropy codes) is common to the whole image, so that a single
+// standard bitstream is still produced.
+
+// Minimum height of a band. Each band re-hashes the rows above it and has its
+// own statistics, which costs some compression on small images.
+#define MIN_BAND_ROWS 256
+// Number of rows above a band in which matches are also searched.
+#define BAND_OVERLAP_ROWS 64
+
+typedef struct {
+  WebPWorker worker_;
+  int width_, height_;         // dimensions of the whole image
+  int first_row_, last_row_;   // rows of the band
+  int bits_;                   // transform bits
+  int quality_, low_effort_;
+  uint32_t* argb_;
+  uint32_t* argb_scratch_;     // scratch rows of this band
+  uint32_t* transform_data_;
+  // Predictor transform.
+  int near_lossless_, exact_, used_subtract_green_;
+  // LZ77 matches search.
+  VP8LHashChain* hash_chain_;
+  const WebPPicture* pic_;
+} BandJob;
+
+// Bands only pay off when they actually run in parallel: their number is
+// limited by the number of CPUs.
+static int GetNumBands(const WebPConfig* const config, int height) {
+  const int num_cpus = WebPGetNumCPUs();
+  int num_bands = config->thread_level;
+  if (num_bands > MAX_LOSSLESS_BANDS) num_bands = MAX_LOSSLESS_BANDS;
+  if (num_bands > num_cpus) num_bands = num_cpus;
+  if (num_bands > height / MIN_BAND_ROWS) num_bands = height / MIN_BAND_ROWS;
+  return (num_bands > 1) ? num_bands : 1;
+}
+
+// Splits the rows of the image into 'num_bands' bands made of whole rows of
+// tiles of size 1 << bits.
+static void SetupBands(BandJob jobs[], int num_bands, int bits,
+                       int width, int height, int quality, int low_effort) {
+  const int tile_rows = VP8LSubSampleSize(height, bits);
+  int b;
+  assert(num_bands >= 1 && num_bands <= tile_rows);
+  for (b = 0; b < num_bands; ++b) {
+    BandJob* const job = &jobs[b];
+    const int last_row = (tile_rows * (b + 1) / num_bands) << bits;
+    memset(job, 0, sizeof(*job));
+    job->width_ = width;
+    job->height_ = height;
+    job->first_row_ = (tile_rows * b / num_bands) << bits;
+    job->last_row_ = (last_row < height) ? last_row : height;
+    job->bits_ = bits;
+    job->quality_ = quality;
+    job->low_effort_ = low_effort;
+  }
+}
+
+// Calls 'hook' on all the bands, the last one in the calling thread, and
+// returns false if any call failed.
+static int ProcessBands(BandJob jobs[], int num_bands, WebPWorkerHook hook) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  int ok = 1;
+  int b;
+  for (b = 0; b < num_bands; ++b) {
+    WebPWorker* const worker = &jobs[b].worker_;
+    worker_interface->Init(worker);
+    worker->hook = hook;
+    worker->data1 = &jobs[b];
+    worker->data2 = NULL;
+    if (b + 1 < num_bands && worker_interface->Reset(worker)) {
+      worker_interface->Launch(worker);
+    } else {
+      worker_interface->Execute(worker);
+    }
+  }
+  for (b = 0; b < num_bands; ++b) {
+    ok &= worker_interface->Sync(&jobs[b].worker_);
+    worker_interface->End(&jobs[b].worker_);
+  }
+  return ok;
+}
+
+static int PredictorModesBandHook(void* arg1, void* arg2) {
+  const BandJob* const job = (const BandJob*)arg1;
+  (void)arg2;
+  VP8LGetPredictorModes(job->width_, job->height_, job->bits_,
+                        job->first_row_ >> job->bits_,
+                        VP8LSubSampleSize(job->last_row_, job->bits_),
+                        job->argb_, job->argb_scratch_, job->transform_data_,
+                        job->near_lossless_, job->exact_,
+                        job->used_subtract_green_);
+  return 1;
+}
+
+static int CrossColorBandHook(void* arg1, void* arg2) {
+  const BandJob* const job = (const BandJob*)arg1;
+  const int tile_xsize = VP8LSubSampleSize(job->width_, job->bits_);
+  (void)arg2;
+  VP8LColorSpaceTransform(
+      job->width_, job->last_row_ - job->first_row_, job->bits_, job->quality_,
+      job->argb_ + job->first_row_ * job->width_,
+      job->transform_data_ + (job->first_row_ >> job->bits_) * tile_xsize);
+  return 1;
+}
+
+static int HashChainBandHook(void* arg1, void* arg2) {
+  const BandJob* const job = (const BandJob*)arg1;
+  (void)arg2;
+  return VP8LHashChainFillRows(job->hash_chain_, job->quality_, job->argb_,
+                               job->width_, job->first_row_, job->last_row_,
+                               BAND_OVERLAP_ROWS, job->low_effort_, job->pic_);
+}
+
+// Fills 'hash_chain' for the whole image, by bands if 'num_bands' > 1.
+static int HashChainFill(VP8LHashChain* const hash_chain, int quality,
+                         const uint32_t* const argb, int width, int height,
+                         int low_effort, int num_bands,
+                         const WebPPicture* const pic) {
+  BandJob jobs[MAX_LOSSLESS_BANDS];
+  int b;
+  if (num_bands <= 1) {
+    return VP8LHashChainFill(hash_chain, quality, argb, width, height,
+                             low_effort, pic);
+  }
+  SetupBands(jobs, num_bands, 0, width, height, quality, low_effort);
+  for (b = 0; b < num_bands; ++b) {
+    jobs[b].argb_ = (uint32_t*)argb;   // cast const away, only read
+    jobs[b].hash_chain_ = hash_chain;
+    jobs[b].pic_ = pic;
+  }
+  return ProcessBands(jobs, num_bands, HashChainBandHook);
+}
+
+// -----------------------------------------------------------------------------
+
 static int EncoderAnalyze(VP8LEncoder* const enc,
                           CrunchConfig crunch_configs[CRUNCH_CONFIGS_MAX],
                           int* const crunch_configs_size,
@@ -386,6 +526,7 @@ static int EncoderAnalyze(VP8LEncoder* const enc,
   enc->histo_bits_ = GetHistoBits(method, use_palette,
                                   pic->width, pic->height);
   enc->transform_bits_ = GetTransformBits(method, enc->histo_bits_);
+  enc->num_bands_ = GetNumBands(config, height);
 
   if (low_effort) {
     // AnalyzeEntropy is somewhat slow.
@@ -708,11 +849,14 @@ static WEBP_INLINE void WriteHuffmanCodeWithExtraBits(
   VP8LPutBits(bw, (bits << depth) | symbol, depth + n_bits);
 }
 
+// If 'pic' is not NULL, the size written so far is checked against its size
+// limit (see WebPEncodingCheckSize()) every few thousand references.
 static WebPEncodingError StoreImageToBitMask(
     VP8LBitWriter* const bw, int width, int histo_bits,
     const VP8LBackwardRefs* const refs,
     const uint16_t* histogram_symbols,
-    const HuffmanTreeCode* const huffman_codes) {
+    const HuffmanTreeCode* const huffman_codes,
+    const WebPPicture* const pic) {
   const int histo_xsize = histo_bits ? VP8LSubSampleSize(width, histo_bits) : 1;
   const int tile_mask = (histo_bits == 0) ? 0 : -(1 << histo_bits);
   // x and y trace the position in the image.
@@ -722,9 +866,14 @@ static WebPEncodingError StoreImageToBitMask(
   int tile_y = y & tile_mask;
   int histogram_ix = histogram_symbols[0];
   const HuffmanTreeCode* codes = huffman_codes + 5 * histogram_ix;
+  int count = 0;
   VP8LRefsCursor c = VP8LRefsCursorInit(refs);
   while (VP8LRefsCursorOk(&c)) {
     const PixOrCopy* const v = c.cur_pos;
+    if (pic != NULL && (count++ & 4095) == 0 &&
+        !WebPEncodingCheckSize(pic, VP8LBitWriterNumBytes(bw))) {
+      return VP8_ENC_ERROR_USER_ABORT;
+    }
     if ((tile_x != (x & tile_mask)) || (tile_y != (y & tile_mask))) {
       tile_x = x & tile_mask;
       tile_y = y & tile_mask;
@@ -775,7 +924,8 @@ static WebPEncodingError EncodeImageNoHuffman(VP8LBitWriter* const bw,
                                               VP8LBackwardRefs* const refs_tmp1,
                                               VP8LBackwardRefs* const refs_tmp2,
                                               int width, int height,
-                                              int quality, int low_effort) {
+                                              int quality, int low_effort,
+                                              const WebPPicture* const pic) {
   int i;
   int max_tokens = 0;
   WebPEncodingError err = VP8_ENC_OK;
@@ -794,13 +944,13 @@ static WebPEncodingError EncodeImageNoHuffman(VP8LBitWriter* const bw,
 
   // Calculate backward references from ARGB image.
   if (!VP8LHashChainFill(hash_chain, quality, argb, width, height,
-                         low_effort)) {
+                         low_effort, pic)) {
     err = VP8_ENC_ERROR_OUT_OF_MEMORY;
     goto Error;
   }
   refs = VP8LGetBackwardReferences(width, height, argb, quality, 0,
                                    kLZ77Standard | kLZ77RLE, &cache_bits,
-                                   hash_chain, refs_tmp1, refs_tmp2);
+                                   hash_chain, refs_tmp1, refs_tmp2, pic);
   if (refs == NULL) {
     err = VP8_ENC_ERROR_OUT_OF_MEMORY;
     goto Error;
@@ -848,7 +998,7 @@ static WebPEncodingError EncodeImageNoHuffman(VP8LBitWriter* const bw,
 
   // Store actual literals.
   err = StoreImageToBitMask(bw, width, 0, refs, histogram_symbols,
-                            huffman_codes);
+                            huffman_codes, NULL);
 
  Error:
   WebPSafeFree(tokens);
@@ -861,9 +1011,10 @@ static WebPEncodingError EncodeImageNoHuffman(VP8LBitWriter* const bw,
 static WebPEncodingError EncodeImageInternal(
     VP8LBitWriter* const bw, const uint32_t* const argb,
     VP8LHashChain* const hash_chain, VP8LBackwardRefs refs_array[3], int width,
-    int height, int quality, int low_effort, int use_cache,
+    int height, int quality, int low_effort, int use_cache, int num_bands,
     const CrunchConfig* const config, int* cache_bits, int histogram_bits,
-    size_t init_byte_position, int* const hdr_size, int* const data_size) {
+    size_t init_byte_position, int* const hdr_size, int* const data_size,
+    int stop_early, const WebPPicture* const pic) {
   WebPEncodingError err = VP8_ENC_OK;
   const uint32_t histogram_image_xysize =
       VP8LSubSampleSize(width, histogram_bits) *
@@ -884,12 +1035,14 @@ static WebPEncodingError EncodeImageInternal(
   int lz77s_idx;
   VP8LBitWriter bw_init = *bw, bw_best;
   int hdr_size_tmp;
+  int ok;
   assert(histogram_bits >= MIN_HUFFMAN_BITS);
   assert(histogram_bits <= MAX_HUFFMAN_BITS);
   assert(hdr_size != NULL);
   assert(data_size != NULL);
 
-  if (histogram_symbols == NULL) {
+  // Initialize 'bw_best' first: it is wiped out upon any error below.
+  if (!VP8LBitWriterInit(&bw_best, 0) || histogram_symbols == NULL) {
     err = VP8_ENC_ERROR_OUT_OF_MEMORY;
     goto Error;
   }
@@ -905,20 +1058,27 @@ static WebPEncodingError EncodeImageInternal(
   // of refs_array[0] or refs_array[1].
   // Calculate backward references from ARGB image.
   if (huff_tree == NULL ||
-      !VP8LHashChainFill(hash_chain, quality, argb, width, height,
-                         low_effort) ||
-      !VP8LBitWriterInit(&bw_best, 0) ||
       (config->lz77s_types_to_try_size_ > 1 &&
        !VP8LBitWriterClone(bw, &bw_best))) {
     err = VP8_ENC_ERROR_OUT_OF_MEMORY;
     goto Error;
   }
+  WEBP_TRACE_BEGIN("VP8LHashChainFill");
+  ok = HashChainFill(hash_chain, quality, argb, width, height, low_effort,
+                     num_bands, pic);
+  WEBP_TRACE_END("VP8LHashChainFill");
+  if (!ok) {
+    err = VP8_ENC_ERROR_OUT_OF_MEMORY;
+    goto Error;
+  }
   for (lz77s_idx = 0; lz77s_idx < config->lz77s_types_to_try_size_;
        ++lz77s_idx) {
+    WEBP_TRACE_BEGIN("VP8LGetBackwardReferences");
     refs_best = VP8LGetBackwardReferences(
         width, height, argb, quality, low_effort,
         config->lz77s_types_to_try_[lz77s_idx], cache_bits, hash_chain,
-        &refs_array[0], &refs_array[1]);
+        &refs_array[0], &refs_array[1], pic);
+    WEBP_TRACE_END("VP8LGetBackwardReferences");
     if (refs_best == NULL) {
       err = VP8_ENC_ERROR_OUT_OF_MEMORY;
       goto Error;
@@ -936,9 +1096,12 @@ static WebPEncodingError EncodeImageInternal(
     }
 
     // Build histogram image and symbols from backward references.
-    if (!VP8LGetHistoImageSymbols(width, height, refs_best, quality, low_effort,
+    WEBP_TRACE_BEGIN("VP8LGetHistoImageSymbols");
+    ok = VP8LGetHistoImageSymbols(width, height, refs_best, quality, low_effort,
                                   histogram_bits, *cache_bits, histogram_image,
-                                  tmp_histo, histogram_symbols)) {
+                                  tmp_histo, histogram_symbols, pic);
+    WEBP_TRACE_END("VP8LGetHistoImageSymbols");
+    if (!ok) {
       err = VP8_ENC_ERROR_OUT_OF_MEMORY;
       goto Error;
     }
@@ -997,7 +1160,8 @@ static WebPEncodingError EncodeImageInternal(
         err = EncodeImageNoHuffman(
             bw, histogram_argb, hash_chain, refs_tmp, &refs_array[2],
             VP8LSubSampleSize(width, histogram_bits),
-            VP8LSubSampleSize(height, histogram_bits), quality, low_effort);
+            VP8LSubSampleSize(height, histogram_bits), quality, low_effort,
+            pic);
         WebPSafeFree(histogram_argb);
         if (err != VP8_ENC_OK) goto Error;
       }
@@ -1027,8 +1191,10 @@ static WebPEncodingError EncodeImageInternal(
     }
     // Store actual literals.
     hdr_size_tmp = (int)(VP8LBitWriterNumBytes(bw) - init_byte_position);
-    err = StoreImageToBitMask(bw, width, histogram_bits, refs_best,
-                              histogram_symbols, huffman_codes);
+    // The size can only be checked if this is the only bitstream produced.
+    err = StoreImageToBitMask(
+        bw, width, histogram_bits, refs_best, histogram_symbols, huffman_codes,
+        (stop_early && config->lz77s_types_to_try_size_ == 1) ? pic : NULL);
     // Keep track of the smallest image so far.
     if (lz77s_idx == 0 ||
         VP8LBitWriterNumBytes(bw) < VP8LBitWriterNumBytes(&bw_best)) {
@@ -1073,6 +1239,17 @@ static void ApplySubtractGreen(VP8LEncoder* const enc, int width, int height,
   VP8LSubtractGreenFromBlueAndRed(enc->argb_, width * height);
 }
 
+// Returns the size in words of the argb scratch memory of one band.
+static uint64_t GetArgbScratchSize(const VP8LEncoder* const enc, int width) {
+  // VP8LResidualImage needs room for 2 scanlines of uint32 pixels with an extra
+  // pixel in each, plus 2 regular scanlines of bytes.
+  // TODO(skal): Clean up by using arithmetic in bytes instead of words.
+  return enc->use_predict_
+             ? (width + 1) * 2 +
+               (width * 2 + sizeof(uint32_t) - 1) / sizeof(uint32_t)
+             : 0;
+}
+
 static WebPEncodingError ApplyPredictFilter(const VP8LEncoder* const enc,
                                             int width, int height,
                                             int quality, int low_effort,
@@ -1085,10 +1262,33 @@ static WebPEncodingError ApplyPredictFilter(const VP8LEncoder* const enc,
   const int near_lossless_strength = enc->use_palette_ ? 100
                                    : enc->config_->near_lossless;
 
-  VP8LResidualImage(width, height, pred_bits, low_effort, enc->argb_,
-                    enc->argb_scratch_, enc->transform_data_,
-                    near_lossless_strength, enc->config_->exact,
-                    used_subtract_green);
+  WEBP_TRACE_BEGIN("VP8LResidualImage");
+  if (enc->num_bands_ > 1 && !low_effort) {
+    BandJob jobs[MAX_LOSSLESS_BANDS];
+    int b;
+    SetupBands(jobs, enc->num_bands_, pred_bits, width, height, quality,
+               low_effort);
+    for (b = 0; b < enc->num_bands_; ++b) {
+      jobs[b].argb_ = enc->argb_;
+      jobs[b].argb_scratch_ =
+          enc->argb_scratch_ + b * GetArgbScratchSize(enc, width);
+      jobs[b].transform_data_ = enc->transform_data_;
+      jobs[b].near_lossless_ = near_lossless_strength;
+      jobs[b].exact_ = enc->config_->exact;
+      jobs[b].used_subtract_green_ = used_subtract_green;
+    }
+    ProcessBands(jobs, enc->num_bands_, PredictorModesBandHook);
+    VP8LApplyPredictors(width, height, pred_bits, low_effort, enc->argb_,
+                        enc->argb_scratch_, enc->transform_data_,
+                        near_lossless_strength, enc->config_->exact,
+                        used_subtract_green);
+  } else {
+    VP8LResidualImage(width, height, pred_bits, low_effort, enc->argb_,
+                      enc->argb_scratch_, enc->transform_data_,
+                      near_lossless_strength, enc->config_->exact,
+                      used_subtract_green);
+  }
+  WEBP_TRACE_END("VP8LResidualImage");
   VP8LPutBits(bw, TRANSFORM_PRESENT, 1);
   VP8LPutBits(bw, PREDICTOR_TRANSFORM, 2);
   assert(pred_bits >= 2);
@@ -1097,7 +1297,7 @@ static WebPEncodingError ApplyPredictFilter(const VP8LEncoder* const enc,
       bw, enc->transform_data_, (VP8LHashChain*)&enc->hash_chain_,
       (VP8LBackwardRefs*)&enc->refs_[0],  // cast const away
       (VP8LBackwardRefs*)&enc->refs_[1], transform_width, transform_height,
-      quality, low_effort);
+      quality, low_effort, enc->pic_);
 }
 
 static WebPEncodingError ApplyCrossColorFilter(const VP8LEncoder* const enc,
@@ -1108,8 +1308,22 @@ static WebPEncodingError ApplyCrossColorFilter(const VP8LEncoder* const enc,
   const int transform_width = VP8LSubSampleSize(width, ccolor_transform_bits);
   const int transform_height = VP8LSubSampleSize(height, ccolor_transform_bits);
 
-  VP8LColorSpaceTransform(width, height, ccolor_transform_bits, quality,
-                          enc->argb_, enc->transform_data_);
+  WEBP_TRACE_BEGIN("VP8LColorSpaceTransform");
+  if (enc->num_bands_ > 1) {
+    BandJob jobs[MAX_LOSSLESS_BANDS];
+    int b;
+    SetupBands(jobs, enc->num_bands_, ccolor_transform_bits, width, height,
+               quality, low_effort);
+    for (b = 0; b < enc->num_bands_; ++b) {
+      jobs[b].argb_ = enc->argb_;
+      jobs[b].transform_data_ = enc->transform_data_;
+    }
+    ProcessBands(jobs, enc->num_bands_, CrossColorBandHook);
+  } else {
+    VP8LColorSpaceTransform(width, height, ccolor_transform_bits, quality,
+                            enc->argb_, enc->transform_data_);
+  }
+  WEBP_TRACE_END("VP8LColorSpaceTransform");
   VP8LPutBits(bw, TRANSFORM_PRESENT, 1);
   VP8LPutBits(bw, CROSS_COLOR_TRANSFORM, 2);
   assert(ccolor_transform_bits >= 2);
@@ -1118,23 +1332,33 @@ static WebPEncodingError ApplyCrossColorFilter(const VP8LEncoder* const enc,
       bw, enc->transform_data_, (VP8LHashChain*)&enc->hash_chain_,
       (VP8LBackwardRefs*)&enc->refs_[0],  // cast const away
       (VP8LBackwardRefs*)&enc->refs_[1], transform_width, transform_height,
-      quality, low_effort);
+      quality, low_effort, enc->pic_);
 }
 
 // -----------------------------------------------------------------------------
 
-static WebPEncodingError WriteRiffHeader(const WebPPicture* const pic,
-                                         size_t riff_size, size_t vp8l_size) {
-  uint8_t riff[RIFF_HEADER_SIZE + CHUNK_HEADER_SIZE + VP8L_SIGNATURE_SIZE] = {
+// The RIFF header is reserved at the beginning of the bitstream and filled-in
+// at the end, so that the whole output is a single buffer, which a
+// WebPMemoryWriter can take over without copying it.
+#define LOSSLESS_RIFF_HEADER_SIZE \
+    (RIFF_HEADER_SIZE + CHUNK_HEADER_SIZE + VP8L_SIGNATURE_SIZE)
+
+static int ReserveRiffHeader(VP8LBitWriter* const bw) {
+  int i;
+  assert(VP8LBitWriterNumBytes(bw) == 0);
+  for (i = 0; i < LOSSLESS_RIFF_HEADER_SIZE; ++i) VP8LPutBits(bw, 0, 8);
+  return !bw->error_;
+}
+
+static void PutRiffHeader(uint8_t* const dst,
+                          size_t riff_size, size_t vp8l_size) {
+  static const uint8_t kRiff[LOSSLESS_RIFF_HEADER_SIZE] = {
     'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'E', 'B', 'P',
     'V', 'P', '8', 'L', 0, 0, 0, 0, VP8L_MAGIC_BYTE,
   };
-  PutLE32(riff + TAG_SIZE, (uint32_t)riff_size);
-  PutLE32(riff + RIFF_HEADER_SIZE + TAG_SIZE, (uint32_t)vp8l_size);
-  if (!pic->writer(riff, sizeof(riff), pic)) {
-    return VP8_ENC_ERROR_BAD_WRITE;
-  }
-  return VP8_ENC_OK;
+  memcpy(dst, kRiff, sizeof(kRiff));
+  PutLE32(dst + TAG_SIZE, (uint32_t)riff_size);
+  PutLE32(dst + RIFF_HEADER_SIZE + TAG_SIZE, (uint32_t)vp8l_size);
 }
 
 static int WriteImageSize(const WebPPicture* const pic,
@@ -1157,33 +1381,28 @@ static int WriteRealAlphaAndVersion(VP8LBitWriter* const bw, int has_alpha) {
 static WebPEncodingError WriteImage(const WebPPicture* const pic,
                                     VP8LBitWriter* const bw,
                                     size_t* const coded_size) {
-  WebPEncodingError err = VP8_ENC_OK;
-  const uint8_t* const webpll_data = VP8LBitWriterFinish(bw);
-  const size_t webpll_size = VP8LBitWriterNumBytes(bw);
+  const size_t webpll_size =
+      VP8LBitWriterNumBytes(bw) - LOSSLESS_RIFF_HEADER_SIZE;
   const size_t vp8l_size = VP8L_SIGNATURE_SIZE + webpll_size;
   const size_t pad = vp8l_size & 1;
   const size_t riff_size = TAG_SIZE + CHUNK_HEADER_SIZE + vp8l_size + pad;
-
-  err = WriteRiffHeader(pic, riff_size, vp8l_size);
-  if (err != VP8_ENC_OK) goto Error;
-
-  if (!pic->writer(webpll_data, webpll_size, pic)) {
-    err = VP8_ENC_ERROR_BAD_WRITE;
-    goto Error;
-  }
-
-  if (pad) {
-    const uint8_t pad_byte[1] = { 0 };
-    if (!pic->writer(pad_byte, 1, pic)) {
-      err = VP8_ENC_ERROR_BAD_WRITE;
-      goto Error;
-    }
+  uint8_t* data;
+  size_t data_size;
+
+  if (pad) VP8LPutBits(bw, 0, 8);
+  data = VP8LBitWriterFinish(bw);
+  if (bw->error_) return VP8_ENC_ERROR_OUT_OF_MEMORY;
+  data_size = VP8LBitWriterNumBytes(bw);
+  assert(data_size == CHUNK_HEADER_SIZE + riff_size);
+  PutRiffHeader(data, riff_size, vp8l_size);
+
+  if (WebPMemoryWriterAdopt(pic, data, data_size)) {
+    memset(bw, 0, sizeof(*bw));   // the buffer is now owned by the writer
+  } else if (!pic->writer(data, data_size, pic)) {
+    return VP8_ENC_ERROR_BAD_WRITE;
   }
-  *coded_size = CHUNK_HEADER_SIZE + riff_size;
+  *coded_size = data_size;
   return VP8_ENC_OK;
-
- Error:
-  return err;
 }
 
 // -----------------------------------------------------------------------------
@@ -1195,22 +1414,16 @@ static void ClearTransformBuffer(VP8LEncoder* const enc) {
 }
 
 // Allocates the memory for argb (W x H) buffer, 2 rows of context for
-// prediction and transform data.
+// prediction (for each band) and transform data.
 // Flags influencing the memory allocated:
-//  enc->transform_bits_
+//  enc->transform_bits_, enc->num_bands_
 //  enc->use_predict_, enc->use_cross_color_
 static WebPEncodingError AllocateTransformBuffer(VP8LEncoder* const enc,
                                                  int width, int height) {
   WebPEncodingError err = VP8_ENC_OK;
   const uint64_t image_size = width * height;
-  // VP8LResidualImage needs room for 2 scanlines of uint32 pixels with an extra
-  // pixel in each, plus 2 regular scanlines of bytes.
-  // TODO(skal): Clean up by using arithmetic in bytes instead of words.
   const uint64_t argb_scratch_size =
-      enc->use_predict_
-          ? (width + 1) * 2 +
-            (width * 2 + sizeof(uint32_t) - 1) / sizeof(uint32_t)
-          : 0;
+      GetArgbScratchSize(enc, width) * enc->num_bands_;
   const uint64_t transform_data_size =
       (enc->use_predict_ || enc->use_cross_color_)
           ? VP8LSubSampleSize(width, enc->transform_bits_) *
@@ -1465,7 +1678,7 @@ static WebPEncodingError EncodePalette(VP8LBitWriter* const bw, int low_effort,
   tmp_palette[0] = palette[0];
   return EncodeImageNoHuffman(bw, tmp_palette, &enc->hash_chain_,
                               &enc->refs_[0], &enc->refs_[1], palette_size, 1,
-                              20 /* quality */, low_effort);
+                              20 /* quality */, low_effort, enc->pic_);
 }
 
 // -----------------------------------------------------------------------------
@@ -1509,6 +1722,7 @@ typedef struct {
   CrunchConfig crunch_configs_[CRUNCH_CONFIGS_MAX];
   int num_crunch_configs_;
   int red_and_blue_always_zero_;
+  int stop_early_;        // true if there is a single crunch config in total
   WebPEncodingError err_;
   WebPAuxStats* stats_;
 } StreamEncodeContext;
@@ -1632,11 +1846,14 @@ static int EncodeStreamHook(void* input, void* data2) {
 
     // -------------------------------------------------------------------------
     // Encode and write the transformed image.
+    WEBP_TRACE_BEGIN("EncodeImageInternal");
     err = EncodeImageInternal(bw, enc->argb_, &enc->hash_chain_, enc->refs_,
                               enc->current_width_, height, quality, low_effort,
-                              use_cache, &crunch_configs[idx],
+                              use_cache, enc->num_bands_, &crunch_configs[idx],
                               &enc->cache_bits_, enc->histo_bits_,
-                              byte_position, &hdr_size, &data_size);
+                              byte_position, &hdr_size, &data_size,
+                              params->stop_early_, picture);
+    WEBP_TRACE_END("EncodeImageInternal");
     if (err != VP8_ENC_OK) goto Error;
 
     // If we are better than what we already have.
@@ -1730,6 +1947,8 @@ WebPEncodingError VP8LEncodeStream(const WebPConfig* const config,
       param->picture_ = picture;
       param->use_cache_ = use_cache;
       param->red_and_blue_always_zero_ = red_and_blue_always_zero;
+      param->stop_early_ =
+          (num_crunch_configs_main + num_crunch_configs_side == 1);
       if (idx == 0) {
         param->stats_ = picture->stats;
         param->bw_ = bw_main;
@@ -1751,6 +1970,7 @@ WebPEncodingError VP8LEncodeStream(const WebPConfig* const config,
         // Copy the values that were computed for the main encoder.
         enc_side->histo_bits_ = enc_main->histo_bits_;
         enc_side->transform_bits_ = enc_main->transform_bits_;
+        enc_side->num_bands_ = enc_main->num_bands_;
         enc_side->palette_size_ = enc_main->palette_size_;
         memcpy(enc_side->palette_, enc_main->palette_,
                sizeof(enc_main->palette_));
@@ -1863,8 +2083,8 @@ int VP8LEncodeImage(const WebPConfig* const config,
     stats->PSNR[4] = 99.f;
   }
 
-  // Write image size.
-  if (!WriteImageSize(picture, &bw)) {
+  // Write image size, after the room for the RIFF header.
+  if (!ReserveRiffHeader(&bw) || !WriteImageSize(picture, &bw)) {
     err = VP8_ENC_ERROR_OUT_OF_MEMORY;
     goto Error;
   }
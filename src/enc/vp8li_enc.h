@@ -35,6 +35,8 @@ extern "C" {
 
 // maximum value of transform_bits_ in VP8LEncoder.
 #define MAX_TRANSFORM_BITS 6
+// maximum value of num_bands_ in VP8LEncoder (and of config->thread_level).
+#define MAX_LOSSLESS_BANDS 32
 
 typedef enum {
   kEncoderNone = 0,
@@ -61,6 +63,7 @@ typedef struct {
   int histo_bits_;
   int transform_bits_;    // <= MAX_TRANSFORM_BITS.
   int cache_bits_;        // If equal to 0, don't use color cache.
+  int num_bands_;         // Number of horizontal bands processed concurrently.
 
   // Encoding parameters derived from image characteristics.
   int use_cross_color_;
@@ -106,6 +109,23 @@ void VP8LResidualImage(int width, int height, int bits, int low_effort,
                        uint32_t* const image, int near_lossless, int exact,
                        int used_subtract_green);
 
+// The two steps of VP8LResidualImage(), for images processed in bands.
+// VP8LGetPredictorModes() stores in 'image' the best predictor of the tiles of
+// the rows [tile_y_start, tile_y_end). Only these tiles are used for the
+// statistics and neighboring modes, and 'argb' is left untouched, so that
+// several bands can be processed concurrently (with their own 'argb_scratch').
+// VP8LApplyPredictors() then converts the whole image to residuals.
+void VP8LGetPredictorModes(int width, int height, int bits,
+                           int tile_y_start, int tile_y_end,
+                           const uint32_t* const argb,
+                           uint32_t* const argb_scratch,
+                           uint32_t* const image, int near_lossless,
+                           int exact, int used_subtract_green);
+void VP8LApplyPredictors(int width, int height, int bits, int low_effort,
+                         uint32_t* const argb, uint32_t* const argb_scratch,
+                         uint32_t* const image, int near_lossless, int exact,
+                         int used_subtract_green);
+
 void VP8LColorSpaceTransform_C(int width, int height, int bits, int quality,
                                uint32_t* const argb, uint32_t* image);
 
@@ -19,6 +19,8 @@
 #include "src/enc/cost_enc.h"
 #include "src/enc/vp8i_enc.h"
 #include "src/enc/vp8li_enc.h"
+#include "src/dsp/lossless.h"
+#include "src/utils/trace_utils.h"
 #include "src/utils/utils.h"
 
 // #define PRINT_MEMORY_INFO
@@ -33,6 +35,34 @@ int WebPGetEncoderVersion(void) {
   return (ENC_MAJ_VERSION << 16) | (ENC_MIN_VERSION << 8) | ENC_REV_VERSION;
 }
 
+//------------------------------------------------------------------------------
+// One-time initialization
+
+static WEBP_TSAN_IGNORE_FUNCTION void InitEncoderOnce(void) {
+  VP8EncDspInit();
+  VP8EncDspCostInit();
+  VP8LEncDspInit();
+  VP8LDspInit();
+  VP8SSIMDspInit();
+  VP8FiltersInit();
+  WebPInitAlphaProcessing();
+  WebPInitConvertARGBToYUV();
+  WebPRescalerDspInit();
+  WebPInitGammaTables();
+}
+
+#if defined(WEBP_USE_THREAD) && !defined(_WIN32)
+static pthread_once_t encoder_init_once = PTHREAD_ONCE_INIT;
+#endif
+
+void WebPInitEncoder(void) {
+#if defined(WEBP_USE_THREAD) && !defined(_WIN32)
+  (void)pthread_once(&encoder_init_once, InitEncoderOnce);
+#else
+  InitEncoderOnce();   // each of the calls is guarded already
+#endif
+}
+
 //------------------------------------------------------------------------------
 // VP8Encoder
 //------------------------------------------------------------------------------
@@ -256,11 +286,72 @@ static int DeleteVP8Encoder(VP8Encoder* enc) {
   if (enc != NULL) {
     ok = VP8EncDeleteAlpha(enc);
     VP8TBufferClear(&enc->tokens_);
+    if (enc->rows_ != NULL) {
+      VP8RowWindowClear(enc->rows_);
+      WebPSafeFree(enc->rows_);
+    }
     WebPSafeFree(enc);
   }
   return ok;
 }
 
+// In low-memory mode, ARGB samples are converted to YUVA one macroblock row
+// at a time, when imported, instead of all at once in a full-size YUVA copy.
+// This requires the conversion to be row-local and the picture not to be
+// written back.
+static int UseRowWindow(const WebPConfig* const config,
+                        const WebPPicture* const pic) {
+  return config->low_memory && pic->use_argb && pic->argb != NULL &&
+         !config->use_sharp_yuv && !(config->preprocessing & (2 | 4)) &&
+         !config->show_compressed;
+}
+
+static int InitRowWindow(VP8Encoder* const enc) {
+  WebPPicture* const pic = enc->pic_;
+  enc->rows_ = (VP8RowWindow*)WebPSafeMalloc(1ULL, sizeof(*enc->rows_));
+  if (enc->rows_ == NULL ||
+      !VP8RowWindowInit(enc->rows_, pic, enc->has_alpha_,
+                        enc->config_->exact)) {
+    WebPSafeFree(enc->rows_);
+    enc->rows_ = NULL;
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+  }
+  return 1;
+}
+
+static int NeedsYUVAConversion(const WebPPicture* const pic) {
+  return pic->use_argb || pic->y == NULL || pic->u == NULL || pic->v == NULL;
+}
+
+static int ConvertToYUVA(const WebPConfig* const config,
+                         WebPPicture* const pic) {
+  if (config->use_sharp_yuv || (config->preprocessing & 4)) {
+    return WebPPictureSharpARGBToYUVA(pic);
+  } else {
+    float dithering = 0.f;
+    if (config->preprocessing & 2) {
+      const float x = config->quality / 100.f;
+      const float x2 = x * x;
+      // slowly decreasing from max dithering at low quality (q->0)
+      // to 0.5 dithering amplitude at high quality (q->100)
+      dithering = 1.0f + (0.5f - 1.0f) * x2 * x2;
+    }
+    return WebPPictureARGBToYUVADithered(pic, WEBP_YUV420, dithering);
+  }
+}
+
+// Makes sure we have YUVA samples, and cleans up the transparent area.
+static int PrepareYUVA(const WebPConfig* const config,
+                       WebPPicture* const pic) {
+  if (NeedsYUVAConversion(pic) && !ConvertToYUVA(config, pic)) {
+    return 0;
+  }
+  if (!config->exact) {
+    WebPCleanupTransparentArea(pic);
+  }
+  return 1;
+}
+
 //------------------------------------------------------------------------------
 
 #if !defined(WEBP_DISABLE_STATS)
@@ -313,6 +404,9 @@ int WebPEncodingSetError(const WebPPicture* const pic,
 
 int WebPReportProgress(const WebPPicture* const pic,
                        int percent, int* const percent_store) {
+  if (WebPEncodingIsCancelled(pic)) {
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_USER_ABORT);
+  }
   if (percent_store != NULL && percent != *percent_store) {
     *percent_store = percent;
     if (pic->progress_hook && !pic->progress_hook(percent, pic)) {
@@ -325,6 +419,9 @@ int WebPReportProgress(const WebPPicture* const pic,
 }
 //------------------------------------------------------------------------------
 
+static int EncodeKeepSmaller(const WebPConfig* const config,
+                             WebPPicture* const pic);
+
 int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
   int ok = 0;
   if (pic == NULL) return 0;
@@ -345,49 +442,36 @@ int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
 
   if (pic->stats != NULL) memset(pic->stats, 0, sizeof(*pic->stats));
 
+  if (config->keep_smaller) return EncodeKeepSmaller(config, pic);
+
   if (!config->lossless) {
     VP8Encoder* enc = NULL;
+    const int use_row_window = UseRowWindow(config, pic);
 
-    if (pic->use_argb || pic->y == NULL || pic->u == NULL || pic->v == NULL) {
-      // Make sure we have YUVA samples.
-      if (config->use_sharp_yuv || (config->preprocessing & 4)) {
-        if (!WebPPictureSharpARGBToYUVA(pic)) {
-          return 0;
-        }
-      } else {
-        float dithering = 0.f;
-        if (config->preprocessing & 2) {
-          const float x = config->quality / 100.f;
-          const float x2 = x * x;
-          // slowly decreasing from max dithering at low quality (q->0)
-          // to 0.5 dithering amplitude at high quality (q->100)
-          dithering = 1.0f + (0.5f - 1.0f) * x2 * x2;
-        }
-        if (!WebPPictureARGBToYUVADithered(pic, WEBP_YUV420, dithering)) {
-          return 0;
-        }
-      }
-    }
-
-    if (!config->exact) {
-      WebPCleanupTransparentArea(pic);
-    }
+    if (!use_row_window && !PrepareYUVA(config, pic)) return 0;
 
     enc = InitVP8Encoder(config, pic);
     if (enc == NULL) return 0;  // pic->error is already set.
+    ok = !use_row_window || InitRowWindow(enc);
     // Note: each of the tasks below account for 20% in the progress report.
-    ok = VP8EncAnalyze(enc);
+    WEBP_TRACE_BEGIN("VP8EncAnalyze");
+    ok = ok && VP8EncAnalyze(enc);
+    WEBP_TRACE_END("VP8EncAnalyze");
 
     // Analysis is done, proceed to actual coding.
     ok = ok && VP8EncStartAlpha(enc);   // possibly done in parallel
+    WEBP_TRACE_BEGIN("VP8EncLoop");
     if (!enc->use_tokens_) {
       ok = ok && VP8EncLoop(enc);
     } else {
       ok = ok && VP8EncTokenLoop(enc);
     }
+    WEBP_TRACE_END("VP8EncLoop");
     ok = ok && VP8EncFinishAlpha(enc);
 
+    WEBP_TRACE_BEGIN("VP8EncWrite");
     ok = ok && VP8EncWrite(enc);
+    WEBP_TRACE_END("VP8EncWrite");
     StoreStats(enc);
     if (!ok) {
       VP8EncFreeBitWriters(enc);
@@ -403,8 +487,417 @@ int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
       WebPCleanupTransparentAreaLossless(pic);
     }
 
+    WEBP_TRACE_BEGIN("VP8LEncodeImage");
     ok = VP8LEncodeImage(config, pic);  // Sets pic->error in case of problem.
+    WEBP_TRACE_END("VP8LEncodeImage");
+  }
+
+  // The polled loops simply bail out upon cancellation, possibly from worker
+  // threads: report the proper error here.
+  if (!ok && WebPEncodingIsCancelled(pic)) {
+    WebPEncodingSetError(pic, VP8_ENC_ERROR_USER_ABORT);
+  }
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Lossy vs. lossless encoding (WebPConfig::keep_smaller)
+
+typedef struct {
+  WebPWorker worker_;
+  WebPConfig config_;
+  WebPPicture pic_;           // view on the user's picture, see InitCandidate()
+  WebPMemoryWriter writer_;
+  WebPAuxStats stats_;
+  WebPCancelToken* token_;    // child of the user's token
+  WebPCancelToken* other_token_;   // to stop the other candidate, or NULL
+  int ok_;
+} CandidateJob;
+
+static int EncodeCandidateJob(void* arg1, void* arg2) {
+  CandidateJob* const job = (CandidateJob*)arg1;
+  (void)arg2;
+  job->ok_ = WebPEncode(&job->config_, &job->pic_);
+  if (job->ok_) {
+    // The other candidate can't be kept anymore once it gets bigger.
+    WebPCancelTokenSetSizeLimit(job->other_token_, job->writer_.size);
+  } else if (!WebPCancelTokenIsCancelled(job->token_)) {
+    WebPCancelTokenCancel(job->other_token_);   // no need to go on
+  }
+  return 1;
+}
+
+// The two candidates share the samples of 'pic' but each gets its own
+// representation (ARGB or YUVA), converted beforehand: the concurrent
+// encodings then only modify their own samples.
+static int InitCandidate(const WebPConfig* const config,
+                         const WebPPicture* const pic, int lossless,
+                         CandidateJob* const job) {
+  job->config_ = *config;
+  job->config_.lossless = lossless;
+  job->config_.keep_smaller = 0;
+  job->pic_ = *pic;
+  job->pic_.memory_ = NULL;
+  job->pic_.memory_argb_ = NULL;
+  job->pic_.writer = WebPMemoryWrite;
+  job->pic_.custom_ptr = &job->writer_;
+  job->pic_.stats = &job->stats_;
+  WebPMemoryWriterInit(&job->writer_);
+  job->token_ = WebPCancelTokenNewChild(pic->cancel_token);
+  if (job->token_ == NULL) {
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+  }
+  job->pic_.cancel_token = job->token_;
+  if (lossless) {
+    // Only the lossy encoding reports the progress and the macroblock info.
+    job->pic_.progress_hook = NULL;
+    job->pic_.extra_info = NULL;
+    if (pic->argb == NULL && !WebPPictureYUVAToARGB(&job->pic_)) {
+      return WebPEncodingSetError(pic, job->pic_.error_code);
+    }
+  } else if (NeedsYUVAConversion(&job->pic_)) {
+    if (!ConvertToYUVA(&job->config_, &job->pic_)) {
+      return WebPEncodingSetError(pic, job->pic_.error_code);
+    }
+  }
+  job->worker_.data1 = job;
+  job->worker_.hook = EncodeCandidateJob;
+  return 1;
+}
+
+static int EmitCandidate(CandidateJob* const job, WebPPicture* const pic) {
+  WebPMemoryWriter* const w = &job->writer_;
+  if (WebPMemoryWriterAdopt(pic, w->mem, w->size)) {
+    w->mem = NULL;   // now owned by the user's writer
+    return 1;
   }
+  if (!pic->writer(w->mem, w->size, pic)) {
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_BAD_WRITE);
+  }
+  return 1;
+}
+
+static int EncodeKeepSmaller(const WebPConfig* const config,
+                             WebPPicture* const pic) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  CandidateJob jobs[2];   // lossy, lossless
+  CandidateJob* kept = NULL;
+  CandidateJob* discarded = NULL;
+  int ok;
+  int i;
 
+  memset(jobs, 0, sizeof(jobs));
+  for (i = 0; i < 2; ++i) worker_interface->Init(&jobs[i].worker_);
+  ok = InitCandidate(config, pic, 0, &jobs[0]) &&
+       InitCandidate(config, pic, 1, &jobs[1]);
+  if (ok && config->keep_smaller == 2) {
+    jobs[0].other_token_ = jobs[1].token_;
+    jobs[1].other_token_ = jobs[0].token_;
+  }
+
+  if (ok) {
+    // The lossless encoding is run in the background while the lossy one
+    // (usually faster) is run here. Sequentially, the lossy encoding comes
+    // first so that the lossless one can be stopped early.
+    WebPWorker* const worker = &jobs[1].worker_;
+    const int launched =
+        (config->thread_level > 0 && worker_interface->Reset(worker));
+    if (launched) worker_interface->Launch(worker);
+    worker_interface->Execute(&jobs[0].worker_);
+    if (launched) {
+      worker_interface->Sync(worker);
+    } else {
+      worker_interface->Execute(worker);
+    }
+
+    if (WebPEncodingIsCancelled(pic)) {
+      ok = WebPEncodingSetError(pic, VP8_ENC_ERROR_USER_ABORT);
+    } else {
+      for (i = 0; ok && i < 2; ++i) {
+        // A candidate stopped for being too big is simply discarded.
+        if (!jobs[i].ok_ && !WebPCancelTokenIsCancelled(jobs[i].token_)) {
+          ok = WebPEncodingSetError(pic, jobs[i].pic_.error_code);
+        }
+      }
+    }
+  }
+
+  if (ok) {
+    // On a tie, the lossless output is preferred.
+    const int lossless_kept =
+        !jobs[0].ok_ ||
+        (jobs[1].ok_ && jobs[1].writer_.size <= jobs[0].writer_.size);
+    kept = &jobs[lossless_kept ? 1 : 0];
+    discarded = &jobs[lossless_kept ? 0 : 1];
+    assert(kept->ok_);
+    ok = EmitCandidate(kept, pic);
+    if (pic->stats != NULL) {
+      *pic->stats = kept->stats_;
+      pic->stats->lossless_kept = lossless_kept;
+      pic->stats->discarded_size =
+          discarded->ok_ ? (int)discarded->writer_.size : 0;
+    }
+  }
+
+  for (i = 0; i < 2; ++i) {
+    worker_interface->End(&jobs[i].worker_);
+    WebPPictureFree(&jobs[i].pic_);
+    WebPMemoryWriterClear(&jobs[i].writer_);
+    WebPCancelTokenDelete(jobs[i].token_);
+  }
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Multi-quality encoding
+
+typedef struct {
+  WebPWorker worker_;
+  WebPConfig config_;      // user's config, with this rendition's quality
+  WebPPicture pic_;        // shallow copy of the user's picture
+  VP8Encoder* enc_;
+  int analyze_;            // true if the analysis couldn't be shared
+} RenditionJob;
+
+// The YUVA conversion, the analysis and the alpha compression don't depend on
+// the quality, except for the cases below.
+static int CanShareStages(const WebPConfig* const config,
+                          const WebPPicture* const pic) {
+  const int dithered_conversion =
+      NeedsYUVAConversion(pic) && (config->preprocessing & 2) &&
+      !config->use_sharp_yuv && !(config->preprocessing & 4);
+  return !config->lossless && !config->keep_smaller &&
+         !config->show_compressed && !UseRowWindow(config, pic) &&
+         !dithered_conversion;
+}
+
+// Copies the results of VP8EncAnalyze() and of the alpha compression from
+// 'ref' to the freshly created 'enc'.
+static int CopySharedStages(const VP8Encoder* const ref,
+                            const WebPAuxStats* const ref_stats,
+                            int copy_analysis, VP8Encoder* const enc) {
+  if (copy_analysis) {
+    const size_t preds_size = enc->preds_w_ * (4 * enc->mb_h_ + 1);
+    int s;
+    assert(enc->mb_w_ == ref->mb_w_ && enc->mb_h_ == ref->mb_h_);
+    memcpy(enc->mb_info_, ref->mb_info_,
+           enc->mb_w_ * enc->mb_h_ * sizeof(*enc->mb_info_));
+    memcpy(enc->preds_ - 1 - enc->preds_w_, ref->preds_ - 1 - ref->preds_w_,
+           preds_size * sizeof(*enc->preds_));
+    for (s = 0; s < NUM_MB_SEGMENTS; ++s) {
+      enc->dqm_[s].alpha_ = ref->dqm_[s].alpha_;
+      enc->dqm_[s].beta_ = ref->dqm_[s].beta_;
+    }
+    enc->segment_hdr_ = ref->segment_hdr_;
+    enc->alpha_ = ref->alpha_;
+    enc->uv_alpha_ = ref->uv_alpha_;
+  }
+  enc->percent_ = ref->percent_;
+  enc->has_alpha_ = ref->has_alpha_;
+  if (ref->alpha_data_ != NULL) {
+    enc->alpha_data_ =
+        (uint8_t*)WebPSafeMalloc(1ULL, ref->alpha_data_size_);
+    if (enc->alpha_data_ == NULL) {
+      return WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    }
+    memcpy(enc->alpha_data_, ref->alpha_data_, ref->alpha_data_size_);
+    enc->alpha_data_size_ = ref->alpha_data_size_;
+    enc->sse_[3] = ref->sse_[3];
+  }
+#if !defined(WEBP_DISABLE_STATS)
+  if (enc->pic_->stats != NULL) {
+    WebPAuxStats* const stats = enc->pic_->stats;
+    stats->lossless_features = ref_stats->lossless_features;
+    stats->histogram_bits = ref_stats->histogram_bits;
+    stats->transform_bits = ref_stats->transform_bits;
+    stats->cache_bits = ref_stats->cache_bits;
+    stats->palette_size = ref_stats->palette_size;
+    stats->lossless_size = ref_stats->lossless_size;
+    stats->lossless_hdr_size = ref_stats->lossless_hdr_size;
+    stats->lossless_data_size = ref_stats->lossless_data_size;
+  }
+#else
+  (void)ref_stats;
+#endif
+  return 1;
+}
+
+// Quality-dependent part of WebPEncode(): segment quantizers, coding loop and
+// bitstream assembly.
+static int EncodeRenditionJob(void* arg1, void* arg2) {
+  RenditionJob* const job = (RenditionJob*)arg1;
+  VP8Encoder* const enc = job->enc_;
+  int ok = 1;
+  (void)arg2;
+  if (job->analyze_) {
+    WEBP_TRACE_BEGIN("VP8EncAnalyze");
+    ok = VP8EncAnalyze(enc);
+    WEBP_TRACE_END("VP8EncAnalyze");
+  }
+  WEBP_TRACE_BEGIN("VP8EncLoop");
+  if (!enc->use_tokens_) {
+    ok = ok && VP8EncLoop(enc);
+  } else {
+    ok = ok && VP8EncTokenLoop(enc);
+  }
+  WEBP_TRACE_END("VP8EncLoop");
+  WEBP_TRACE_BEGIN("VP8EncWrite");
+  ok = ok && VP8EncWrite(enc);
+  WEBP_TRACE_END("VP8EncWrite");
+  StoreStats(enc);
+  if (!ok) {
+    VP8EncFreeBitWriters(enc);
+  }
+  return ok;
+}
+
+// Fallback for the configurations that can't share any stage: plain
+// WebPEncode() calls, redirecting the output of 'pic' to each writer in turn.
+static int EncodeQualitiesSequentially(const WebPConfig* const config,
+                                       WebPPicture* const pic,
+                                       const float qualities[],
+                                       int num_qualities,
+                                       WebPMemoryWriter writers[],
+                                       WebPAuxStats stats[]) {
+  const WebPPicture saved = *pic;
+  int ok = 1;
+  int i;
+  for (i = 0; ok && i < num_qualities; ++i) {
+    WebPConfig rendition_config = *config;
+    rendition_config.quality = qualities[i];
+    // Redo the (quality-dependent) conversion from the ARGB samples.
+    pic->use_argb = saved.use_argb;
+    pic->writer = WebPMemoryWrite;
+    pic->custom_ptr = &writers[i];
+    pic->stats = (stats != NULL) ? &stats[i] : NULL;
+    pic->extra_info = NULL;
+    ok = WebPEncode(&rendition_config, pic);
+  }
+  pic->writer = saved.writer;
+  pic->custom_ptr = saved.custom_ptr;
+  pic->stats = saved.stats;
+  pic->extra_info = saved.extra_info;
+  return ok;
+}
+
+int WebPEncodeQualities(const WebPConfig* config, WebPPicture* pic,
+                        const float qualities[], int num_qualities,
+                        WebPMemoryWriter writers[], WebPAuxStats stats[]) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  WebPConfig ref_config;
+  WebPPicture ref_pic;
+  WebPAuxStats ref_stats;
+  VP8Encoder* ref = NULL;
+  RenditionJob* jobs = NULL;
+  int share_analysis;
+  int ok = 0;
+  int i;
+  if (pic == NULL) return 0;
+
+  WebPEncodingSetError(pic, VP8_ENC_OK);
+  if (config == NULL || qualities == NULL || writers == NULL) {
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_NULL_PARAMETER);
+  }
+  if (!WebPValidateConfig(config) || num_qualities <= 0) {
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_INVALID_CONFIGURATION);
+  }
+  for (i = 0; i < num_qualities; ++i) {
+    if (qualities[i] < 0.f || qualities[i] > 100.f) {
+      return WebPEncodingSetError(pic, VP8_ENC_ERROR_INVALID_CONFIGURATION);
+    }
+  }
+  if (pic->width <= 0 || pic->height <= 0 ||
+      pic->width > WEBP_MAX_DIMENSION || pic->height > WEBP_MAX_DIMENSION) {
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_BAD_DIMENSION);
+  }
+  if (!CanShareStages(config, pic)) {
+    return EncodeQualitiesSequentially(config, pic, qualities, num_qualities,
+                                       writers, stats);
+  }
+
+  // Quality-independent stages, done once with a reference encoder.
+  if (!PrepareYUVA(config, pic)) return 0;
+  ref_config = *config;
+  ref_config.quality = qualities[0];
+  ref_pic = *pic;
+  ref_pic.stats = &ref_stats;
+  ref_pic.extra_info = NULL;
+  memset(&ref_stats, 0, sizeof(ref_stats));
+  ref = InitVP8Encoder(&ref_config, &ref_pic);
+  if (ref == NULL) goto End;
+  // The fast analysis of methods 0 and 1 picks modes based on the quality.
+  share_analysis = (ref->method_ > 1);
+  ok = VP8EncStartAlpha(ref);   // possibly done in parallel
+  if (share_analysis) {
+    WEBP_TRACE_BEGIN("VP8EncAnalyze");
+    ok = ok && VP8EncAnalyze(ref);
+    WEBP_TRACE_END("VP8EncAnalyze");
+  }
+  ok &= VP8EncFinishAlpha(ref);  // must always be called, even if !ok
+  if (!ok) goto End;
+
+  jobs = (RenditionJob*)WebPSafeCalloc(num_qualities, sizeof(*jobs));
+  if (jobs == NULL) {
+    ok = WebPEncodingSetError(&ref_pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    goto End;
+  }
+  for (i = 0; ok && i < num_qualities; ++i) {
+    RenditionJob* const job = &jobs[i];
+    job->config_ = *config;
+    job->config_.quality = qualities[i];
+    job->pic_ = *pic;
+    job->pic_.writer = WebPMemoryWrite;
+    job->pic_.custom_ptr = &writers[i];
+    job->pic_.stats = (stats != NULL) ? &stats[i] : NULL;
+    job->pic_.extra_info = NULL;
+    // Only the last rendition, run by the calling thread, reports progress.
+    if (i + 1 < num_qualities) job->pic_.progress_hook = NULL;
+    if (job->pic_.stats != NULL) {
+      memset(job->pic_.stats, 0, sizeof(*job->pic_.stats));
+    }
+    job->analyze_ = !share_analysis;
+    job->enc_ = InitVP8Encoder(&job->config_, &job->pic_);
+    if (job->enc_ == NULL) {
+      ok = WebPEncodingSetError(&ref_pic, job->pic_.error_code);
+      break;
+    }
+    ok = CopySharedStages(ref, &ref_stats, share_analysis, job->enc_);
+    worker_interface->Init(&job->worker_);
+    job->worker_.data1 = job;
+    job->worker_.hook = EncodeRenditionJob;
+  }
+
+  // Launch all the renditions but the last one, which is executed here.
+  if (ok) {
+    for (i = 0; i + 1 < num_qualities; ++i) {
+      WebPWorker* const worker = &jobs[i].worker_;
+      if (config->thread_level > 0 && worker_interface->Reset(worker)) {
+        worker_interface->Launch(worker);
+      } else {
+        worker_interface->Execute(worker);
+      }
+    }
+    worker_interface->Execute(&jobs[num_qualities - 1].worker_);
+    for (i = 0; i < num_qualities; ++i) {
+      if (!worker_interface->Sync(&jobs[i].worker_) && ok) {
+        ok = WebPEncodingSetError(&ref_pic, jobs[i].pic_.error_code);
+      }
+    }
+  }
+
+ End:
+  if (jobs != NULL) {
+    for (i = 0; i < num_qualities; ++i) {
+      worker_interface->End(&jobs[i].worker_);
+      ok &= DeleteVP8Encoder(jobs[i].enc_);
+    }
+    WebPSafeFree(jobs);
+  }
+  ok &= DeleteVP8Encoder(ref);
+  if (!ok) {
+    WebPEncodingSetError(pic, WebPEncodingIsCancelled(pic) ?
+                                  VP8_ENC_ERROR_USER_ABORT :
+                                  ref_pic.error_code);
+  }
   return ok;
 }
@@ -67,6 +67,10 @@ struct WebPAnimEncoder {
   WebPPicture prev_canvas_;           // Previous canvas.
   WebPPicture prev_canvas_disposed_;  // Previous canvas disposed to background.
 
+  // Per-row hashes of 'prev_canvas_' and of the frame being added.
+  uint32_t* prev_row_hashes_;
+  uint32_t* curr_row_hashes_;
+
   // Encoded data.
   EncodedFrame* encoded_frames_;      // Array of encoded frames.
   size_t size_;             // Number of allocated frames.
@@ -81,6 +85,8 @@ struct WebPAnimEncoder {
                             // transparent pixels in a frame.
   int keyframe_;            // Index of selected key-frame relative to 'start_'.
   int count_since_key_frame_;     // Frames seen since the last key-frame.
+  double key_frame_size_ratio_;   // Encoded size of the last key-frame over
+                                  // its EstimateRectSize(); 0 if unknown.
 
   int first_timestamp_;           // Timestamp of the first frame.
   int prev_timestamp_;            // Timestamp of the last added frame.
@@ -233,6 +239,41 @@ static void MarkError2(WebPAnimEncoder* const enc,
   }
 }
 
+// -----------------------------------------------------------------------------
+// Row hashes, used to quickly spot identical frames and unchanged rows.
+
+#define ROW_HASH_MUL 0x9e3779b1u
+
+static uint32_t HashRow(const uint32_t* const argb, int width) {
+  uint32_t hash = 0;
+  int x;
+  for (x = 0; x < width; ++x) {
+    hash = (hash ^ argb[x]) * ROW_HASH_MUL;
+    hash ^= hash >> 15;
+  }
+  return hash;
+}
+
+#undef ROW_HASH_MUL
+
+static void ComputeRowHashes(const WebPPicture* const pic,
+                             uint32_t* const hashes) {
+  int y;
+  for (y = 0; y < pic->height; ++y) {
+    hashes[y] = HashRow(pic->argb + y * pic->argb_stride, pic->width);
+  }
+}
+
+// Returns true if the rows [x_offset, x_offset + width) of 'src' and 'dst' are
+// equal.
+static WEBP_INLINE int RowsAreEqual(const WebPPicture* const src, int src_y,
+                                    const WebPPicture* const dst, int dst_y,
+                                    int x_offset, int width) {
+  return !memcmp(src->argb + src_y * src->argb_stride + x_offset,
+                 dst->argb + dst_y * dst->argb_stride + x_offset,
+                 width * sizeof(*src->argb));
+}
+
 WebPAnimEncoder* WebPAnimEncoderNewInternal(
     int width, int height, const WebPAnimEncoderOptions* enc_options,
     int abi_version) {
@@ -280,6 +321,12 @@ WebPAnimEncoder* WebPAnimEncoderNewInternal(
   WebPUtilClearPic(&enc->prev_canvas_, NULL);
   enc->curr_canvas_copy_modified_ = 1;
 
+  enc->prev_row_hashes_ =
+      (uint32_t*)WebPSafeMalloc(2ULL * height, sizeof(*enc->prev_row_hashes_));
+  if (enc->prev_row_hashes_ == NULL) goto Err;
+  enc->curr_row_hashes_ = enc->prev_row_hashes_ + height;
+  ComputeRowHashes(&enc->prev_canvas_, enc->prev_row_hashes_);
+
   // Encoded frames.
   ResetCounters(enc);
   // Note: one extra storage is for the previous frame.
@@ -295,6 +342,7 @@ WebPAnimEncoder* WebPAnimEncoderNewInternal(
   if (enc->mux_ == NULL) goto Err;
 
   enc->count_since_key_frame_ = 0;
+  enc->key_frame_size_ratio_ = 0.;
   enc->first_timestamp_ = 0;
   enc->prev_timestamp_ = 0;
   enc->prev_candidate_undecided_ = 0;
@@ -322,6 +370,9 @@ void WebPAnimEncoderDelete(WebPAnimEncoder* enc) {
     WebPPictureFree(&enc->curr_canvas_copy_);
     WebPPictureFree(&enc->prev_canvas_);
     WebPPictureFree(&enc->prev_canvas_disposed_);
+    // The two hash arrays share a single allocation.
+    WebPSafeFree((enc->prev_row_hashes_ < enc->curr_row_hashes_) ?
+                 enc->prev_row_hashes_ : enc->curr_row_hashes_);
     if (enc->encoded_frames_ != NULL) {
       size_t i;
       for (i = 0; i < enc->size_; ++i) {
@@ -410,11 +461,38 @@ static int QualityToMaxDiff(float quality) {
   return (int)(max_diff + 0.5);
 }
 
+// Returns true if row 'y' of 'src' and 'dst' is similar within 'rect'.
+// If 'src_hashes' and 'dst_hashes' are not NULL, they hold the row hashes of
+// the pictures, and all the pixels outside of 'rect' must be identical.
+static int IsRowSimilar(const WebPPicture* const src,
+                        const WebPPicture* const dst, int y,
+                        const FrameRectangle* const rect,
+                        ComparePixelsFunc compare_pixels, int max_allowed_diff,
+                        const uint32_t* const src_hashes,
+                        const uint32_t* const dst_hashes) {
+  if (src_hashes != NULL) {
+    if (src_hashes[y] == dst_hashes[y]) {
+      if (RowsAreEqual(src, y, dst, y, rect->x_offset_, rect->width_)) {
+        return 1;
+      }
+    } else if (max_allowed_diff == 0) {
+      return 0;  // The rows differ, necessarily within 'rect'.
+    }
+  }
+  return compare_pixels(&src->argb[y * src->argb_stride + rect->x_offset_], 1,
+                        &dst->argb[y * dst->argb_stride + rect->x_offset_], 1,
+                        rect->width_, max_allowed_diff);
+}
+
 // Assumes that an initial valid guess of change rectangle 'rect' is passed.
+// Rows are trimmed first so that the (strided) column comparisons only span
+// the changed rows. Row hashes are optional (see IsRowSimilar()).
 static void MinimizeChangeRectangle(const WebPPicture* const src,
                                     const WebPPicture* const dst,
                                     FrameRectangle* const rect,
-                                    int is_lossless, float quality) {
+                                    int is_lossless, float quality,
+                                    const uint32_t* const src_hashes,
+                                    const uint32_t* const dst_hashes) {
   int i, j;
   const ComparePixelsFunc compare_pixels =
       is_lossless ? ComparePixelsLossless : ComparePixelsLossy;
@@ -425,6 +503,31 @@ static void MinimizeChangeRectangle(const WebPPicture* const src,
   assert(src->width == dst->width && src->height == dst->height);
   assert(rect->x_offset_ + rect->width_ <= dst->width);
   assert(rect->y_offset_ + rect->height_ <= dst->height);
+  assert((src_hashes == NULL) == (dst_hashes == NULL));
+  if (rect->width_ == 0) goto NoChange;
+
+  // Top boundary.
+  for (j = rect->y_offset_; j < rect->y_offset_ + rect->height_; ++j) {
+    if (IsRowSimilar(src, dst, j, rect, compare_pixels, max_allowed_diff,
+                     src_hashes, dst_hashes)) {
+      --rect->height_;  // Redundant row.
+      ++rect->y_offset_;
+    } else {
+      break;
+    }
+  }
+  if (rect->height_ == 0) goto NoChange;
+
+  // Bottom boundary.
+  for (j = rect->y_offset_ + rect->height_ - 1; j >= rect->y_offset_; --j) {
+    if (IsRowSimilar(src, dst, j, rect, compare_pixels, max_allowed_diff,
+                     src_hashes, dst_hashes)) {
+      --rect->height_;  // Redundant row.
+    } else {
+      break;
+    }
+  }
+  if (rect->height_ == 0) goto NoChange;
 
   // Left boundary.
   for (i = rect->x_offset_; i < rect->x_offset_ + rect->width_; ++i) {
@@ -457,37 +560,6 @@ static void MinimizeChangeRectangle(const WebPPicture* const src,
   }
   if (rect->width_ == 0) goto NoChange;
 
-  // Top boundary.
-  for (j = rect->y_offset_; j < rect->y_offset_ + rect->height_; ++j) {
-    const uint32_t* const src_argb =
-        &src->argb[j * src->argb_stride + rect->x_offset_];
-    const uint32_t* const dst_argb =
-        &dst->argb[j * dst->argb_stride + rect->x_offset_];
-    if (compare_pixels(src_argb, 1, dst_argb, 1, rect->width_,
-                       max_allowed_diff)) {
-      --rect->height_;  // Redundant row.
-      ++rect->y_offset_;
-    } else {
-      break;
-    }
-  }
-  if (rect->height_ == 0) goto NoChange;
-
-  // Bottom boundary.
-  for (j = rect->y_offset_ + rect->height_ - 1; j >= rect->y_offset_; --j) {
-    const uint32_t* const src_argb =
-        &src->argb[j * src->argb_stride + rect->x_offset_];
-    const uint32_t* const dst_argb =
-        &dst->argb[j * dst->argb_stride + rect->x_offset_];
-    if (compare_pixels(src_argb, 1, dst_argb, 1, rect->width_,
-                       max_allowed_diff)) {
-      --rect->height_;  // Redundant row.
-    } else {
-      break;
-    }
-  }
-  if (rect->height_ == 0) goto NoChange;
-
   if (IsEmptyRect(rect)) {
  NoChange:
     rect->x_offset_ = 0;
@@ -539,13 +611,15 @@ static int GetSubRect(const WebPPicture* const prev_canvas,
                       const WebPPicture* const curr_canvas, int is_key_frame,
                       int is_first_frame, int empty_rect_allowed,
                       int is_lossless, float quality,
+                      const uint32_t* const prev_hashes,
+                      const uint32_t* const curr_hashes,
                       FrameRectangle* const rect,
                       WebPPicture* const sub_frame) {
   if (!is_key_frame || is_first_frame) {  // Optimize frame rectangle.
     // Note: This behaves as expected for first frame, as 'prev_canvas' is
     // initialized to a fully transparent canvas in the beginning.
     MinimizeChangeRectangle(prev_canvas, curr_canvas, rect,
-                            is_lossless, quality);
+                            is_lossless, quality, prev_hashes, curr_hashes);
   }
 
   if (IsEmptyRect(rect)) {
@@ -566,9 +640,12 @@ static int GetSubRect(const WebPPicture* const prev_canvas,
 
 // Picks optimal frame rectangle for both lossless and lossy compression. The
 // initial guess for frame rectangles will be the full canvas.
+// 'prev_hashes' and 'curr_hashes' are the row hashes of the canvases, or NULL.
 static int GetSubRects(const WebPPicture* const prev_canvas,
                        const WebPPicture* const curr_canvas, int is_key_frame,
                        int is_first_frame, float quality,
+                       const uint32_t* const prev_hashes,
+                       const uint32_t* const curr_hashes,
                        SubFrameParams* const params) {
   // Lossless frame rectangle.
   params->rect_ll_.x_offset_ = 0;
@@ -577,13 +654,17 @@ static int GetSubRects(const WebPPicture* const prev_canvas,
   params->rect_ll_.height_ = curr_canvas->height;
   if (!GetSubRect(prev_canvas, curr_canvas, is_key_frame, is_first_frame,
                   params->empty_rect_allowed_, 1, quality,
+                  prev_hashes, curr_hashes,
                   &params->rect_ll_, &params->sub_frame_ll_)) {
     return 0;
   }
   // Lossy frame rectangle.
+  // Note: all the pixels outside of the lossless rect are identical, so the
+  // row hashes remain usable.
   params->rect_lossy_ = params->rect_ll_;  // seed with lossless rect.
   return GetSubRect(prev_canvas, curr_canvas, is_key_frame, is_first_frame,
                     params->empty_rect_allowed_, 0, quality,
+                    prev_hashes, curr_hashes,
                     &params->rect_lossy_, &params->sub_frame_lossy_);
 }
 
@@ -611,7 +692,7 @@ int WebPAnimEncoderRefineRect(
   rect.width_ = clip(right - left, 0, curr_canvas->width - rect.x_offset_);
   rect.height_ = clip(bottom - top, 0, curr_canvas->height - rect.y_offset_);
   MinimizeChangeRectangle(prev_canvas, curr_canvas, &rect, is_lossless,
-                          quality);
+                          quality, NULL, NULL);
   SnapToEvenOffsets(&rect);
   *x_offset = rect.x_offset_;
   *y_offset = rect.y_offset_;
@@ -831,6 +912,7 @@ static void CopyCurrentCanvas(WebPAnimEncoder* const enc) {
     WebPCopyPixels(enc->curr_canvas_, &enc->curr_canvas_copy_);
     enc->curr_canvas_copy_.progress_hook = enc->curr_canvas_->progress_hook;
     enc->curr_canvas_copy_.user_data = enc->curr_canvas_->user_data;
+    enc->curr_canvas_copy_.cancel_token = enc->curr_canvas_->cancel_token;
     enc->curr_canvas_copy_modified_ = 0;
   }
 }
@@ -1051,6 +1133,14 @@ static void PickBestCandidate(WebPAnimEncoder* const enc,
   }
 }
 
+// Remembers 'config' (and its lossy/lossless counterpart) for re-encodes.
+static void SetLastConfig(WebPAnimEncoder* const enc,
+                          const WebPConfig* const config) {
+  enc->last_config_ = *config;
+  enc->last_config_reversed_ = *config;
+  enc->last_config_reversed_.lossless = !config->lossless;
+}
+
 // Depending on the configuration, tries different compressions
 // (lossy/lossless), dispose methods, blending methods etc to encode the current
 // frame and outputs the best one in 'encoded_frame'.
@@ -1096,8 +1186,9 @@ static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
   WebPConfig config_lossy = *config;
   config_ll.lossless = 1;
   config_lossy.lossless = 0;
-  enc->last_config_ = *config;
-  enc->last_config_reversed_ = config->lossless ? config_lossy : config_ll;
+  config_ll.keep_smaller = 0;    // the candidates are already compared here
+  config_lossy.keep_smaller = 0;
+  SetLastConfig(enc, config);
   *frame_skipped = 0;
 
   if (!SubFrameParamsInit(&dispose_none_params, 1, empty_rect_allowed_none) ||
@@ -1109,7 +1200,8 @@ static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
 
   // Change-rectangle assuming previous frame was DISPOSE_NONE.
   if (!GetSubRects(prev_canvas, curr_canvas, is_key_frame, is_first_frame,
-                   config_lossy.quality, &dispose_none_params)) {
+                   config_lossy.quality, enc->prev_row_hashes_,
+                   enc->curr_row_hashes_, &dispose_none_params)) {
     error_code = VP8_ENC_ERROR_INVALID_CONFIGURATION;
     goto Err;
   }
@@ -1131,7 +1223,7 @@ static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
                           prev_canvas_disposed);
 
     if (!GetSubRects(prev_canvas_disposed, curr_canvas, is_key_frame,
-                     is_first_frame, config_lossy.quality,
+                     is_first_frame, config_lossy.quality, NULL, NULL,
                      &dispose_bg_params)) {
       error_code = VP8_ENC_ERROR_INVALID_CONFIGURATION;
       goto Err;
@@ -1186,6 +1278,43 @@ static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
   return error_code;
 }
 
+// Returns the entropy, in bytes, of the 'rect' pixels once the green channel is
+// subtracted from red and blue, and each pixel predicted by its left neighbor.
+// This is a rough model of the lossless coding, only meant to compare frames
+// of the same animation.
+static double EstimateRectSize(const WebPPicture* const pic,
+                               const FrameRectangle* const rect) {
+  uint32_t histo[4][256];
+  const double num_pixels = (double)rect->width_ * rect->height_;
+  double bits = 0.;
+  int x, y, i;
+  memset(histo, 0, sizeof(histo));
+  for (y = rect->y_offset_; y < rect->y_offset_ + rect->height_; ++y) {
+    const uint32_t* const src =
+        pic->argb + y * pic->argb_stride + rect->x_offset_;
+    uint32_t prev = 0xff000000u;   // ARGB_BLACK, as in the lossless predictor
+    for (x = 0; x < rect->width_; ++x) {
+      const uint32_t argb = src[x];
+      const uint32_t green = (argb >> 8) & 0xff;
+      const uint32_t curr = argb - ((green << 16) | green);
+      ++histo[0][((curr >> 24) - (prev >> 24)) & 0xff];
+      ++histo[1][((curr >> 16) - (prev >> 16)) & 0xff];
+      ++histo[2][((curr >>  8) - (prev >>  8)) & 0xff];
+      ++histo[3][(curr - prev) & 0xff];
+      prev = curr;
+    }
+  }
+  for (i = 0; i < 4; ++i) {
+    int k;
+    bits += num_pixels * log(num_pixels);
+    for (k = 0; k < 256; ++k) {
+      if (histo[i][k] > 0) bits -= histo[i][k] * log((double)histo[i][k]);
+    }
+  }
+  bits /= log(2.);
+  return (bits < 8.) ? 1. : bits / 8.;
+}
+
 // Calculate the penalty incurred if we encode given frame as a key frame
 // instead of a sub-frame.
 static int64_t KeyFramePenalty(const EncodedFrame* const encoded_frame) {
@@ -1193,6 +1322,42 @@ static int64_t KeyFramePenalty(const EncodedFrame* const encoded_frame) {
           encoded_frame->sub_frame_.bitstream.size);
 }
 
+// Remembers the encoded size of the key-frame variant of 'encoded_frame' over
+// its estimate, to scale the next estimates.
+static void UpdateKeyFrameSizeRatio(WebPAnimEncoder* const enc,
+                                    const EncodedFrame* const encoded_frame) {
+  const double estimate = EstimateRectSize(enc->curr_canvas_, &enc->prev_rect_);
+  enc->key_frame_size_ratio_ =
+      (double)encoded_frame->key_frame_.bitstream.size / estimate;
+}
+
+// Relative error tolerated on the estimated key-frame size.
+#define KEY_FRAME_ESTIMATE_TOLERANCE 0.15
+
+// Returns true if the current frame, whose sub-frame variant is already
+// encoded in 'encoded_frame', is very unlikely to be picked as the key-frame,
+// based on its estimated key-frame size. In that case, there is no need to
+// encode the key-frame variant.
+static int IsUnlikelyKeyFrame(const WebPAnimEncoder* const enc,
+                              const EncodedFrame* const encoded_frame) {
+  FrameRectangle canvas_rect;
+  double key_frame_size, delta;
+  // The first candidate of the key-frame window is always picked.
+  if (enc->best_delta_ == DELTA_INFINITY) return 0;
+  if (enc->key_frame_size_ratio_ <= 0.) return 0;
+  canvas_rect.x_offset_ = 0;
+  canvas_rect.y_offset_ = 0;
+  canvas_rect.width_ = enc->canvas_width_;
+  canvas_rect.height_ = enc->canvas_height_;
+  key_frame_size = enc->key_frame_size_ratio_ *
+                   EstimateRectSize(enc->curr_canvas_, &canvas_rect);
+  delta = key_frame_size - (double)encoded_frame->sub_frame_.bitstream.size;
+  return (delta - enc->best_delta_ >
+          KEY_FRAME_ESTIMATE_TOLERANCE * key_frame_size);
+}
+
+#undef KEY_FRAME_ESTIMATE_TOLERANCE
+
 static int CacheFrame(WebPAnimEncoder* const enc,
                       const WebPConfig* const config) {
   int ok = 0;
@@ -1208,6 +1373,7 @@ static int CacheFrame(WebPAnimEncoder* const enc,
     if (error_code != VP8_ENC_OK) goto End;
     assert(frame_skipped == 0);  // First frame can't be skipped, even if empty.
     assert(position == 0 && enc->count_ == 1);
+    UpdateKeyFrameSizeRatio(enc, encoded_frame);
     encoded_frame->is_key_frame_ = 1;
     enc->flush_count_ = 0;
     enc->count_since_key_frame_ = 0;
@@ -1233,28 +1399,35 @@ static int CacheFrame(WebPAnimEncoder* const enc,
       prev_rect_sub = enc->prev_rect_;
 
 
-      // Add this as a key-frame to enc, too.
-      error_code = SetFrame(enc, config, 1, encoded_frame, &frame_skipped);
-      if (error_code != VP8_ENC_OK) goto End;
-      assert(frame_skipped == 0);  // Key-frame cannot be an empty rectangle.
-      prev_rect_key = enc->prev_rect_;
-
-      // Analyze size difference of the two variants.
-      curr_delta = KeyFramePenalty(encoded_frame);
-      if (curr_delta <= enc->best_delta_) {  // Pick this as the key-frame.
-        if (enc->keyframe_ != KEYFRAME_NONE) {
-          EncodedFrame* const old_keyframe = GetFrame(enc, enc->keyframe_);
-          assert(old_keyframe->is_key_frame_);
-          old_keyframe->is_key_frame_ = 0;
-        }
-        encoded_frame->is_key_frame_ = 1;
-        enc->prev_candidate_undecided_ = 1;
-        enc->keyframe_ = (int)position;
-        enc->best_delta_ = curr_delta;
-        enc->flush_count_ = enc->count_ - 1;  // We can flush previous frames.
-      } else {
+      if (IsUnlikelyKeyFrame(enc, encoded_frame)) {
+        // Keep it as a frame rectangle, without encoding the key-frame.
         encoded_frame->is_key_frame_ = 0;
         enc->prev_candidate_undecided_ = 0;
+      } else {
+        // Add this as a key-frame to enc, too.
+        error_code = SetFrame(enc, config, 1, encoded_frame, &frame_skipped);
+        if (error_code != VP8_ENC_OK) goto End;
+        assert(frame_skipped == 0);  // Key-frame cannot be an empty rectangle.
+        prev_rect_key = enc->prev_rect_;
+        UpdateKeyFrameSizeRatio(enc, encoded_frame);
+
+        // Analyze size difference of the two variants.
+        curr_delta = KeyFramePenalty(encoded_frame);
+        if (curr_delta <= enc->best_delta_) {  // Pick this as the key-frame.
+          if (enc->keyframe_ != KEYFRAME_NONE) {
+            EncodedFrame* const old_keyframe = GetFrame(enc, enc->keyframe_);
+            assert(old_keyframe->is_key_frame_);
+            old_keyframe->is_key_frame_ = 0;
+          }
+          encoded_frame->is_key_frame_ = 1;
+          enc->prev_candidate_undecided_ = 1;
+          enc->keyframe_ = (int)position;
+          enc->best_delta_ = curr_delta;
+          enc->flush_count_ = enc->count_ - 1;  // We can flush previous frames.
+        } else {
+          encoded_frame->is_key_frame_ = 0;
+          enc->prev_candidate_undecided_ = 0;
+        }
       }
       // Note: We need '>=' below because when kmin and kmax are both zero,
       // count_since_key_frame will always be > kmax.
@@ -1273,6 +1446,11 @@ static int CacheFrame(WebPAnimEncoder* const enc,
 
   // Update previous to previous and previous canvases for next call.
   WebPCopyPixels(enc->curr_canvas_, &enc->prev_canvas_);
+  {
+    uint32_t* const tmp = enc->prev_row_hashes_;
+    enc->prev_row_hashes_ = enc->curr_row_hashes_;
+    enc->curr_row_hashes_ = tmp;
+  }
   enc->is_first_frame_ = 0;
 
  Skip:
@@ -1334,6 +1512,23 @@ static int FlushFrames(WebPAnimEncoder* const enc) {
 #undef DELTA_INFINITY
 #undef KEYFRAME_NONE
 
+// Returns true if 'frame' is identical to the previous canvas. Requires the
+// row hashes of 'frame' to be computed.
+static int IsSameAsPrevCanvas(const WebPAnimEncoder* const enc,
+                              const WebPPicture* const frame) {
+  const WebPPicture* const prev_canvas = &enc->prev_canvas_;
+  int y;
+  if (memcmp(enc->prev_row_hashes_, enc->curr_row_hashes_,
+             frame->height * sizeof(*enc->curr_row_hashes_))) {
+    return 0;
+  }
+  // Matching hashes are not a proof: check the pixels.
+  for (y = 0; y < frame->height; ++y) {
+    if (!RowsAreEqual(prev_canvas, y, frame, y, 0, frame->width)) return 0;
+  }
+  return 1;
+}
+
 int WebPAnimEncoderAdd(WebPAnimEncoder* enc, WebPPicture* frame, int timestamp,
                        const WebPConfig* encoder_config) {
   WebPConfig config;
@@ -1399,9 +1594,19 @@ int WebPAnimEncoderAdd(WebPAnimEncoder* enc, WebPPicture* frame, int timestamp,
   assert(enc->curr_canvas_ == NULL);
   enc->curr_canvas_ = frame;  // Store reference.
   assert(enc->curr_canvas_copy_modified_ == 1);
-  CopyCurrentCanvas(enc);
 
-  ok = CacheFrame(enc, &config) && FlushFrames(enc);
+  ComputeRowHashes(frame, enc->curr_row_hashes_);
+  if (!enc->is_first_frame_ && IsSameAsPrevCanvas(enc, frame)) {
+    // Fast path: the frame would end up being skipped anyway, and merged into
+    // the previous one by the next call to IncreasePreviousDuration().
+    SetLastConfig(enc, &config);
+    ++enc->in_frame_count_;
+    frame->error_code = VP8_ENC_OK;
+    ok = FlushFrames(enc);
+  } else {
+    CopyCurrentCanvas(enc);
+    ok = CacheFrame(enc, &config) && FlushFrames(enc);
+  }
 
   enc->curr_canvas_ = NULL;
   enc->curr_canvas_copy_modified_ = 1;
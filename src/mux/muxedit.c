@@ -36,16 +36,12 @@ WebPMux* WebPNewInternal(int version) {
   }
 }
 
-// Delete all images in 'wpi_list'.
-static void DeleteAllImages(WebPMuxImage** const wpi_list) {
-  while (*wpi_list != NULL) {
-    *wpi_list = MuxImageDelete(*wpi_list);
-  }
-}
-
 static void MuxRelease(WebPMux* const mux) {
   assert(mux != NULL);
-  DeleteAllImages(&mux->images_);
+  MuxImageDeleteAll(mux);
+  WebPSafeFree(mux->images_index_);
+  mux->images_index_ = NULL;
+  mux->images_index_size_ = 0;
   ChunkListDelete(&mux->vp8x_);
   ChunkListDelete(&mux->iccp_);
   ChunkListDelete(&mux->anim_);
@@ -243,7 +239,7 @@ WebPMuxError WebPMuxSetImage(WebPMux* mux, const WebPData* bitstream,
 
   if (mux->images_ != NULL) {
     // Only one 'simple image' can be added in mux. So, remove present images.
-    DeleteAllImages(&mux->images_);
+    MuxImageDeleteAll(mux);
   }
 
   MuxImageInit(&wpi);
@@ -251,7 +247,7 @@ WebPMuxError WebPMuxSetImage(WebPMux* mux, const WebPData* bitstream,
   if (err != WEBP_MUX_OK) goto Err;
 
   // Add this WebPMuxImage to mux.
-  err = MuxImagePush(&wpi, &mux->images_);
+  err = MuxImagePush(&wpi, mux);
   if (err != WEBP_MUX_OK) goto Err;
 
   // All is well.
@@ -313,7 +309,7 @@ WebPMuxError WebPMuxPushFrame(WebPMux* mux, const WebPMuxFrameInfo* info,
   }
 
   // Add this WebPMuxImage to mux.
-  err = MuxImagePush(&wpi, &mux->images_);
+  err = MuxImagePush(&wpi, mux);
   if (err != WEBP_MUX_OK) goto Err;
 
   // All is well.
@@ -381,7 +377,7 @@ WebPMuxError WebPMuxDeleteChunk(WebPMux* mux, const char fourcc[4]) {
 
 WebPMuxError WebPMuxDeleteFrame(WebPMux* mux, uint32_t nth) {
   if (mux == NULL) return WEBP_MUX_INVALID_ARGUMENT;
-  return MuxImageDeleteNth(&mux->images_, nth);
+  return MuxImageDeleteNth(mux, nth);
 }
 
 //------------------------------------------------------------------------------
@@ -555,7 +551,7 @@ static WebPMuxError MuxCleanup(WebPMux* const mux) {
   if (err != WEBP_MUX_OK) return err;
   if (num_frames == 1) {
     WebPMuxImage* frame = NULL;
-    err = MuxImageGetNth((const WebPMuxImage**)&mux->images_, 1, &frame);
+    err = MuxImageGetNth(mux, 1, &frame);
     assert(err == WEBP_MUX_OK);  // We know that one frame does exist.
     assert(frame != NULL);
     if (frame->header_ != NULL &&
@@ -60,6 +60,9 @@ struct WebPMuxImage {
 // Main mux object. Stores data chunks.
 struct WebPMux {
   WebPMuxImage*   images_;
+  WebPMuxImage**  images_index_;   // images_index_[n - 1] is the nth image.
+  int             images_index_size_;  // Allocated size of 'images_index_'.
+  int             num_images_;     // Number of images in 'images_'.
   WebPChunk*      iccp_;
   WebPChunk*      exif_;
   WebPChunk*      xmp_;
@@ -194,14 +197,17 @@ static WEBP_INLINE int IsWPI(WebPChunkId id) {
   }
 }
 
-// Pushes 'wpi' at the end of 'wpi_list'.
-WebPMuxError MuxImagePush(const WebPMuxImage* wpi, WebPMuxImage** wpi_list);
+// Pushes 'wpi' at the end of the image list of 'mux'.
+WebPMuxError MuxImagePush(const WebPMuxImage* wpi, WebPMux* const mux);
 
-// Delete nth image in the image list.
-WebPMuxError MuxImageDeleteNth(WebPMuxImage** wpi_list, uint32_t nth);
+// Delete nth image in the image list of 'mux'.
+WebPMuxError MuxImageDeleteNth(WebPMux* const mux, uint32_t nth);
 
-// Get nth image in the image list.
-WebPMuxError MuxImageGetNth(const WebPMuxImage** wpi_list, uint32_t nth,
+// Delete all the images of 'mux'.
+void MuxImageDeleteAll(WebPMux* const mux);
+
+// Get nth image in the image list of 'mux'.
+WebPMuxError MuxImageGetNth(const WebPMux* const mux, uint32_t nth,
                             WebPMuxImage** wpi);
 
 // Total size of the given image.
@@ -271,40 +271,33 @@ int MuxImageCount(const WebPMuxImage* wpi_list, WebPChunkId id) {
   return count;
 }
 
-// Outputs a pointer to 'prev_wpi->next_',
-//   where 'prev_wpi' is the pointer to the image at position (nth - 1).
-// Returns true if nth image was found.
-static int SearchImageToGetOrDelete(WebPMuxImage** wpi_list, uint32_t nth,
-                                    WebPMuxImage*** const location) {
-  uint32_t count = 0;
-  assert(wpi_list);
-  *location = wpi_list;
-
-  if (nth == 0) {
-    nth = MuxImageCount(*wpi_list, WEBP_CHUNK_NIL);
-    if (nth == 0) return 0;  // Not found.
-  }
-
-  while (*wpi_list != NULL) {
-    WebPMuxImage* const cur_wpi = *wpi_list;
-    ++count;
-    if (count == nth) return 1;  // Found.
-    wpi_list = &cur_wpi->next_;
-    *location = wpi_list;
-  }
-  return 0;  // Not found.
+// Returns the position in 'mux->images_index_' of the nth image (of the last
+// one if 'nth' is 0), or -1 if there is no such image.
+static int GetImagePosition(const WebPMux* const mux, uint32_t nth) {
+  if (nth == 0) nth = (uint32_t)mux->num_images_;
+  if (nth == 0 || nth > (uint32_t)mux->num_images_) return -1;
+  return (int)nth - 1;
 }
 
 //------------------------------------------------------------------------------
 // MuxImage writer methods.
 
-WebPMuxError MuxImagePush(const WebPMuxImage* wpi, WebPMuxImage** wpi_list) {
+WebPMuxError MuxImagePush(const WebPMuxImage* wpi, WebPMux* const mux) {
   WebPMuxImage* new_wpi;
 
-  while (*wpi_list != NULL) {
-    WebPMuxImage* const cur_wpi = *wpi_list;
-    if (cur_wpi->next_ == NULL) break;
-    wpi_list = &cur_wpi->next_;
+  if (mux->num_images_ == mux->images_index_size_) {
+    const int new_size =
+        (mux->images_index_size_ == 0) ? 16 : 2 * mux->images_index_size_;
+    WebPMuxImage** const new_index =
+        (WebPMuxImage**)WebPSafeMalloc(new_size, sizeof(*new_index));
+    if (new_index == NULL) return WEBP_MUX_MEMORY_ERROR;
+    if (mux->num_images_ > 0) {
+      memcpy(new_index, mux->images_index_,
+             mux->num_images_ * sizeof(*new_index));
+    }
+    WebPSafeFree(mux->images_index_);
+    mux->images_index_ = new_index;
+    mux->images_index_size_ = new_size;
   }
 
   new_wpi = (WebPMuxImage*)WebPSafeMalloc(1ULL, sizeof(*new_wpi));
@@ -312,11 +305,12 @@ WebPMuxError MuxImagePush(const WebPMuxImage* wpi, WebPMuxImage** wpi_list) {
   *new_wpi = *wpi;
   new_wpi->next_ = NULL;
 
-  if (*wpi_list != NULL) {
-    (*wpi_list)->next_ = new_wpi;
+  if (mux->num_images_ > 0) {
+    mux->images_index_[mux->num_images_ - 1]->next_ = new_wpi;
   } else {
-    *wpi_list = new_wpi;
+    mux->images_ = new_wpi;
   }
+  mux->images_index_[mux->num_images_++] = new_wpi;
   return WEBP_MUX_OK;
 }
 
@@ -330,27 +324,38 @@ WebPMuxImage* MuxImageDelete(WebPMuxImage* const wpi) {
   return next;
 }
 
-WebPMuxError MuxImageDeleteNth(WebPMuxImage** wpi_list, uint32_t nth) {
-  assert(wpi_list);
-  if (!SearchImageToGetOrDelete(wpi_list, nth, &wpi_list)) {
-    return WEBP_MUX_NOT_FOUND;
+WebPMuxError MuxImageDeleteNth(WebPMux* const mux, uint32_t nth) {
+  const int pos = GetImagePosition(mux, nth);
+  WebPMuxImage* next;
+  if (pos < 0) return WEBP_MUX_NOT_FOUND;
+  next = MuxImageDelete(mux->images_index_[pos]);
+  if (pos > 0) {
+    mux->images_index_[pos - 1]->next_ = next;
+  } else {
+    mux->images_ = next;
   }
-  *wpi_list = MuxImageDelete(*wpi_list);
+  --mux->num_images_;
+  memmove(mux->images_index_ + pos, mux->images_index_ + pos + 1,
+          (mux->num_images_ - pos) * sizeof(*mux->images_index_));
   return WEBP_MUX_OK;
 }
 
+void MuxImageDeleteAll(WebPMux* const mux) {
+  while (mux->images_ != NULL) {
+    mux->images_ = MuxImageDelete(mux->images_);
+  }
+  mux->num_images_ = 0;
+}
+
 //------------------------------------------------------------------------------
 // MuxImage reader methods.
 
-WebPMuxError MuxImageGetNth(const WebPMuxImage** wpi_list, uint32_t nth,
+WebPMuxError MuxImageGetNth(const WebPMux* const mux, uint32_t nth,
                             WebPMuxImage** wpi) {
-  assert(wpi_list);
+  const int pos = GetImagePosition(mux, nth);
   assert(wpi);
-  if (!SearchImageToGetOrDelete((WebPMuxImage**)wpi_list, nth,
-                                (WebPMuxImage***)&wpi_list)) {
-    return WEBP_MUX_NOT_FOUND;
-  }
-  *wpi = (WebPMuxImage*)*wpi_list;
+  if (pos < 0) return WEBP_MUX_NOT_FOUND;
+  *wpi = mux->images_index_[pos];
   return WEBP_MUX_OK;
 }
 
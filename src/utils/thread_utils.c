@@ -14,6 +14,7 @@
 #include <assert.h>
 #include <string.h>   // for memset()
 #include "src/utils/thread_utils.h"
+#include "src/utils/trace_utils.h"
 #include "src/utils/utils.h"
 
 #ifdef WEBP_USE_THREAD
@@ -47,6 +48,7 @@ typedef struct {
 #else  // !_WIN32
 
 #include <pthread.h>
+#include <unistd.h>    // for sysconf()
 
 #endif  // _WIN32
 
@@ -267,7 +269,9 @@ static void Init(WebPWorker* const worker) {
 
 static int Sync(WebPWorker* const worker) {
 #ifdef WEBP_USE_THREAD
+  WEBP_TRACE_BEGIN("WebPWorker::Sync");
   ChangeState(worker, OK);
+  WEBP_TRACE_END("WebPWorker::Sync");
 #endif
   assert(worker->status_ <= OK);
   return !worker->had_error;
@@ -315,13 +319,18 @@ static int Reset(WebPWorker* const worker) {
 
 static void Execute(WebPWorker* const worker) {
   if (worker->hook != NULL) {
+    WEBP_TRACE_BEGIN("WebPWorker::Execute");
     worker->had_error |= !worker->hook(worker->data1, worker->data2);
+    WEBP_TRACE_END("WebPWorker::Execute");
   }
 }
 
 static void Launch(WebPWorker* const worker) {
 #ifdef WEBP_USE_THREAD
+  // Waits for the previous job, if any, to complete.
+  WEBP_TRACE_BEGIN("WebPWorker::Launch");
   ChangeState(worker, WORK);
+  WEBP_TRACE_END("WebPWorker::Launch");
 #else
   Execute(worker);
 #endif
@@ -366,4 +375,17 @@ const WebPWorkerInterface* WebPGetWorkerInterface(void) {
   return &g_worker_interface;
 }
 
+int WebPGetNumCPUs(void) {
+#if defined(WEBP_USE_THREAD) && defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (info.dwNumberOfProcessors > 1) ? (int)info.dwNumberOfProcessors : 1;
+#elif defined(WEBP_USE_THREAD) && defined(_SC_NPROCESSORS_ONLN)
+  const long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return (num_cpus > 1) ? (int)num_cpus : 1;
+#else
+  return 1;
+#endif
+}
+
 //------------------------------------------------------------------------------
@@ -81,6 +81,10 @@ WEBP_EXTERN int WebPSetWorkerInterface(
 // Retrieve the currently set thread worker interface.
 WEBP_EXTERN const WebPWorkerInterface* WebPGetWorkerInterface(void);
 
+// Returns the number of CPUs available to run workers concurrently, 1 if it
+// is unknown or if threads are disabled.
+WEBP_EXTERN int WebPGetNumCPUs(void);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus
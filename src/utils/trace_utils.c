@@ -0,0 +1,243 @@
+// Copyright 2019 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// Recording of begin/end events, dumped as Chrome trace-event JSON.
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "src/utils/trace_utils.h"
+#include "src/utils/utils.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <time.h>
+#if defined(WEBP_USE_THREAD)
+#include <pthread.h>
+#endif
+#endif
+
+#define MIN_TRACE_EVENTS 4096
+#define MAX_TRACE_EVENTS (1 << 20)   // events beyond this count are dropped
+#define MAX_TRACE_THREADS 64         // threads beyond this count share an id
+#define MAX_TRACE_NAME_LENGTH 64
+
+typedef struct {
+  const char* name_;
+  double time_;      // in microseconds, relative to WebPTraceStart()
+  int thread_id_;
+  int is_begin_;
+} TraceEvent;
+
+volatile int WebPTraceEnabled = 0;
+
+static int trace_recording = 0;
+static WebPTraceHook trace_hook = NULL;
+static void* trace_hook_data = NULL;
+static TraceEvent* trace_events = NULL;
+static size_t trace_num_events = 0;
+static size_t trace_max_events = 0;
+static double trace_start_time = 0.;
+
+//------------------------------------------------------------------------------
+// Clock, lock and thread ids
+
+static double GetTimeUs(void) {
+#if defined(_WIN32)
+  LARGE_INTEGER freq, now;
+  if (QueryPerformanceFrequency(&freq) && QueryPerformanceCounter(&now)) {
+    return 1000000. * (double)now.QuadPart / (double)freq.QuadPart;
+  }
+  return 1000. * (double)GetTickCount();
+#elif defined(CLOCK_MONOTONIC)
+  struct timespec now;
+  if (clock_gettime(CLOCK_MONOTONIC, &now) == 0) {
+    return 1000000. * now.tv_sec + now.tv_nsec / 1000.;
+  }
+  return 0.;
+#else
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return 1000000. * now.tv_sec + now.tv_usec;
+#endif
+}
+
+#if defined(WEBP_USE_THREAD) && defined(_WIN32)
+
+static CRITICAL_SECTION trace_lock;
+static int trace_lock_initialized = 0;
+
+static void TraceLockInit(void) {
+  if (!trace_lock_initialized) {
+    InitializeCriticalSection(&trace_lock);
+    trace_lock_initialized = 1;
+  }
+}
+static void TraceLock(void) { EnterCriticalSection(&trace_lock); }
+static void TraceUnlock(void) { LeaveCriticalSection(&trace_lock); }
+static void TraceResetThreadIds(void) {}
+static int TraceGetThreadId(void) { return (int)GetCurrentThreadId(); }
+
+#elif defined(WEBP_USE_THREAD)
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t trace_threads[MAX_TRACE_THREADS];
+static int trace_num_threads = 0;
+
+static void TraceLockInit(void) {}
+static void TraceLock(void) { pthread_mutex_lock(&trace_lock); }
+static void TraceUnlock(void) { pthread_mutex_unlock(&trace_lock); }
+static void TraceResetThreadIds(void) { trace_num_threads = 0; }
+
+// pthread_t is opaque: map it to a small index, in order of appearance.
+// Must be called with the lock held.
+static int TraceGetThreadId(void) {
+  const pthread_t self = pthread_self();
+  int i;
+  for (i = 0; i < trace_num_threads; ++i) {
+    if (pthread_equal(trace_threads[i], self)) return i;
+  }
+  if (trace_num_threads == MAX_TRACE_THREADS) return MAX_TRACE_THREADS;
+  trace_threads[trace_num_threads] = self;
+  return trace_num_threads++;
+}
+
+#else   // !WEBP_USE_THREAD
+
+static void TraceLockInit(void) {}
+static void TraceLock(void) {}
+static void TraceUnlock(void) {}
+static void TraceResetThreadIds(void) {}
+static int TraceGetThreadId(void) { return 0; }
+
+#endif  // WEBP_USE_THREAD
+
+//------------------------------------------------------------------------------
+
+static void TraceClear(void) {
+  WebPSafeFree(trace_events);
+  trace_events = NULL;
+  trace_num_events = 0;
+  trace_max_events = 0;
+}
+
+void WebPTraceRecord(const char* name, int is_begin) {
+  const double now = GetTimeUs();
+  assert(name != NULL && strlen(name) < MAX_TRACE_NAME_LENGTH);
+  // The hook is called outside of the lock, as close as possible to the stage.
+  if (trace_hook != NULL && !is_begin) trace_hook(name, 0, trace_hook_data);
+  TraceLock();
+  if (trace_recording) {
+    if (trace_num_events == trace_max_events &&
+        trace_max_events < MAX_TRACE_EVENTS) {
+      const size_t new_max = 2 * trace_max_events;
+      TraceEvent* const new_events =
+          (TraceEvent*)WebPSafeMalloc(new_max, sizeof(*new_events));
+      if (new_events != NULL) {
+        memcpy(new_events, trace_events,
+               trace_num_events * sizeof(*new_events));
+        WebPSafeFree(trace_events);
+        trace_events = new_events;
+        trace_max_events = new_max;
+      }
+    }
+    if (trace_num_events < trace_max_events) {
+      TraceEvent* const event = &trace_events[trace_num_events++];
+      event->name_ = name;
+      event->time_ = now - trace_start_time;
+      event->thread_id_ = TraceGetThreadId();
+      event->is_begin_ = is_begin;
+    }
+  }
+  TraceUnlock();
+  if (trace_hook != NULL && is_begin) trace_hook(name, 1, trace_hook_data);
+}
+
+int WebPTraceStart(void) {
+  TraceLockInit();
+  TraceLock();
+  TraceClear();
+  TraceResetThreadIds();
+  trace_events =
+      (TraceEvent*)WebPSafeMalloc(MIN_TRACE_EVENTS, sizeof(*trace_events));
+  if (trace_events != NULL) {
+    trace_max_events = MIN_TRACE_EVENTS;
+    trace_start_time = GetTimeUs();
+    trace_recording = 1;
+    WebPTraceEnabled = 1;
+  }
+  TraceUnlock();
+  return (trace_events != NULL);
+}
+
+// Appends the thread name metadata, so the calling thread (the first one to
+// record an event) is easy to tell from the workers.
+static char* PutThreadNames(char* dst, int* const seen, int num_seen) {
+  int i;
+  for (i = 0; i < num_seen; ++i) {
+    dst += sprintf(dst, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                        "\"tid\":%d,\"args\":{\"name\":\"%s %d\"}},\n",
+                   seen[i], (i == 0) ? "main" : "worker", i);
+  }
+  return dst;
+}
+
+char* WebPTraceStop(size_t* const size) {
+  char* json = NULL;
+  if (size != NULL) *size = 0;
+  TraceLockInit();
+  TraceLock();
+  trace_recording = 0;
+  WebPTraceEnabled = (trace_hook != NULL);
+  if (trace_events != NULL) {
+    // Bound on the length of each line, including the event name.
+    const size_t max_line_size = MAX_TRACE_NAME_LENGTH + 96;
+    int seen[MAX_TRACE_THREADS];
+    int num_seen = 0;
+    size_t i;
+    for (i = 0; i < trace_num_events; ++i) {
+      const int tid = trace_events[i].thread_id_;
+      int j;
+      for (j = 0; j < num_seen && seen[j] != tid; ++j) {}
+      if (j == num_seen && num_seen < MAX_TRACE_THREADS) seen[num_seen++] = tid;
+    }
+    json = (char*)WebPSafeMalloc(trace_num_events + num_seen + 2,
+                                 max_line_size);
+    if (json != NULL) {
+      char* dst = json;
+      dst += sprintf(dst, "{\"traceEvents\":[\n");
+      dst = PutThreadNames(dst, seen, num_seen);
+      for (i = 0; i < trace_num_events; ++i) {
+        const TraceEvent* const event = &trace_events[i];
+        dst += sprintf(dst, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+                            "\"pid\":1,\"tid\":%d}%s\n",
+                       event->name_, event->is_begin_ ? 'B' : 'E',
+                       event->time_, event->thread_id_,
+                       (i + 1 < trace_num_events) ? "," : "");
+      }
+      dst += sprintf(dst, "],\"displayTimeUnit\":\"ms\"}\n");
+      if (size != NULL) *size = (size_t)(dst - json);
+    }
+  }
+  TraceClear();
+  TraceUnlock();
+  return json;
+}
+
+void WebPTraceSetHook(WebPTraceHook hook, void* user_data) {
+  TraceLockInit();
+  TraceLock();
+  trace_hook = hook;
+  trace_hook_data = user_data;
+  WebPTraceEnabled = trace_recording || (hook != NULL);
+  TraceUnlock();
+}
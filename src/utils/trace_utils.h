@@ -0,0 +1,41 @@
+// Copyright 2019 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// Recording of begin/end events for the encoding and decoding stages, dumped
+// in the Chrome trace-event format (see WebPTraceStart() in types.h).
+
+#ifndef WEBP_UTILS_TRACE_UTILS_H_
+#define WEBP_UTILS_TRACE_UTILS_H_
+
+#include "src/webp/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Non-zero while WebPTraceStart() or WebPTraceSetHook() is in effect.
+extern volatile int WebPTraceEnabled;
+
+// Records an event for the calling thread. 'name' must be a static string.
+void WebPTraceRecord(const char* name, int is_begin);
+
+// Each WEBP_TRACE_BEGIN() must be followed by a WEBP_TRACE_END() with the same
+// name on the same thread. Both are no-ops unless tracing is enabled.
+#define WEBP_TRACE_BEGIN(name) do {                                           \
+  if (WebPTraceEnabled) WebPTraceRecord((name), 1);                           \
+} while (0)
+#define WEBP_TRACE_END(name) do {                                             \
+  if (WebPTraceEnabled) WebPTraceRecord((name), 0);                           \
+} while (0)
+
+#ifdef __cplusplus
+}    // extern "C"
+#endif
+
+#endif  // WEBP_UTILS_TRACE_UTILS_H_
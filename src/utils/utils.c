@@ -208,6 +208,16 @@ void* WebPSafeCalloc(uint64_t nmemb, size_t size) {
   return ptr;
 }
 
+void* WebPSafeShrink(void* const ptr, size_t size) {
+  void* new_ptr;
+  if (ptr == NULL || size == 0) return ptr;
+  new_ptr = realloc(ptr, size);
+  if (new_ptr == NULL) return ptr;   // 'ptr' is left untouched
+  SubMem(ptr);
+  AddMem(new_ptr, size);
+  return new_ptr;
+}
+
 void WebPSafeFree(void* const ptr) {
   if (ptr != NULL) {
     Increment(&num_free_calls);
@@ -52,6 +52,10 @@ WEBP_EXTERN void* WebPSafeMalloc(uint64_t nmemb, size_t size);
 // Note that WebPSafeCalloc() expects the second argument type to be 'size_t'
 // in order to favor the "calloc(num_foo, sizeof(foo))" pattern.
 WEBP_EXTERN void* WebPSafeCalloc(uint64_t nmemb, size_t size);
+// Shrinks a block returned by the above allocations down to 'size' bytes,
+// keeping its content. Returns the new block, or 'ptr' itself if it could
+// not be shrunk (in which case it is still valid).
+WEBP_EXTERN void* WebPSafeShrink(void* const ptr, size_t size);
 
 // Companion deallocation function to the above allocations.
 WEBP_EXTERN void WebPSafeFree(void* const ptr);
@@ -38,6 +38,13 @@ typedef struct WebPDecoderConfig WebPDecoderConfig;
 // each of major/minor/revision. E.g: v2.5.7 is 0x020507.
 WEBP_EXTERN int WebPGetDecoderVersion(void);
 
+// Initializes once and for all the function pointers and tables used by the
+// decoder, which otherwise get checked and set up lazily by each decoding
+// call. Calling it at startup, before decoding from several threads, avoids
+// having these threads contend for the initialization. It is thread-safe and
+// calling it more than once has no effect.
+WEBP_EXTERN void WebPInitDecoder(void);
+
 // Retrieve basic header information: width, height.
 // This function will also validate the header, returning true on success,
 // false otherwise. '*width' and '*height' are only valid on successful return.
@@ -496,6 +503,21 @@ WEBP_EXTERN WebPIDecoder* WebPIDecode(const uint8_t* data, size_t data_size,
 WEBP_EXTERN VP8StatusCode WebPDecode(const uint8_t* data, size_t data_size,
                                      WebPDecoderConfig* config);
 
+// Decodes the bitstream once into the outputs of the 'num_configs' configs,
+// typically at different scales (a picture and its thumbnail, for instance).
+// The samples are reconstructed only once and fed to each output, so the
+// decoding costs little more than the one at the largest size.
+// All the configs must use the same cropping. The options that apply to the
+// reconstruction itself (use_threads, dithering_strength and
+// alpha_dithering_strength) are taken from configs[0], and the in-loop
+// filtering is only bypassed if it would be for each of the outputs.
+// The 'input' field of each config is filled with the bitstream features.
+// Returns decoding status. In case of error, none of the outputs is valid.
+WEBP_EXTERN VP8StatusCode WebPDecodeRenditions(const uint8_t* data,
+                                               size_t data_size,
+                                               WebPDecoderConfig* configs,
+                                               int num_configs);
+
 #ifdef __cplusplus
 }    // extern "C"
 #endif
@@ -20,7 +20,7 @@
 extern "C" {
 #endif
 
-#define WEBP_ENCODER_ABI_VERSION 0x020f    // MAJOR(8b) + MINOR(8b)
+#define WEBP_ENCODER_ABI_VERSION 0x0211    // MAJOR(8b) + MINOR(8b)
 
 // Note: forward declaring enumerations is not allowed in (strict) C and C++,
 // the types are left here for reference.
@@ -32,11 +32,17 @@ typedef struct WebPConfig WebPConfig;
 typedef struct WebPPicture WebPPicture;   // main structure for I/O
 typedef struct WebPAuxStats WebPAuxStats;
 typedef struct WebPMemoryWriter WebPMemoryWriter;
+typedef struct WebPCancelToken WebPCancelToken;
+typedef struct WebPRendition WebPRendition;
 
 // Return the encoder's version number, packed in hexadecimal using 8bits for
 // each of major/minor/revision. E.g: v2.5.7 is 0x020507.
 WEBP_EXTERN int WebPGetEncoderVersion(void);
 
+// Initializes once and for all the function pointers and tables used by the
+// encoder. Same as WebPInitDecoder(), for the encoding calls.
+WEBP_EXTERN void WebPInitEncoder(void);
+
 //------------------------------------------------------------------------------
 // One-stop-shop call! No questions asked:
 
@@ -136,7 +142,16 @@ struct WebPConfig {
                           // JPEG compression. Generally, the output size will
                           // be similar but the degradation will be lower.
   int thread_level;       // If non-zero, try and use multi-threaded encoding.
+                          // With values in [2..32], lossless images of at
+                          // least 512 rows are also split into up to as many
+                          // horizontal bands, which are analyzed concurrently.
+                          // The number of bands is limited by the number of
+                          // CPUs, so the output depends on the machine. Bands
+                          // usually make the output slightly bigger, and the
+                          // encoding uses more CPU time in total.
   int low_memory;         // If set, reduce memory usage (but increase CPU use).
+                          // For lossy encoding of ARGB pictures, samples are
+                          // then converted to YUV row by row, on demand.
 
   int near_lossless;      // Near lossless encoding [0 = max loss .. 100 = off
                           // (default)].
@@ -148,7 +163,14 @@ struct WebPConfig {
   int use_delta_palette;  // reserved for future lossless feature
   int use_sharp_yuv;      // if needed, use sharp (and slow) RGB->YUV conversion
 
-  uint32_t pad[2];        // padding for later use
+  int keep_smaller;       // If non-zero, the picture is encoded both lossy and
+                          // lossless ('lossless' is then ignored), concurrently
+                          // if 'thread_level' is set, and the smaller output
+                          // is kept. With 2, an encoding is also stopped as
+                          // soon as its partial (estimated, for the lossy
+                          // methods >= 3) size exceeds the other final size.
+                          // Default is 0 (off).
+  uint32_t pad[1];        // padding for later use
 };
 
 // Enumerate some predefined settings for WebPConfig, depending on the type
@@ -227,7 +249,9 @@ struct WebPAuxStats {
   int lossless_hdr_size;       // lossless header (transform, huffman etc) size
   int lossless_data_size;      // lossless image data size
 
-  uint32_t pad[2];        // padding for later use
+  // WebPConfig::keep_smaller statistics
+  int lossless_kept;           // true if the lossless output was kept
+  int discarded_size;          // size of the discarded output (0 if stopped)
 };
 
 // Signature for output function. Should return true if writing was successful.
@@ -254,6 +278,9 @@ WEBP_EXTERN void WebPMemoryWriterClear(WebPMemoryWriter* writer);
 // The custom writer to be used with WebPMemoryWriter as custom_ptr. Upon
 // completion, writer.mem and writer.size will hold the coded data.
 // writer.mem must be freed by calling WebPMemoryWriterClear.
+// When the writer is empty, the encoder may hand its own output buffer over
+// to it instead of copying the data (lossless), or size it exactly once
+// before writing (lossy).
 WEBP_EXTERN int WebPMemoryWrite(const uint8_t* data, size_t data_size,
                                 const WebPPicture* picture);
 
@@ -346,8 +373,13 @@ struct WebPPicture {
 
   uint32_t pad3[3];       // padding for later use
 
+  // If not NULL, the encoding stops with VP8_ENC_ERROR_USER_ABORT soon after
+  // this token is cancelled or its deadline has passed. Unlike progress_hook,
+  // it is polled regularly inside the lengthy loops and by the worker threads.
+  WebPCancelToken* cancel_token;
+
   // Unused for now
-  uint8_t* pad4, *pad5;
+  uint8_t* pad5;
   uint32_t pad6[8];       // padding for later use
 
   // PRIVATE FIELDS
@@ -537,6 +569,157 @@ WEBP_EXTERN void WebPBlendAlpha(WebPPicture* pic, uint32_t background_rgb);
 // another is provided but they both incur some loss.
 WEBP_EXTERN int WebPEncode(const WebPConfig* config, WebPPicture* picture);
 
+// Encodes 'picture' once for each of the 'num_qualities' entries of
+// 'qualities', all the other settings being taken from 'config'. The i-th
+// bitstream is stored in 'writers[i]', which must have been initialized with
+// WebPMemoryWriterInit(), and its statistics in 'stats[i]' if 'stats' is not
+// NULL. For lossy encoding, the colorspace conversion, the analysis and the
+// alpha compression, which don't depend on the quality, are only performed
+// once. The renditions are then coded concurrently if 'config->thread_level'
+// is set, the progress hook only being called for the last one. The outputs
+// are identical to those of separate WebPEncode() calls.
+// 'picture->writer', 'picture->stats' and 'picture->extra_info' are not used.
+// Returns false in case of error, picture->error_code being set accordingly.
+WEBP_EXTERN int WebPEncodeQualities(const WebPConfig* config,
+                                    WebPPicture* picture,
+                                    const float qualities[], int num_qualities,
+                                    WebPMemoryWriter writers[],
+                                    WebPAuxStats stats[]);
+
+//------------------------------------------------------------------------------
+// Renditions at several sizes
+
+struct WebPRendition {
+  int width;                  // Dimensions of the rendition. If one of them is
+  int height;                 // 0, it is computed to preserve the aspect ratio.
+  const WebPConfig* config;   // encoding parameters of the rendition
+  WebPAuxStats* stats;        // if not NULL, receives the statistics
+};
+
+// Receives the bitstream of the rendition 'index', which was encoded from the
+// rescaled 'picture'. Called from the thread that called
+// WebPEncodeRenditions(), in the order of the renditions. Should return false
+// to stop the encoding.
+typedef int (*WebPRenditionWriterFunction)(int index, const uint8_t* data,
+                                           size_t data_size,
+                                           const WebPPicture* picture,
+                                           void* user_data);
+
+// Encodes each of the 'num_renditions' 'renditions' of 'picture', passing the
+// bitstreams to 'writer'. The renditions are produced by cascaded rescaling,
+// from the largest to the smallest one: each of them is rescaled from the
+// smallest rendition already produced that is larger in both dimensions, or
+// from 'picture' if there is none. All the renditions are then encoded
+// concurrently, those whose 'config->thread_level' is set being launched on
+// worker threads, except for the last rendition which is the only one calling
+// the progress hook. 'picture' itself is not modified, except by the encoding
+// of a rendition of the same size (as with WebPEncode()).
+// 'picture->writer', 'picture->stats' and 'picture->extra_info' are not used.
+// Returns false in case of error, picture->error_code being set accordingly.
+WEBP_EXTERN int WebPEncodeRenditions(WebPPicture* picture,
+                                     const WebPRendition renditions[],
+                                     int num_renditions,
+                                     WebPRenditionWriterFunction writer,
+                                     void* user_data);
+
+//------------------------------------------------------------------------------
+// Encoding cache
+//
+// A WebPEncodeCache remembers the bitstreams produced for previously seen
+// (picture, config) pairs. The key is a fast hash of the input samples (ARGB
+// or YUVA planes, depending on 'picture->use_argb') together with a hash of
+// the WebPConfig and of the encoder version. On a hit, the stored bitstream
+// is emitted through 'picture->writer' and no actual encoding takes place.
+// Note: a cache object is not thread-safe.
+
+// Size in bytes of the keys indexing the cache entries.
+#define WEBP_ENCODE_CACHE_KEY_SIZE 16
+
+typedef struct WebPEncodeCache WebPEncodeCache;
+typedef struct WebPEncodeCacheStorage WebPEncodeCacheStorage;
+typedef struct WebPEncodeCacheStats WebPEncodeCacheStats;
+
+// Storage back-end for the cache. 'key' points to WEBP_ENCODE_CACHE_KEY_SIZE
+// bytes.
+struct WebPEncodeCacheStorage {
+  // Returns the bitstream stored for 'key' (and its size in '*data_size'), or
+  // NULL if there is none. The returned memory remains owned by the storage
+  // and must stay valid until the next call to any of its functions.
+  const uint8_t* (*lookup)(void* opaque, const uint8_t* key,
+                           size_t* data_size);
+  // Stores a copy of 'data' under 'key'. Returns false in case of error.
+  int (*store)(void* opaque, const uint8_t* key,
+               const uint8_t* data, size_t data_size);
+  // Releases all resources held by the storage. Can be NULL.
+  void (*release)(void* opaque);
+  void* opaque;           // passed as first argument to the functions above.
+};
+
+struct WebPEncodeCacheStats {
+  uint64_t hits;          // number of encodings served from the cache
+  uint64_t misses;        // number of encodings actually performed
+  uint64_t bypassed;      // number of encodings that were not cacheable
+  uint64_t store_errors;  // number of bitstreams the storage failed to keep
+  uint64_t bytes_served;  // total size of the bitstreams emitted on hits
+};
+
+// Creates a cache backed by an in-memory LRU storage holding at most
+// 'max_bytes' of compressed data. Returns NULL in case of memory error.
+WEBP_EXTERN WebPEncodeCache* WebPEncodeCacheNew(size_t max_bytes);
+
+// Creates a cache backed by a user-supplied 'storage' (which is copied).
+// The storage's release() function is called by WebPEncodeCacheDelete().
+// Returns NULL in case of memory error or invalid storage.
+WEBP_EXTERN WebPEncodeCache* WebPEncodeCacheNewWithStorage(
+    const WebPEncodeCacheStorage* storage);
+
+// Deletes the cache and releases its storage.
+WEBP_EXTERN void WebPEncodeCacheDelete(WebPEncodeCache* cache);
+
+// Retrieves the hit/miss statistics gathered so far.
+WEBP_EXTERN void WebPEncodeCacheGetStats(const WebPEncodeCache* cache,
+                                         WebPEncodeCacheStats* stats);
+
+// Same as WebPEncode(), but first looks up 'cache' for a bitstream previously
+// produced with identical samples and config. If 'cache' is NULL, this is
+// equivalent to WebPEncode(). On a cache hit, 'picture' is left untouched
+// (no colorspace conversion takes place) and only the 'coded_size' field of
+// 'picture->stats' is set. Encodings requesting 'picture->extra_info' bypass
+// the cache.
+WEBP_EXTERN int WebPEncodeCached(const WebPConfig* config,
+                                 WebPPicture* picture,
+                                 WebPEncodeCache* cache);
+
+//------------------------------------------------------------------------------
+// Cancellation
+//
+// A WebPCancelToken allows stopping an encoding in progress from another
+// thread, or automatically after a given delay. It is attached to the picture
+// through 'picture->cancel_token' and the same token can be shared by several
+// pictures, for instance all the frames of an animation.
+
+// Creates a new token, neither cancelled nor with any deadline.
+// Returns NULL in case of memory error.
+WEBP_EXTERN WebPCancelToken* WebPCancelTokenNew(void);
+
+// Releases the token. It must not be used by any pending encoding anymore.
+WEBP_EXTERN void WebPCancelTokenDelete(WebPCancelToken* token);
+
+// Requests the cancellation. This function can be called from any thread.
+WEBP_EXTERN void WebPCancelTokenCancel(WebPCancelToken* token);
+
+// Sets a deadline 'timeout_ms' milliseconds from now, after which the token
+// is considered cancelled. A 'timeout_ms' <= 0 removes the deadline.
+// Note: this function should not be called while an encoding is using 'token'.
+WEBP_EXTERN void WebPCancelTokenSetTimeout(WebPCancelToken* token,
+                                           int timeout_ms);
+
+// Returns true if the token was cancelled or if its deadline has passed.
+WEBP_EXTERN int WebPCancelTokenIsCancelled(WebPCancelToken* token);
+
+// Clears the cancellation and the deadline, so the token can be reused.
+WEBP_EXTERN void WebPCancelTokenReset(WebPCancelToken* token);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus
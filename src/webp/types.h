@@ -61,6 +61,26 @@ WEBP_EXTERN void* WebPMalloc(size_t size);
 // Releases memory returned by the WebPDecode*() functions (from decode.h).
 WEBP_EXTERN void WebPFree(void* ptr);
 
+// Starts recording the begin/end events of the main encoding and decoding
+// stages, along with the waits on the worker threads, for all threads.
+// Any previous recording is discarded. Returns false in case of memory error.
+WEBP_EXTERN int WebPTraceStart(void);
+
+// Stops the recording and returns the events in the Chrome trace-event JSON
+// format (to be loaded in chrome://tracing or Perfetto), '*size' being set to
+// its length. The returned memory must be deallocated by calling WebPFree().
+// Returns NULL if no recording was in progress or in case of memory error.
+WEBP_EXTERN char* WebPTraceStop(size_t* size);
+
+// Function called at the beginning ('is_begin' = 1) and at the end
+// ('is_begin' = 0) of each of the stages recorded by WebPTraceStart(), on the
+// thread running the stage. 'name' is a static string.
+typedef void (*WebPTraceHook)(const char* name, int is_begin, void* user_data);
+
+// Installs 'hook' (or removes it, if NULL). It is called whether a recording
+// is in progress or not. Must not be called during an encoding or decoding.
+WEBP_EXTERN void WebPTraceSetHook(WebPTraceHook hook, void* user_data);
+
 #ifdef __cplusplus
 }    // extern "C"
 #endif
@@ -995,6 +995,134 @@ LOSSLESS_WRAPPER(WebPEncodeLosslessBGRA)
 
 
 
+// Returns true if [offset, offset + size) lies within a buffer of 'capacity'
+// bytes.
+static int IsValidRange(size_t capacity, int offset, int size) {
+  return (offset >= 0 && size >= 0 &&
+          (size_t)offset <= capacity && (size_t)size <= capacity - offset);
+}
+
+typedef int (*WebPImportFunction)(WebPPicture* picture,
+                                  const uint8_t* rgb, int rgb_stride);
+
+// Writer storing the bitstream straight into the caller's buffer. Once the
+// buffer is full, the bytes are only counted.
+typedef struct {
+  uint8_t* mem;
+  size_t max_size;
+  size_t size;
+} DirectBufferWriter;
+
+static int DirectBufferWrite(const uint8_t* data, size_t data_size,
+                             const WebPPicture* picture) {
+  DirectBufferWriter* const w = (DirectBufferWriter*)picture->custom_ptr;
+  if (w->size < w->max_size) {
+    const size_t left = w->max_size - w->size;
+    memcpy(w->mem + w->size, data, (data_size < left) ? data_size : left);
+  }
+  w->size += data_size;
+  return 1;
+}
+
+static int EncodeInto(const uint8_t* rgb, int rgb_size,
+                      int width, int height, int stride, int bytes_per_pixel,
+                      WebPImportFunction import, float quality_factor,
+                      int lossless, int method, int thread_level,
+                      uint8_t* output, int output_size) {
+  WebPPicture pic;
+  WebPConfig config;
+  DirectBufferWriter wrt;
+  int ok;
+
+  // The dimensions come straight from Java: bound them before any arithmetic.
+  if (width <= 0 || height <= 0 ||
+      width > WEBP_MAX_DIMENSION || height > WEBP_MAX_DIMENSION ||
+      (int64_t)stride < (int64_t)width * bytes_per_pixel ||
+      (uint64_t)stride * (height - 1) + (uint64_t)width * bytes_per_pixel >
+          (uint64_t)rgb_size) {
+    return 0;
+  }
+  if (!WebPConfigPreset(&config, WEBP_PRESET_DEFAULT, quality_factor) ||
+      !WebPPictureInit(&pic)) {
+    return 0;
+  }
+  config.lossless = !!lossless;
+  config.method = method;
+  config.thread_level = thread_level;
+  if (!WebPValidateConfig(&config)) return 0;
+
+  pic.use_argb = !!lossless;
+  pic.width = width;
+  pic.height = height;
+  pic.writer = DirectBufferWrite;
+  pic.custom_ptr = &wrt;
+  wrt.mem = output;
+  wrt.max_size = (size_t)output_size;
+  wrt.size = 0;
+
+  ok = import(&pic, rgb, stride) && WebPEncode(&config, &pic);
+  WebPPictureFree(&pic);
+  return ok ? (int)wrt.size : 0;
+}
+
+
+// Decodes the 'data_size' bytes at 'data_offset' in 'data_buffer' into the
+// 'output_size' bytes at 'output_offset' in 'output_buffer', with rows
+// 'stride' bytes apart. Returns false in case of error.
+#define DECODE_INTO_WRAPPER(FUNC)                                           \
+  static int wrap_##FUNC(                                                   \
+      const uint8_t* data_buffer, size_t data_capacity,                     \
+      int data_offset, int data_size,                                       \
+      uint8_t* output_buffer, size_t output_capacity,                       \
+      int output_offset, int output_size, int stride) {                     \
+    if (!IsValidRange(data_capacity, data_offset, data_size) ||             \
+        !IsValidRange(output_capacity, output_offset, output_size)) {       \
+      return 0;                                                             \
+    }                                                                       \
+    return FUNC(data_buffer + data_offset, data_size,                       \
+                output_buffer + output_offset, output_size,                 \
+                stride) != NULL;                                            \
+  }                                                                         \
+
+DECODE_INTO_WRAPPER(WebPDecodeRGBInto)
+DECODE_INTO_WRAPPER(WebPDecodeRGBAInto)
+DECODE_INTO_WRAPPER(WebPDecodeARGBInto)
+DECODE_INTO_WRAPPER(WebPDecodeBGRInto)
+DECODE_INTO_WRAPPER(WebPDecodeBGRAInto)
+
+#undef DECODE_INTO_WRAPPER
+
+// Encodes the samples at 'rgb_offset' in 'rgb_buffer' straight into the
+// 'output_size' bytes at 'output_offset' in 'output_buffer'. Returns the size
+// of the bitstream, which was truncated if larger than 'output_size', or 0 in
+// case of error.
+#define ENCODE_INTO_WRAPPER(FUNC, IMPORTER, BYTES_PER_PIXEL)                \
+  static int wrap_##FUNC(                                                   \
+      const uint8_t* rgb_buffer, size_t rgb_capacity,                       \
+      int rgb_offset, int rgb_size, int width, int height, int stride,      \
+      float quality_factor, int lossless, int method, int thread_level,     \
+      uint8_t* output_buffer, size_t output_capacity,                       \
+      int output_offset, int output_size) {                                 \
+    if (!IsValidRange(rgb_capacity, rgb_offset, rgb_size) ||                \
+        !IsValidRange(output_capacity, output_offset, output_size)) {       \
+      return 0;                                                             \
+    }                                                                       \
+    return EncodeInto(rgb_buffer + rgb_offset, rgb_size,                    \
+                      width, height, stride, BYTES_PER_PIXEL, IMPORTER,     \
+                      quality_factor, lossless, method, thread_level,       \
+                      output_buffer + output_offset, output_size);          \
+  }                                                                         \
+
+ENCODE_INTO_WRAPPER(WebPEncodeRGBInto, WebPPictureImportRGB, 3)
+ENCODE_INTO_WRAPPER(WebPEncodeBGRInto, WebPPictureImportBGR, 3)
+ENCODE_INTO_WRAPPER(WebPEncodeRGBAInto, WebPPictureImportRGBA, 4)
+ENCODE_INTO_WRAPPER(WebPEncodeBGRAInto, WebPPictureImportBGRA, 4)
+
+#undef ENCODE_INTO_WRAPPER
+
+
+
+
 /* Work around broken gcj jni.h */
 #ifdef __GCJ_JNI_H__
 # undef JNIEXPORT
@@ -1759,6 +1887,468 @@ SWIGEXPORT jbyteArray JNICALL Java_com_google_webp_libwebpJNI_wrap_1WebPEncodeLo
 }
 
 
+SWIGEXPORT jint JNICALL Java_com_google_webp_libwebpJNI_wrap_1WebPDecodeRGBInto(JNIEnv *jenv, jclass jcls, jobject jarg1, jint jarg3, jint jarg4, jobject jarg5, jint jarg7, jint jarg8, jint jarg9) {
+  jint jresult = 0 ;
+  uint8_t *arg1 = (uint8_t *) 0 ;
+  size_t arg2 ;
+  int arg3 ;
+  int arg4 ;
+  uint8_t *arg5 = (uint8_t *) 0 ;
+  size_t arg6 ;
+  int arg7 ;
+  int arg8 ;
+  int arg9 ;
+  int result;
+
+  (void)jenv;
+  (void)jcls;
+  {
+    arg1 = (jarg1 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg1) : NULL;
+    if (arg1 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPDecodeRGBInto" "', argument " "1"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg2 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg1);
+  }
+  arg3 = (int)jarg3;
+  arg4 = (int)jarg4;
+  {
+    arg5 = (jarg5 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg5) : NULL;
+    if (arg5 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPDecodeRGBInto" "', argument " "5"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg6 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg5);
+  }
+  arg7 = (int)jarg7;
+  arg8 = (int)jarg8;
+  arg9 = (int)jarg9;
+  result = (int)wrap_WebPDecodeRGBInto((uint8_t const *)arg1,arg2,arg3,arg4,arg5,arg6,arg7,arg8,arg9);
+  jresult = (jint)result;
+  return jresult;
+}
+
+
+SWIGEXPORT jint JNICALL Java_com_google_webp_libwebpJNI_wrap_1WebPDecodeRGBAInto(JNIEnv *jenv, jclass jcls, jobject jarg1, jint jarg3, jint jarg4, jobject jarg5, jint jarg7, jint jarg8, jint jarg9) {
+  jint jresult = 0 ;
+  uint8_t *arg1 = (uint8_t *) 0 ;
+  size_t arg2 ;
+  int arg3 ;
+  int arg4 ;
+  uint8_t *arg5 = (uint8_t *) 0 ;
+  size_t arg6 ;
+  int arg7 ;
+  int arg8 ;
+  int arg9 ;
+  int result;
+
+  (void)jenv;
+  (void)jcls;
+  {
+    arg1 = (jarg1 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg1) : NULL;
+    if (arg1 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPDecodeRGBAInto" "', argument " "1"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg2 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg1);
+  }
+  arg3 = (int)jarg3;
+  arg4 = (int)jarg4;
+  {
+    arg5 = (jarg5 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg5) : NULL;
+    if (arg5 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPDecodeRGBAInto" "', argument " "5"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg6 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg5);
+  }
+  arg7 = (int)jarg7;
+  arg8 = (int)jarg8;
+  arg9 = (int)jarg9;
+  result = (int)wrap_WebPDecodeRGBAInto((uint8_t const *)arg1,arg2,arg3,arg4,arg5,arg6,arg7,arg8,arg9);
+  jresult = (jint)result;
+  return jresult;
+}
+
+
+SWIGEXPORT jint JNICALL Java_com_google_webp_libwebpJNI_wrap_1WebPDecodeARGBInto(JNIEnv *jenv, jclass jcls, jobject jarg1, jint jarg3, jint jarg4, jobject jarg5, jint jarg7, jint jarg8, jint jarg9) {
+  jint jresult = 0 ;
+  uint8_t *arg1 = (uint8_t *) 0 ;
+  size_t arg2 ;
+  int arg3 ;
+  int arg4 ;
+  uint8_t *arg5 = (uint8_t *) 0 ;
+  size_t arg6 ;
+  int arg7 ;
+  int arg8 ;
+  int arg9 ;
+  int result;
+
+  (void)jenv;
+  (void)jcls;
+  {
+    arg1 = (jarg1 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg1) : NULL;
+    if (arg1 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPDecodeARGBInto" "', argument " "1"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg2 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg1);
+  }
+  arg3 = (int)jarg3;
+  arg4 = (int)jarg4;
+  {
+    arg5 = (jarg5 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg5) : NULL;
+    if (arg5 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPDecodeARGBInto" "', argument " "5"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg6 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg5);
+  }
+  arg7 = (int)jarg7;
+  arg8 = (int)jarg8;
+  arg9 = (int)jarg9;
+  result = (int)wrap_WebPDecodeARGBInto((uint8_t const *)arg1,arg2,arg3,arg4,arg5,arg6,arg7,arg8,arg9);
+  jresult = (jint)result;
+  return jresult;
+}
+
+
+SWIGEXPORT jint JNICALL Java_com_google_webp_libwebpJNI_wrap_1WebPDecodeBGRInto(JNIEnv *jenv, jclass jcls, jobject jarg1, jint jarg3, jint jarg4, jobject jarg5, jint jarg7, jint jarg8, jint jarg9) {
+  jint jresult = 0 ;
+  uint8_t *arg1 = (uint8_t *) 0 ;
+  size_t arg2 ;
+  int arg3 ;
+  int arg4 ;
+  uint8_t *arg5 = (uint8_t *) 0 ;
+  size_t arg6 ;
+  int arg7 ;
+  int arg8 ;
+  int arg9 ;
+  int result;
+
+  (void)jenv;
+  (void)jcls;
+  {
+    arg1 = (jarg1 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg1) : NULL;
+    if (arg1 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPDecodeBGRInto" "', argument " "1"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg2 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg1);
+  }
+  arg3 = (int)jarg3;
+  arg4 = (int)jarg4;
+  {
+    arg5 = (jarg5 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg5) : NULL;
+    if (arg5 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPDecodeBGRInto" "', argument " "5"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg6 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg5);
+  }
+  arg7 = (int)jarg7;
+  arg8 = (int)jarg8;
+  arg9 = (int)jarg9;
+  result = (int)wrap_WebPDecodeBGRInto((uint8_t const *)arg1,arg2,arg3,arg4,arg5,arg6,arg7,arg8,arg9);
+  jresult = (jint)result;
+  return jresult;
+}
+
+
+SWIGEXPORT jint JNICALL Java_com_google_webp_libwebpJNI_wrap_1WebPDecodeBGRAInto(JNIEnv *jenv, jclass jcls, jobject jarg1, jint jarg3, jint jarg4, jobject jarg5, jint jarg7, jint jarg8, jint jarg9) {
+  jint jresult = 0 ;
+  uint8_t *arg1 = (uint8_t *) 0 ;
+  size_t arg2 ;
+  int arg3 ;
+  int arg4 ;
+  uint8_t *arg5 = (uint8_t *) 0 ;
+  size_t arg6 ;
+  int arg7 ;
+  int arg8 ;
+  int arg9 ;
+  int result;
+
+  (void)jenv;
+  (void)jcls;
+  {
+    arg1 = (jarg1 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg1) : NULL;
+    if (arg1 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPDecodeBGRAInto" "', argument " "1"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg2 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg1);
+  }
+  arg3 = (int)jarg3;
+  arg4 = (int)jarg4;
+  {
+    arg5 = (jarg5 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg5) : NULL;
+    if (arg5 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPDecodeBGRAInto" "', argument " "5"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg6 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg5);
+  }
+  arg7 = (int)jarg7;
+  arg8 = (int)jarg8;
+  arg9 = (int)jarg9;
+  result = (int)wrap_WebPDecodeBGRAInto((uint8_t const *)arg1,arg2,arg3,arg4,arg5,arg6,arg7,arg8,arg9);
+  jresult = (jint)result;
+  return jresult;
+}
+
+
+SWIGEXPORT jint JNICALL Java_com_google_webp_libwebpJNI_wrap_1WebPEncodeRGBInto(JNIEnv *jenv, jclass jcls, jobject jarg1, jint jarg3, jint jarg4, jint jarg5, jint jarg6, jint jarg7, jfloat jarg8, jint jarg9, jint jarg10, jint jarg11, jobject jarg12, jint jarg14, jint jarg15) {
+  jint jresult = 0 ;
+  uint8_t *arg1 = (uint8_t *) 0 ;
+  size_t arg2 ;
+  int arg3 ;
+  int arg4 ;
+  int arg5 ;
+  int arg6 ;
+  int arg7 ;
+  float arg8 ;
+  int arg9 ;
+  int arg10 ;
+  int arg11 ;
+  uint8_t *arg12 = (uint8_t *) 0 ;
+  size_t arg13 ;
+  int arg14 ;
+  int arg15 ;
+  int result;
+
+  (void)jenv;
+  (void)jcls;
+  {
+    arg1 = (jarg1 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg1) : NULL;
+    if (arg1 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPEncodeRGBInto" "', argument " "1"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg2 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg1);
+  }
+  arg3 = (int)jarg3;
+  arg4 = (int)jarg4;
+  arg5 = (int)jarg5;
+  arg6 = (int)jarg6;
+  arg7 = (int)jarg7;
+  arg8 = (float)jarg8;
+  arg9 = (int)jarg9;
+  arg10 = (int)jarg10;
+  arg11 = (int)jarg11;
+  {
+    arg12 = (jarg12 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg12) : NULL;
+    if (arg12 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPEncodeRGBInto" "', argument " "12"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg13 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg12);
+  }
+  arg14 = (int)jarg14;
+  arg15 = (int)jarg15;
+  result = (int)wrap_WebPEncodeRGBInto((uint8_t const *)arg1,arg2,arg3,arg4,arg5,arg6,arg7,arg8,arg9,arg10,arg11,arg12,arg13,arg14,arg15);
+  jresult = (jint)result;
+  return jresult;
+}
+
+
+SWIGEXPORT jint JNICALL Java_com_google_webp_libwebpJNI_wrap_1WebPEncodeBGRInto(JNIEnv *jenv, jclass jcls, jobject jarg1, jint jarg3, jint jarg4, jint jarg5, jint jarg6, jint jarg7, jfloat jarg8, jint jarg9, jint jarg10, jint jarg11, jobject jarg12, jint jarg14, jint jarg15) {
+  jint jresult = 0 ;
+  uint8_t *arg1 = (uint8_t *) 0 ;
+  size_t arg2 ;
+  int arg3 ;
+  int arg4 ;
+  int arg5 ;
+  int arg6 ;
+  int arg7 ;
+  float arg8 ;
+  int arg9 ;
+  int arg10 ;
+  int arg11 ;
+  uint8_t *arg12 = (uint8_t *) 0 ;
+  size_t arg13 ;
+  int arg14 ;
+  int arg15 ;
+  int result;
+
+  (void)jenv;
+  (void)jcls;
+  {
+    arg1 = (jarg1 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg1) : NULL;
+    if (arg1 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPEncodeBGRInto" "', argument " "1"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg2 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg1);
+  }
+  arg3 = (int)jarg3;
+  arg4 = (int)jarg4;
+  arg5 = (int)jarg5;
+  arg6 = (int)jarg6;
+  arg7 = (int)jarg7;
+  arg8 = (float)jarg8;
+  arg9 = (int)jarg9;
+  arg10 = (int)jarg10;
+  arg11 = (int)jarg11;
+  {
+    arg12 = (jarg12 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg12) : NULL;
+    if (arg12 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPEncodeBGRInto" "', argument " "12"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg13 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg12);
+  }
+  arg14 = (int)jarg14;
+  arg15 = (int)jarg15;
+  result = (int)wrap_WebPEncodeBGRInto((uint8_t const *)arg1,arg2,arg3,arg4,arg5,arg6,arg7,arg8,arg9,arg10,arg11,arg12,arg13,arg14,arg15);
+  jresult = (jint)result;
+  return jresult;
+}
+
+
+SWIGEXPORT jint JNICALL Java_com_google_webp_libwebpJNI_wrap_1WebPEncodeRGBAInto(JNIEnv *jenv, jclass jcls, jobject jarg1, jint jarg3, jint jarg4, jint jarg5, jint jarg6, jint jarg7, jfloat jarg8, jint jarg9, jint jarg10, jint jarg11, jobject jarg12, jint jarg14, jint jarg15) {
+  jint jresult = 0 ;
+  uint8_t *arg1 = (uint8_t *) 0 ;
+  size_t arg2 ;
+  int arg3 ;
+  int arg4 ;
+  int arg5 ;
+  int arg6 ;
+  int arg7 ;
+  float arg8 ;
+  int arg9 ;
+  int arg10 ;
+  int arg11 ;
+  uint8_t *arg12 = (uint8_t *) 0 ;
+  size_t arg13 ;
+  int arg14 ;
+  int arg15 ;
+  int result;
+
+  (void)jenv;
+  (void)jcls;
+  {
+    arg1 = (jarg1 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg1) : NULL;
+    if (arg1 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPEncodeRGBAInto" "', argument " "1"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg2 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg1);
+  }
+  arg3 = (int)jarg3;
+  arg4 = (int)jarg4;
+  arg5 = (int)jarg5;
+  arg6 = (int)jarg6;
+  arg7 = (int)jarg7;
+  arg8 = (float)jarg8;
+  arg9 = (int)jarg9;
+  arg10 = (int)jarg10;
+  arg11 = (int)jarg11;
+  {
+    arg12 = (jarg12 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg12) : NULL;
+    if (arg12 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPEncodeRGBAInto" "', argument " "12"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg13 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg12);
+  }
+  arg14 = (int)jarg14;
+  arg15 = (int)jarg15;
+  result = (int)wrap_WebPEncodeRGBAInto((uint8_t const *)arg1,arg2,arg3,arg4,arg5,arg6,arg7,arg8,arg9,arg10,arg11,arg12,arg13,arg14,arg15);
+  jresult = (jint)result;
+  return jresult;
+}
+
+
+SWIGEXPORT jint JNICALL Java_com_google_webp_libwebpJNI_wrap_1WebPEncodeBGRAInto(JNIEnv *jenv, jclass jcls, jobject jarg1, jint jarg3, jint jarg4, jint jarg5, jint jarg6, jint jarg7, jfloat jarg8, jint jarg9, jint jarg10, jint jarg11, jobject jarg12, jint jarg14, jint jarg15) {
+  jint jresult = 0 ;
+  uint8_t *arg1 = (uint8_t *) 0 ;
+  size_t arg2 ;
+  int arg3 ;
+  int arg4 ;
+  int arg5 ;
+  int arg6 ;
+  int arg7 ;
+  float arg8 ;
+  int arg9 ;
+  int arg10 ;
+  int arg11 ;
+  uint8_t *arg12 = (uint8_t *) 0 ;
+  size_t arg13 ;
+  int arg14 ;
+  int arg15 ;
+  int result;
+
+  (void)jenv;
+  (void)jcls;
+  {
+    arg1 = (jarg1 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg1) : NULL;
+    if (arg1 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPEncodeBGRAInto" "', argument " "1"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg2 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg1);
+  }
+  arg3 = (int)jarg3;
+  arg4 = (int)jarg4;
+  arg5 = (int)jarg5;
+  arg6 = (int)jarg6;
+  arg7 = (int)jarg7;
+  arg8 = (float)jarg8;
+  arg9 = (int)jarg9;
+  arg10 = (int)jarg10;
+  arg11 = (int)jarg11;
+  {
+    arg12 = (jarg12 != NULL) ?
+    (uint8_t *)(*jenv)->GetDirectBufferAddress(jenv, jarg12) : NULL;
+    if (arg12 == NULL) {
+      SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException,
+        "in method '" "wrap_WebPEncodeBGRAInto" "', argument " "12"" is not a direct ByteBuffer");
+      return 0;
+    }
+    arg13 = (size_t)(*jenv)->GetDirectBufferCapacity(jenv, jarg12);
+  }
+  arg14 = (int)jarg14;
+  arg15 = (int)jarg15;
+  result = (int)wrap_WebPEncodeBGRAInto((uint8_t const *)arg1,arg2,arg3,arg4,arg5,arg6,arg7,arg8,arg9,arg10,arg11,arg12,arg13,arg14,arg15);
+  jresult = (jint)result;
+  return jresult;
+}
+
+
 #ifdef __cplusplus
 }
 #endif